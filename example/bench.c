@@ -0,0 +1,308 @@
+// Micro-benchmarks for pick.h request bookkeeping and result delivery.
+//
+// Built against the headless backend, so it runs anywhere without a display:
+//
+//   make bench                 human-readable table
+//   make bench-json            writes bench.json for diffing across commits
+//
+// Every case reports ns/op, allocations and frees per op (counted through
+// PICK_MALLOC & co.) and the process peak RSS once the case has finished.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/resource.h>
+
+static size_t bench_allocs;
+static size_t bench_frees;
+
+#define PICK_MALLOC(size)        (bench_allocs++, malloc(size))
+#define PICK_CALLOC(count, size) (bench_allocs++, calloc(count, size))
+#define PICK_REALLOC(ptr, size)  (bench_allocs++, realloc(ptr, size))
+#define PICK_FREE(ptr)           (bench_frees++, free(ptr))
+
+#define PICK_PLATFORM_HEADLESS
+#define PICK_IMPLEMENTATION
+#include "../pick.h"
+
+typedef struct {
+  const char* name;
+  long        n;            ///< Problem size (paths per op), 0 if not applicable
+  long        iters;
+  double      ns_per_op;
+  double      allocs_per_op;
+  double      frees_per_op;
+  long        peak_rss_kb;
+} bench_result_t;
+
+static bench_result_t bench_results[96];
+static int bench_result_count;
+static bool bench_quick;
+static volatile size_t bench_sink;
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static long bench_peak_rss_kb(void) {
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+  return ru.ru_maxrss / 1024;
+#else
+  return ru.ru_maxrss;
+#endif
+}
+
+static long bench_iters(long n) {
+  long budget = bench_quick ? 200000 : 2000000;
+  long iters = budget / (n > 0 ? n : 1);
+  return iters < 3 ? 3 : iters;
+}
+
+static void bench_record(const char* name, long n, long iters, double ns, size_t allocs, size_t frees) {
+  if (bench_result_count >= (int)(sizeof(bench_results) / sizeof(bench_results[0]))) return;
+  bench_results[bench_result_count++] = (bench_result_t){
+    .name = name, .n = n, .iters = iters,
+    .ns_per_op = ns / (double)iters,
+    .allocs_per_op = (double)allocs / (double)iters,
+    .frees_per_op = (double)frees / (double)iters,
+    .peak_rss_kb = bench_peak_rss_kb()
+  };
+}
+
+static void bench_noop_multi(const char** paths, int count, void* user) {
+  (void)user;
+  bench_sink += count ? strlen(paths[count - 1]) : 0;
+}
+
+
+static void bench_noop_single(const char* path, void* user) {
+  (void)user;
+  bench_sink += path ? 1 : 0;
+}
+
+static void bench_alloc_clear(void) {
+  long iters = bench_iters(1) * 10;
+  size_t allocs = bench_allocs, frees = bench_frees;
+  double t0 = bench_now_ns();
+  for (long i = 0; i < iters; i++) {
+    int id = pick__alloc_req();
+    pick__req(id)->kind = PICK_REQ_OPEN_SINGLE;
+    pick__clear_req(id);
+  }
+  bench_record("alloc_clear_req", 0, iters, bench_now_ns() - t0, bench_allocs - allocs, bench_frees - frees);
+}
+
+// N requests in flight at once, then released in a scrambled order. With the
+// free-list slab the cost per alloc+free pair must not depend on N.
+static void bench_concurrent_reqs(long n) {
+  static char names[8][48];
+  static int name_idx;
+  int* ids = (int*)malloc(sizeof(int) * (size_t)n);
+  if (!ids) return;
+
+  long rounds = bench_iters(n) < 20 ? 20 : bench_iters(n);
+  size_t allocs = bench_allocs, frees = bench_frees;
+  double t0 = bench_now_ns();
+  for (long r = 0; r < rounds; r++) {
+    for (long i = 0; i < n; i++) {
+      ids[i] = pick__alloc_req();
+      pick__req(ids[i])->kind = PICK_REQ_OPEN_SINGLE;
+    }
+    for (long i = 0; i < n; i++) pick__clear_req(ids[(i * 7919) % n]);
+  }
+  double ns = bench_now_ns() - t0;
+  free(ids);
+
+  char* name = names[name_idx++ % 8];
+  snprintf(name, 48, "concurrent_reqs/%ld", n);
+  bench_record(name, n, rounds * n, ns, bench_allocs - allocs, bench_frees - frees);
+}
+
+// Deliveries addressed to a released id (e.g. a late JS callback) are dropped.
+static void bench_deliver_stale(void) {
+  int stale = pick__alloc_req();
+  pick__clear_req(stale);
+  int live = pick__alloc_req();  // reuses the slot under a new generation
+  *pick__req(live) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_SINGLE, .single_cb = bench_noop_single };
+
+  long iters = bench_iters(1) * 10;
+  size_t allocs = bench_allocs, frees = bench_frees;
+  double t0 = bench_now_ns();
+  for (long i = 0; i < iters; i++) pick__deliver_single(stale, "/picked/late.txt");
+  double ns = bench_now_ns() - t0;
+
+  if (!pick__req(live)) fprintf(stderr, "bench: stale delivery reached a live request\n");
+  pick__clear_req(live);
+  bench_record("deliver_stale_id", 0, iters, ns, bench_allocs - allocs, bench_frees - frees);
+}
+
+static void bench_accept_string(void) {
+  const char* images[] = { "png", "jpg", "jpeg", "gif", "webp", "bmp" };
+  const char* docs[]   = { "pdf", "doc", "docx", "txt", "md" };
+  const char* audio[]  = { "wav", "ogg", "mp3", "flac" };
+  PickFilter filters[] = { { "Images", images, 6 }, { "Documents", docs, 5 }, { "Audio", audio, 4 } };
+  PickFileOptions opts = { .filters = filters, .filter_count = 3 };
+
+  long iters = bench_iters(1) * 2;
+  char accept[512];
+  size_t allocs = bench_allocs, frees = bench_frees;
+  double t0 = bench_now_ns();
+  for (long i = 0; i < iters; i++) {
+    pick__build_accept_string(&opts, accept, sizeof(accept));
+    bench_sink += (size_t)accept[0];
+  }
+  bench_record("build_accept_string", 15, iters, bench_now_ns() - t0, bench_allocs - allocs, bench_frees - frees);
+}
+
+static char** bench_make_paths(long n) {
+  char** paths = (char**)malloc(sizeof(char*) * (size_t)n);
+  if (!paths) return NULL;
+  for (long i = 0; i < n; i++) {
+    paths[i] = (char*)malloc(64);
+    if (paths[i]) snprintf(paths[i], 64, "/picked/assets/textures/tile_%06ld.png", i);
+  }
+  return paths;
+}
+
+static void bench_free_paths(char** paths, long n) {
+  for (long i = 0; paths && i < n; i++) free(paths[i]);
+  free(paths);
+}
+
+// The glue allocates and fills one result block per delivery; the memcpy from
+// a prebuilt block stands in for its UTF-8 writes (see bridge_bench.mjs).
+static void bench_deliver_multi(long n) {
+  static char names[8][48];
+  static int name_idx;
+  char** paths = bench_make_paths(n);
+  if (!paths) return;
+  size_t size = 0;
+  unsigned char* tmpl = pick__headless_build_result((const char* const*)paths, (int)n, &size);
+  bench_free_paths(paths, n);
+  if (!tmpl) return;
+
+  long iters = bench_iters(n);
+  size_t allocs = bench_allocs, frees = bench_frees;
+  double t0 = bench_now_ns();
+  for (long i = 0; i < iters; i++) {
+    int id = pick__alloc_req();
+    *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_MULTI, .multi_cb = bench_noop_multi };
+    unsigned char* buf = (unsigned char*)pick__result_alloc((int)size);
+    if (!buf) break;
+    memcpy(buf, tmpl, size);
+    pick__deliver_multi_buf(id, buf, (int)size);
+  }
+  double ns = bench_now_ns() - t0;
+  size_t case_allocs = bench_allocs - allocs, case_frees = bench_frees - frees;
+  PICK_FREE(tmpl);
+
+  char* name = names[name_idx++ % 8];
+  snprintf(name, 48, "deliver_multi_buf/%ld", n);
+  bench_record(name, n, iters, ns, case_allocs, case_frees);
+}
+
+// Builds the single-block layout every backend hands to pick_free_multiple().
+static char** bench_pack_paths(char** paths, long n) {
+  size_t bytes = 0;
+  for (long i = 0; i < n; i++) bytes += strlen(paths[i]) + 1;
+  char** table = (char**)PICK_MALLOC(sizeof(char*) * (size_t)n + bytes);
+  if (!table) return NULL;
+  char* cursor = (char*)(table + n);
+  for (long i = 0; i < n; i++) {
+    size_t len = strlen(paths[i]) + 1;
+    memcpy(cursor, paths[i], len);
+    table[i] = cursor;
+    cursor += len;
+  }
+  return table;
+}
+
+static void bench_free_multiple(long n) {
+  static char names[8][48];
+  static int name_idx;
+  char** paths = bench_make_paths(n);
+  if (!paths) return;
+
+  long iters = bench_iters(n);
+  double ns = 0;
+  size_t allocs = 0, frees = 0;
+  for (long i = 0; i < iters; i++) {
+    char** packed = bench_pack_paths(paths, n);
+    if (!packed) break;
+    size_t allocs_before = bench_allocs, frees_before = bench_frees;
+    double t0 = bench_now_ns();
+    pick_free_multiple(packed, (int)n);
+    ns += bench_now_ns() - t0;
+    allocs += bench_allocs - allocs_before;
+    frees += bench_frees - frees_before;
+  }
+  bench_free_paths(paths, n);
+
+  char* name = names[name_idx++ % 8];
+  snprintf(name, 48, "free_multiple/%ld", n);
+  bench_record(name, n, iters, ns, allocs, frees);
+}
+
+// Full public round trip: script an answer, issue the request, deliver via pick_poll().
+static void bench_headless_roundtrip(void) {
+  const char* path = "/picked/assets/readme.txt";
+  long iters = bench_iters(1);
+  size_t allocs = bench_allocs, frees = bench_frees;
+  double t0 = bench_now_ns();
+  for (long i = 0; i < iters; i++) {
+    pick_headless_push_paths(&path, 1, 0);
+    pick_file(NULL, bench_noop_single, NULL);
+    pick_poll();
+  }
+  bench_record("headless_roundtrip", 1, iters, bench_now_ns() - t0, bench_allocs - allocs, bench_frees - frees);
+}
+
+static void bench_print_table(void) {
+  printf("%-28s %8s %10s %12s %10s %10s %10s\n", "case", "n", "iters", "ns/op", "allocs/op", "frees/op", "rss_kb");
+  for (int i = 0; i < bench_result_count; i++) {
+    const bench_result_t* r = &bench_results[i];
+    printf("%-28s %8ld %10ld %12.1f %10.2f %10.2f %10ld\n", r->name, r->n, r->iters, r->ns_per_op,
+           r->allocs_per_op, r->frees_per_op, r->peak_rss_kb);
+  }
+}
+
+static void bench_print_json(void) {
+  printf("{\n  \"suite\": \"pick\",\n  \"results\": [\n");
+  for (int i = 0; i < bench_result_count; i++) {
+    const bench_result_t* r = &bench_results[i];
+    printf("    {\"name\": \"%s\", \"n\": %ld, \"iters\": %ld, \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, \"frees_per_op\": %.3f, \"peak_rss_kb\": %ld}%s\n",
+           r->name, r->n, r->iters, r->ns_per_op, r->allocs_per_op, r->frees_per_op, r->peak_rss_kb,
+           i + 1 < bench_result_count ? "," : "");
+  }
+  printf("  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+  bool json = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) json = true;
+    else if (strcmp(argv[i], "--quick") == 0) bench_quick = true;
+    else { fprintf(stderr, "usage: %s [--json] [--quick]\n", argv[0]); return 1; }
+  }
+
+  static const long sizes[] = { 1, 10, 100, 1000, 10000, 100000 };
+  const int size_count = (int)(sizeof(sizes) / sizeof(sizes[0]));
+
+  bench_alloc_clear();
+  bench_concurrent_reqs(64);
+  bench_concurrent_reqs(10000);
+  bench_concurrent_reqs(100000);
+  bench_deliver_stale();
+  bench_accept_string();
+  for (int i = 0; i < size_count; i++) bench_deliver_multi(sizes[i]);
+  for (int i = 0; i < size_count; i++) bench_free_multiple(sizes[i]);
+  bench_headless_roundtrip();
+
+  if (json) bench_print_json(); else bench_print_table();
+  return 0;
+}
@@ -0,0 +1,128 @@
+// Node benchmark for the JS -> C multi-path result bridge of the web backend.
+//
+//   node bridge_bench.mjs [count]      (default 100000 paths)
+//
+// "records" runs the real pick__call_deliver_multi body, lifted from ../pick.h,
+// against a flat heap: one allocation, each path UTF-8 encoded once into its
+// length-prefixed record. "joined" reproduces the previous protocol: join with
+// "\n", let ccall encode the joined string (emscripten's JS UTF-8 loops, onto
+// a stack that is only 64 KiB by default), then copy and split it again in C,
+// modelled here with typed-array loops. example/bench.c times the C delivery.
+import { loadEmJs } from "./emjs.mjs";
+
+const count = Number(process.argv[2] || 100000);
+const rounds = 25;
+
+const paths = [];
+for (let i = 0; i < count; i++) {
+  paths.push(`/picked/assets/textures/${i % 7 === 0 ? "ünïcödé_" : ""}tile_${String(i).padStart(6, "0")}.png`);
+}
+
+let heap = new Uint8Array(64 << 20);
+let top = 8;
+let delivered = null;
+const Module = {
+  ccall(name, ret, types, args) {
+    if (name === "pick__result_alloc") {
+      const ptr = (top + 7) & ~7;
+      top = ptr + args[0];
+      if (top > heap.length) { const grown = new Uint8Array(top * 2); grown.set(heap); heap = grown; }
+      return ptr;
+    }
+    if (name === "pick__deliver_multi_buf") { delivered = { ptr: args[1], size: args[2] }; return; }
+    throw new Error("unexpected ccall " + name);
+  }
+};
+const callDeliverMulti = loadEmJs("pick__call_deliver_multi", { Module, get HEAPU8() { return heap; } });
+
+// Decodes a result block the way pick__result_index() walks it.
+function decodeRecords(ptr, size) {
+  const view = new DataView(heap.buffer, ptr, size);
+  const n = view.getUint32(0, true);
+  const dec = new TextDecoder();
+  const out = [];
+  let off = 8 + n * 8;
+  for (let i = 0; i < n; i++) {
+    const len = view.getUint32(off, true);
+    out.push(dec.decode(heap.subarray(ptr + off + 4, ptr + off + 4 + len)));
+    off += 4 + len + 1;
+  }
+  return out;
+}
+
+function runRecords() {
+  top = 8;
+  callDeliverMulti(1, paths);
+  return delivered.size;
+}
+
+// What ccall(..., ["string"]) does with the joined text: emscripten's
+// lengthBytesUTF8() and stringToUTF8Array() loops, onto the stack.
+function utf8Length(str) {
+  let len = 0;
+  for (let i = 0; i < str.length; i++) {
+    const c = str.charCodeAt(i);
+    if (c <= 0x7f) len++;
+    else if (c <= 0x7ff) len += 2;
+    else if (c >= 0xd800 && c <= 0xdfff) { len += 4; i++; }
+    else len += 3;
+  }
+  return len;
+}
+
+function utf8Write(str, at) {
+  for (let i = 0; i < str.length; i++) {
+    let u = str.codePointAt(i);
+    if (u > 0xffff) i++;
+    if (u <= 0x7f) heap[at++] = u;
+    else if (u <= 0x7ff) { heap[at++] = 0xc0 | (u >> 6); heap[at++] = 0x80 | (u & 63); }
+    else if (u <= 0xffff) { heap[at++] = 0xe0 | (u >> 12); heap[at++] = 0x80 | ((u >> 6) & 63); heap[at++] = 0x80 | (u & 63); }
+    else { heap[at++] = 0xf0 | (u >> 18); heap[at++] = 0x80 | ((u >> 12) & 63); heap[at++] = 0x80 | ((u >> 6) & 63); heap[at++] = 0x80 | (u & 63); }
+  }
+  heap[at] = 0;
+}
+
+function runJoined() {
+  top = 8;
+  const joined = paths.join("\n");
+  const bytes = utf8Length(joined) + 1;
+  const arg = Module.ccall("pick__result_alloc", "number", ["number"], [bytes]);
+  utf8Write(joined, arg);
+  // pick__pack_lines(): copy the text behind a pointer table, split on '\n'.
+  const table = Module.ccall("pick__result_alloc", "number", ["number"], [count * 4 + bytes]);
+  heap.copyWithin(table + count * 4, arg, arg + bytes);
+  let found = 0;
+  for (let i = table + count * 4, end = i + bytes; i < end; i++) if (heap[i] === 10) { heap[i] = 0; found++; }
+  return bytes + found;
+}
+
+function time(fn) {
+  for (let i = 0; i < 3; i++) fn();
+  const samples = [];
+  for (let i = 0; i < rounds; i++) {
+    const t0 = process.hrtime.bigint();
+    fn();
+    samples.push(Number(process.hrtime.bigint() - t0) / 1e6);
+  }
+  samples.sort((a, b) => a - b);
+  return samples[samples.length >> 1];
+}
+
+// Round-trip check, including a name the joined protocol cannot carry.
+const tricky = ["/picked/a\nb.txt", "/picked/emoji_\u{1F600}.png", "/picked/lone_\uD800.bin"];
+top = 8;
+callDeliverMulti(1, tricky);
+const back = decodeRecords(delivered.ptr, delivered.size);
+const expect = tricky.map((p) => new TextDecoder().decode(new TextEncoder().encode(p)));
+if (JSON.stringify(back) !== JSON.stringify(expect)) throw new Error("record round trip failed: " + JSON.stringify(back));
+top = 8;
+callDeliverMulti(1, paths);
+if (decodeRecords(delivered.ptr, delivered.size).length !== count) throw new Error("record count mismatch");
+
+const recordsMs = time(runRecords);
+const joinedMs = time(runJoined);
+const recordBytes = runRecords();
+console.log(`paths             ${count}`);
+console.log(`records           ${recordsMs.toFixed(2)} ms   ${(recordBytes / 1048576).toFixed(2)} MiB block, 1 allocation`);
+console.log(`joined (previous) ${joinedMs.toFixed(2)} ms   join, encode onto the stack, copy and split in C`);
+console.log(`speedup           ${(joinedMs / recordsMs).toFixed(2)}x`);
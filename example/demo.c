@@ -525,6 +525,9 @@ int main(void) {
     emscripten_set_main_loop(update_frame, 0, 1);
 #else
     while (!WindowShouldClose()) {
+#ifdef PICK_PLATFORM_LINUX
+        pick_poll();
+#endif
         update_frame();
     }
 #endif
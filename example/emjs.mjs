@@ -0,0 +1,375 @@
+// Lifts EM_JS bodies out of ../pick.h so the web glue can be benchmarked under
+// node without an emscripten build, plus the MEMFS and OPFS stand-ins the
+// import benchmarks run it against.
+import { readFileSync, openSync, readSync, closeSync, statSync, mkdirSync, existsSync, readdirSync, renameSync } from "node:fs";
+import { open, rm } from "node:fs/promises";
+import { Worker as ThreadWorker } from "node:worker_threads";
+import { join } from "node:path";
+import { fileURLToPath } from "node:url";
+
+const header = readFileSync(fileURLToPath(new URL("../pick.h", import.meta.url)), "utf8");
+
+// `scope` supplies the globals a body uses (FS, Module, HEAPU8, other EM_JS
+// helpers); it is read on every call, so getters can hand out values that
+// change, such as a grown heap.
+export function loadEmJs(name, scope = {}) {
+  const sig = new RegExp(`EM_JS\\([^,]+,\\s*${name}\\s*,\\s*\\(([^)]*)\\),\\s*\\{`).exec(header);
+  if (!sig) throw new Error(`${name} not found in pick.h`);
+  const params = sig[1].split(",").map((p) => p.trim()).filter(Boolean).map((p) => p.split(/[\s*]+/).pop());
+  const start = sig.index + sig[0].length;
+  const body = header.slice(start, header.indexOf("\n});", start));
+  const names = Object.keys(scope);
+  const fn = new Function(...names, ...params, body);
+  return (...args) => fn(...names.map((k) => scope[k]), ...args);
+}
+
+// A body that uses nothing from outside as a plain function, whose
+// toString() is its source, as emscripten emits it.
+export function emJsFunction(name) {
+  const start = header.indexOf(`EM_JS(void, ${name}, (), {`);
+  if (start < 0) throw new Error(`${name} not found in pick.h`);
+  const body = header.slice(header.indexOf("{", start) + 1, header.indexOf("\n});", start));
+  return new Function(`return function ${name}() {${body}\n}`)();
+}
+
+// Stand-ins for Worker, Blob and URL.createObjectURL enough to start the
+// import worker (pick__js_open_import_worker) on a worker thread. Files are
+// passed as what diskFile() read them from, standing in for a File's
+// structured clone; the worker reads them with fs/promises.
+export function workerScope() {
+  const sources = new Map();
+  const prelude = `
+    const { parentPort } = require("node:worker_threads");
+    const { open } = require("node:fs/promises");
+    globalThis.self = globalThis;
+    self.postMessage = (m, t) => parentPort.postMessage(m, t);
+    const file = (f) => ({ slice: (a, b) => ({ arrayBuffer: async () => {
+      const out = new Uint8Array(b - a), fh = await open(f.path);
+      try { await fh.read(out, 0, out.length, f.start + a); } finally { await fh.close(); }
+      return out.buffer;
+    } }) });
+    parentPort.on("message", (m) => self.onmessage({ data: { ...m, file: file(m.file) } }));
+  `;
+  return {
+    Blob: class { constructor(parts) { this.text = parts.join(""); } },
+    URL: { createObjectURL: (blob) => { const url = `blob:pick/${sources.size}`; sources.set(url, blob.text); return url; } },
+    Worker: class {
+      constructor(url) {
+        this.thread = new ThreadWorker(prelude + sources.get(url), { eval: true });
+        this.thread.on("message", (data) => this.onmessage({ data }));
+        this.thread.on("error", (e) => this.onerror(e));
+        this.thread.unref();
+      }
+      postMessage(m) { this.thread.postMessage({ ...m, file: { path: m.file.path, start: m.file.start } }); }
+    },
+  };
+}
+
+// Just enough of MEMFS (library_memfs.js) to reproduce its allocations.
+// Writes and resizes go through the node's stream_ops and node_ops, as there.
+// analyzePath() and mkdir() resolve their path from the root one folder at
+// a time, as FS.lookupPath does, counting each step in `FS.lookups`.
+export function makeMemFS(sample = () => {}) {
+  const nodes = new Map();
+  const dirs = new Set(["/"]);
+  const fds = new Map();
+  let nextFd = 3;
+  function expand(node, want) {
+    const prev = node.contents ? node.contents.length : 0;
+    if (prev >= want) return;
+    let cap = Math.max(want, (prev * (prev < 1024 * 1024 ? 2.0 : 1.125)) >>> 0);
+    if (prev) cap = Math.max(cap, 256);
+    const old = node.contents;
+    node.contents = new Uint8Array(cap);
+    if (node.usedBytes) node.contents.set(old.subarray(0, node.usedBytes));
+    sample();
+  }
+  const stream_ops = {
+    llseek() {},
+    read(stream, buffer, offset, length, position) {
+      const node = stream.node, n = Math.max(0, Math.min(length, node.usedBytes - position));
+      if (n) buffer.set(node.contents.subarray(position, position + n), offset);
+      return n;
+    },
+    write(stream, buffer, offset, length, position) {
+      const node = stream.node;
+      if (node.usedBytes === 0 && position === 0) {
+        node.contents = buffer.slice(offset, offset + length);
+        node.usedBytes = length;
+      } else {
+        expand(node, position + length);
+        node.contents.set(buffer.subarray(offset, offset + length), position);
+        node.usedBytes = Math.max(node.usedBytes, position + length);
+      }
+      return length;
+    },
+  };
+  const node_ops = {
+    setattr(node, { size }) {
+      if (size === undefined || size === node.usedBytes) return;
+      const old = node.contents;
+      node.contents = new Uint8Array(size);
+      if (old) node.contents.set(old.subarray(0, Math.min(size, node.usedBytes)));
+      node.usedBytes = size;
+      sample();
+    },
+  };
+  // Resolves the parent folders of `p`; null if one is missing.
+  function walk(p) {
+    let at = "";
+    for (let i = p.indexOf("/", 1); i > 0; i = p.indexOf("/", i + 1)) {
+      FS.lookups++;
+      at = p.slice(0, i);
+      if (!dirs.has(at)) return null;
+    }
+    return at || "/";
+  }
+  const FS = {
+    nodes,
+    lookups: 0,
+    analyzePath(p) {
+      const parent = walk(p);
+      return { exists: parent !== null && (dirs.has(p) || nodes.has(p)) };
+    },
+    lookupPath(p) {
+      if (dirs.has(p)) return { node: { mode: 0o40755 } };
+      if (!nodes.has(p)) throw new FS.ErrnoError(44);
+      return { node: nodes.get(p) };
+    },
+    isDir: (mode) => (mode & 0o170000) === 0o40000,
+    readdir(p) {
+      const names = new Set([".", ".."]);
+      for (const q of [...nodes.keys(), ...dirs]) if (q.startsWith(p + "/")) names.add(q.slice(p.length + 1).split("/")[0]);
+      return [...names];
+    },
+    mkdir(p) {
+      if (walk(p) === null) throw new FS.ErrnoError(44);
+      if (dirs.has(p) || nodes.has(p)) throw new FS.ErrnoError(20);
+      dirs.add(p);
+    },
+    rmdir(p) {
+      for (const q of [...nodes.keys(), ...dirs]) if (q.startsWith(p + "/")) throw new FS.ErrnoError(55);
+      dirs.delete(p);
+    },
+    unlink: (p) => { nodes.delete(p); },
+    ErrnoError: class extends Error { constructor(errno) { super("errno " + errno); this.errno = errno; } },
+    create(path, mode) {
+      const node = { mode, contents: null, usedBytes: 0, stream_ops, node_ops };
+      nodes.set(path, node);
+      return node;
+    },
+    open(path, flags = "w") {
+      let node = nodes.get(path);
+      if (flags !== "r") nodes.set(path, node = { contents: null, usedBytes: 0, stream_ops, node_ops });
+      else if (!node) throw new FS.ErrnoError(44);
+      const stream = { fd: nextFd++, node, position: 0 };
+      fds.set(stream.fd, stream);
+      return stream;
+    },
+    close(stream) { fds.delete(stream.fd); },
+    stat(path) {
+      if (!nodes.has(path)) throw new FS.ErrnoError(44);
+      return { size: nodes.get(path).usedBytes };
+    },
+    read(stream, buffer, offset, length, position) {
+      const n = stream.node.stream_ops.read(stream, buffer, offset, length, position);
+      sample();
+      return n;
+    },
+    readFile(path) {
+      const node = nodes.get(path);
+      if (!node) throw new FS.ErrnoError(44);
+      const out = node.contents.slice(0, node.usedBytes);
+      sample();
+      return out;
+    },
+    ftruncate(fd, len) {
+      const node = fds.get(fd).node;
+      node.node_ops.setattr(node, { size: len });
+    },
+    write(stream, buffer, offset, length, position) {
+      sample();
+      if (position === undefined) position = stream.position;
+      if (!length) return 0;
+      stream.node.stream_ops.write(stream, buffer, offset, length, position);
+      stream.position = position + length;
+      sample();
+      return length;
+    },
+    writeFile(path, data) {
+      const stream = FS.open(path);
+      FS.write(stream, data, 0, data.length, 0);
+      FS.close(stream);
+    },
+  };
+  return FS;
+}
+
+// A File over a byte range of a file on disk. `bytes` reads it synchronously
+// for the FileReaderSync stand-ins.
+export function diskFile(path, start = 0, end = statSync(path).size) {
+  const read = () => {
+    const out = new Uint8Array(end - start);
+    const fd = openSync(path, "r");
+    try { readSync(fd, out, 0, out.length, start); } finally { closeSync(fd); }
+    return out;
+  };
+  return {
+    path, start,
+    size: end - start,
+    lastModified: Math.floor(statSync(path).mtimeMs),
+    slice: (a = 0, b = end - start) => diskFile(path, start + Math.min(a, end - start), start + Math.min(b, end - start)),
+    async arrayBuffer() {
+      const out = new Uint8Array(end - start), fh = await open(path);
+      try { await fh.read(out, 0, out.length, start); } finally { await fh.close(); }
+      return out.buffer;
+    },
+    text: async () => new TextDecoder().decode(read()),
+    get bytes() { return read(); },
+  };
+}
+
+// Enough of an OPFS FileSystemDirectoryHandle for the spill and cache paths
+// and the folder walks, backed by a directory on disk.
+export function makeOpfsDir(dir) {
+  mkdirSync(dir, { recursive: true });
+  const missing = (name) => Object.assign(new Error(name + " not found"), { name: "NotFoundError" });
+  const handle = {
+    kind: "directory",
+    async getDirectoryHandle(name, { create = false } = {}) {
+      if (!create && !existsSync(join(dir, name))) throw missing(name);
+      return makeOpfsDir(join(dir, name));
+    },
+    async getFileHandle(name, { create = false } = {}) {
+      const path = join(dir, name);
+      if (!existsSync(path)) {
+        if (!create) throw missing(name);
+        closeSync(openSync(path, "w"));
+      }
+      return {
+        kind: "file",
+        async createWritable() {
+          const fh = await open(path + ".crswap", "w");
+          let pos = 0;
+          return {
+            async write(data) {
+              const bytes = typeof data === "string" ? new TextEncoder().encode(data)
+                          : new Uint8Array(data instanceof ArrayBuffer || ArrayBuffer.isView(data) ? data : await data.arrayBuffer());
+              await fh.write(bytes, 0, bytes.length, pos);
+              pos += bytes.length;
+            },
+            async close() { await fh.close(); renameSync(path + ".crswap", path); },
+            async abort() { await fh.close(); await rm(path + ".crswap", { force: true }); },
+          };
+        },
+        getFile: async () => diskFile(path),
+      };
+    },
+    async *keys() { for (const name of readdirSync(dir)) if (!name.endsWith(".crswap")) yield name; },
+    async *entries() {
+      for await (const name of handle.keys()) {
+        yield [name, statSync(join(dir, name)).isDirectory() ? makeOpfsDir(join(dir, name)) : await handle.getFileHandle(name)];
+      }
+    },
+    async removeEntry(name, { recursive = false } = {}) {
+      if (!existsSync(join(dir, name))) throw missing(name);
+      await rm(join(dir, name), { recursive });
+    },
+  };
+  return handle;
+}
+
+// Opens the real import cache (pick__js_open_import_cache) over `root`.
+export function openImportCache(root, cap, hash = 0) {
+  return loadEmJs("pick__js_open_import_cache", {
+    Module: {},
+    navigator: { storage: { getDirectory: async () => root } },
+    FileSystemFileHandle: { prototype: { createWritable() {} } },
+  })(cap, hash);
+}
+
+// Opens the real import deduplication table (pick__js_open_dedup).
+export function openDedup() {
+  return loadEmJs("pick__js_open_dedup", { pick__js_xxh32: emJsFunction("pick__js_xxh32") })();
+}
+
+// The import glue over `FS`, as the dialog's Import button and
+// pick_folder_resync() run it. Every call is a request of its own, imports
+// under /picked/<id> and resolves with what it delivers: the paths, the
+// resync's change list ('+', '~' or '-' before each path), or null once
+// `progress` returns false, which stands in for a progress callback that
+// aborts the request.
+// `spillDir` (see makeOpfsDir) is where files past `maxBytes` go; `cache`
+// is an import cache from openImportCache(), `dedup` a table from openDedup().
+// `storage` ({ maxBytes, maxAge }) turns on the eviction policy; its
+// tracker is then Module.__pickStore. `worker` starts the import worker on a
+// worker thread (see workerScope); it reads only diskFile() files.
+export function makeGlue(FS, { chunk = 4194304, lazy = 0, concurrency = 8, walkConcurrency = 16, progressHz = 10, progress = () => true,
+                               maxBytes = 0, spillDir = null, cache = null, dedup = null, storage = null, worker = false, scope = {} } = {}) {
+  const Module = { __pickChosen: [], __pickSpill: Promise.resolve(spillDir), __pickCache: Promise.resolve(cache), __pickDedup: dedup,
+                   __pickImport: { base: "/picked", chunk, lazy, concurrency, walkConcurrency, progressHz, maxBytes } };
+  const pending = new Map();
+  const settle = (id, value) => {
+    const p = pending.get(id);
+    if (!p) return;
+    pending.delete(id);
+    if (value instanceof Error) p.reject(value); else p.resolve(value);
+  };
+  const glue = {
+    FS, Module,
+    UTF8ToString: (x) => x,
+    pick__call_req_alive: (id) => (pending.has(id) ? 1 : 0),
+    pick__call_progress: (id, ...counts) => {
+      if (pending.has(id) && !progress(...counts)) settle(id, null);
+      return pending.has(id) ? 1 : 0;
+    },
+    pick__call_deliver_multi: (id, paths) => settle(id, paths),
+    pick__call_deliver_single: (id, p) => settle(id, p ? [p] : new Error("request failed")),
+    pick__js_create_lazy_file: loadEmJs("pick__js_create_lazy_file", { FS, UTF8ToString: (x) => x, ...scope }),
+  };
+  glue.pick__js_release = loadEmJs("pick__js_release", glue);
+  const releaseRequest = loadEmJs("pick__js_release_request", glue);
+  if (worker) Module.__pickWorker = loadEmJs("pick__js_open_import_worker", { ...workerScope(), pick__js_xxh32: emJsFunction("pick__js_xxh32") })();
+  if (storage) Module.__pickStore = loadEmJs("pick__js_open_store", glue)(storage.maxBytes || 0, storage.maxAge || 0);
+  glue.pick__js_walk_dir = loadEmJs("pick__js_walk_dir", glue);
+  glue.pick__js_import_files_to_memfs = loadEmJs("pick__js_import_files_to_memfs", glue);
+  const resync = loadEmJs("pick__js_folder_resync", glue);
+  let nextId = 1;
+  const request = (start) => {
+    const id = nextId++;
+    const done = new Promise((resolve, reject) => pending.set(id, { resolve, reject }));
+    start(id);
+    return { id, done };
+  };
+  const importChosen = (id) => glue.pick__js_import_files_to_memfs("/picked/" + id, id, 1, chunk, lazy, concurrency, progressHz, maxBytes, 0);
+  return {
+    Module,
+    import(chosen) {
+      Module.__pickChosen = chosen;
+      return request(importChosen).done;
+    },
+    // Picks `dir` (a makeOpfsDir handle) as showDirectoryPicker would, with
+    // PickFilter extensions as an `accept` list (".png,.jpg") and `exclude`
+    // globs; resolves to { id, paths }, the id being what pick_folder_resync() takes.
+    async pickFolder(dir, { accept = "", exclude = [] } = {}) {
+      const filter = loadEmJs("pick__js_path_filter")(accept, exclude.join("\n"));
+      const r = request((id) => glue.pick__js_walk_dir(dir, id, 0, filter).then((found) => {
+        Module.__pickChosen = found;
+        Module.__pickChosenDir = { handle: dir, filter };
+        importChosen(id);
+      }));
+      return { id: r.id, paths: await r.done };
+    },
+    resync(folderId) {
+      return request((id) => { if (!resync(id, folderId)) settle(id, new Error("no folder kept for " + folderId)); }).done;
+    },
+    // pick_release() and pick_release_request().
+    release: (paths) => paths.reduce((n, p) => n + glue.pick__js_release(p), 0),
+    releaseRequest: (id) => releaseRequest(id),
+  };
+}
+
+// One import of `chosen` through a fresh glue (see makeGlue).
+export function importWithGlue(FS, chosen, options = {}) {
+  return makeGlue(FS, options).import(chosen);
+}
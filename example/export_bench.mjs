@@ -0,0 +1,121 @@
+// Node benchmark for exporting large files with pick_export_file and
+// pick_export_buffer.
+//
+//   node --expose-gc export_bench.mjs [size_mb ...] [--chunk=bytes]
+//                                      (default sizes 100 512, chunk 4 MiB)
+//
+// Runs the real pick__js_export body from ../pick.h over the makeMemFS
+// stand-in. "save picker" goes through a showSaveFilePicker stand-in whose
+// createWritable() writes to a file on disk (makeOpfsDir); "download" is the
+// fallback without it, which assembles a Blob and clicks a download link.
+// "whole file (previous)" is the export it replaces: FS.readFile() of the
+// whole file, wrapped in a Blob. The "buffer" runs export bytes from the wasm
+// heap with pick_export_buffer; "via MEMFS (previous)" is how that was done
+// before, writing them to a MEMFS file first and exporting that with the
+// whole-file export. "peak extra" is the most array-buffer memory
+// held beyond the source while exporting. A browser moves Blob contents
+// out of the page's heap, where node keeps them as array buffers, so the
+// bytes handed to Blobs are not counted. Chunks the collector has not
+// reclaimed yet do count, so the chunked figures are a few chunks. Every
+// export must produce the file's bytes.
+import { mkdtempSync, rmSync, statSync, openSync, readSync, closeSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { loadEmJs, makeMemFS, makeOpfsDir } from "./emjs.mjs";
+
+const args = process.argv.slice(2);
+const chunkArg = args.find((a) => a.startsWith("--chunk="));
+const chunk = chunkArg ? Number(chunkArg.slice(8)) : 4 * 1024 * 1024;
+const sizesMb = args.filter((a) => !a.startsWith("--")).map(Number);
+const sizes = (sizesMb.length ? sizesMb : [100, 512]).map((mb) => mb * 1024 * 1024);
+
+let peak = 0, inBlobs = 0;
+const sample = () => { peak = Math.max(peak, process.memoryUsage().arrayBuffers - inBlobs); };
+// A Blob counting the bytes copied into it; Blobs made of Blobs copy nothing.
+class CountedBlob extends Blob {
+  constructor(parts, options) {
+    super(parts, options);
+    for (const p of parts) if (!(p instanceof Blob)) inBlobs += p.byteLength;
+    sample();
+  }
+}
+const root = mkdtempSync(join(tmpdir(), "pick_export_bench_"));
+const disk = makeOpfsDir(root);
+
+// Exports `src`, or `len` bytes of `heap` from `data` on, through
+// pick__js_export; resolves to the Blob downloaded, or null when it went to
+// the save picker.
+function exportFile(FS, src, picker, heap = null, data = 0, len = 0) {
+  return new Promise((resolve, reject) => {
+    let blob = null;
+    const window = picker ? { showSaveFilePicker: async ({ suggestedName }) => disk.getFileHandle(suggestedName, { create: true }) } : {};
+    const document = {
+      createElement: () => ({ click() { blob = this.href; }, remove() {} }),
+      body: { appendChild() {} },
+    };
+    const URL = { createObjectURL: (b) => b, revokeObjectURL() {} };
+    loadEmJs("pick__js_export", {
+      FS, window, document, URL, Blob: CountedBlob, HEAPU8: heap,
+      Module: { __pickImport: { chunk } },
+      UTF8ToString: (x) => x,
+      pick__call_req_alive: () => 1,
+      pick__call_deliver_msg: (id, button) => (button ? reject(new Error("export failed")) : resolve(blob)),
+    })(1, src, data, len, "exported.bin");
+  });
+}
+
+// The source's bytes: the page number at the start of every 4 KiB page.
+const HEAD = 64;
+function fill(bytes, at, size) { for (let i = 0; i < size; i += 4096) bytes[at + i] = (i >>> 12) & 255; }
+function same(size, got, label) {
+  if (got.length !== size) throw new Error(`${label}: ${got.length} of ${size} bytes`);
+  for (let i = 0; i < size; i += 4093) if (got[i] !== (i % 4096 ? 0 : (i >>> 12) & 255)) throw new Error(`${label}: byte ${i} differs`);
+}
+
+// `body` gets a MEMFS holding /saved/big.bin, or with `fromHeap` a heap
+// holding the bytes after HEAD bytes of other data.
+async function run(label, size, fromHeap, body) {
+  const FS = makeMemFS(sample);
+  let heap = null;
+  if (fromHeap) {
+    heap = new Uint8Array(HEAD + size);
+    fill(heap, HEAD, size);
+  } else {
+    const bytes = new Uint8Array(size);
+    fill(bytes, 0, size);
+    FS.mkdir("/saved");
+    FS.writeFile("/saved/big.bin", bytes);
+  }
+  if (global.gc) global.gc();
+  inBlobs = 0;
+  const baseline = process.memoryUsage().arrayBuffers;
+  peak = baseline;
+  const t0 = process.hrtime.bigint();
+  const blob = await body(FS, heap);
+  const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+  const extra = Math.max(0, peak - baseline);
+  if (blob) same(size, new Uint8Array(await blob.arrayBuffer()), label);
+  else {
+    const path = join(root, "exported.bin"), got = new Uint8Array(statSync(path).size), fd = openSync(path, "r");
+    try { readSync(fd, got, 0, got.length, 0); } finally { closeSync(fd); }
+    same(size, got, label);
+  }
+  console.log(`${label.padEnd(22)} ${(size / 1048576).toFixed(0).padStart(6)} MiB  ${ms.toFixed(1).padStart(8)} ms  peak extra ${(extra / 1048576).toFixed(1).padStart(8)} MiB`);
+}
+
+console.log(`chunk ${chunk} bytes${global.gc ? "" : " (run with --expose-gc for steadier figures)"}`);
+try {
+  for (const size of sizes) {
+    await run("save picker (pick.h)", size, false, (FS) => exportFile(FS, "/saved/big.bin", true));
+    await run("download (pick.h)", size, false, (FS) => exportFile(FS, "/saved/big.bin", false));
+    await run("whole file (previous)", size, false, async (FS) => new CountedBlob([FS.readFile("/saved/big.bin")]));
+    await run("buffer, save picker", size, true, (FS, heap) => exportFile(FS, "", true, heap, HEAD, size));
+    await run("buffer, download", size, true, (FS, heap) => exportFile(FS, "", false, heap, HEAD, size));
+    await run("via MEMFS (previous)", size, true, async (FS, heap) => {
+      FS.writeFile("/export.bin", heap.subarray(HEAD));
+      return new CountedBlob([FS.readFile("/export.bin")]);
+    });
+  }
+} finally {
+  rmSync(root, { recursive: true, force: true });
+}
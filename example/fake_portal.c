@@ -0,0 +1,235 @@
+// A scripted org.freedesktop.portal.FileChooser and org.freedesktop.Notifications
+// for portal_test.c. Run it on a private session bus (see `make portal-test`).
+//
+// The dialog title (file chooser) or summary (notification) picks what happens:
+//
+//   respond:N      reply with the request handle, then a Response with N uris
+//   respond-first  send the Response before the method reply, as a fast portal can
+//   hold           reply only after 200 ms, and never respond
+//   silent         reply at once, and never respond
+//   yes            reply with a notification id, then ActionInvoked "yes"
+//
+// A request object exists once its method reply is sent, and Request.Close only
+// counts on one that exists, as with a real portal; CloseNotification always
+// counts. The test reads the count through org.pick.FakePortal.Closes and ends
+// the service with Quit.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <dbus/dbus.h>
+
+#define FAKE_IFACE "org.pick.FakePortal"
+
+typedef struct fake_send_t {
+  struct fake_send_t* next;
+  double              due_ms;
+  DBusMessage*        msg;
+  char                path[256];  ///< Request object that exists once `msg` is sent
+} fake_send_t;
+
+static DBusConnection* fake_bus;
+static fake_send_t*    fake_queue;
+static dbus_uint32_t   fake_closes;
+static dbus_uint32_t   fake_notify_id;
+static bool            fake_quit;
+static char            fake_live[64][256];
+static int             fake_live_count;
+
+static double fake_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+// Sends `msg` after `delay_ms`, keeping the order of messages queued with the same delay.
+static fake_send_t* fake_send_later(DBusMessage* msg, double delay_ms) {
+  fake_send_t* s = (fake_send_t*)calloc(1, sizeof(fake_send_t));
+  if (!s) { dbus_message_unref(msg); return NULL; }
+  s->due_ms = fake_now_ms() + delay_ms;
+  s->msg = msg;
+  fake_send_t** it = &fake_queue;
+  while (*it && (*it)->due_ms <= s->due_ms) it = &(*it)->next;
+  s->next = *it;
+  *it = s;
+  return s;
+}
+
+static bool fake_is_live(const char* path) {
+  for (int i = 0; i < fake_live_count; i++) {
+    if (strcmp(fake_live[i], path) == 0) return true;
+  }
+  return false;
+}
+
+static int fake_flush_due(void) {
+  double now = fake_now_ms();
+  while (fake_queue && fake_queue->due_ms <= now) {
+    fake_send_t* s = fake_queue;
+    fake_queue = s->next;
+    if (s->path[0] && fake_live_count < 64) snprintf(fake_live[fake_live_count++], sizeof(fake_live[0]), "%s", s->path);
+    dbus_connection_send(fake_bus, s->msg, NULL);
+    dbus_message_unref(s->msg);
+    free(s);
+  }
+  dbus_connection_flush(fake_bus);
+  return fake_queue ? (int)(fake_queue->due_ms - now) + 1 : 100;
+}
+
+// The request object path the portal derives from the caller's name and handle_token.
+static void fake_request_path(DBusMessage* call, const char* token, char* out, size_t cap) {
+  const char* sender = dbus_message_get_sender(call);
+  if (*sender == ':') sender++;
+  size_t used = (size_t)snprintf(out, cap, "/org/freedesktop/portal/desktop/request/");
+  for (const char* p = sender; *p && used + 1 < cap; p++) out[used++] = (*p == '.') ? '_' : *p;
+  snprintf(out + used, cap - used, "/%s", token);
+}
+
+static const char* fake_handle_token(DBusMessageIter* args) {
+  DBusMessageIter dict, entry, variant;
+  dbus_message_iter_recurse(args, &dict);
+  for (; dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY; dbus_message_iter_next(&dict)) {
+    const char* key = NULL;
+    dbus_message_iter_recurse(&dict, &entry);
+    dbus_message_iter_get_basic(&entry, &key);
+    if (strcmp(key, "handle_token") != 0) continue;
+    dbus_message_iter_next(&entry);
+    dbus_message_iter_recurse(&entry, &variant);
+    if (dbus_message_iter_get_arg_type(&variant) != DBUS_TYPE_STRING) return NULL;
+    const char* token = NULL;
+    dbus_message_iter_get_basic(&variant, &token);
+    return token;
+  }
+  return NULL;
+}
+
+// Response(u response, a{sv} results) with `uris` set to `count` file:// uris.
+static DBusMessage* fake_response(DBusMessage* call, const char* path, int count) {
+  DBusMessage* sig = dbus_message_new_signal(path, "org.freedesktop.portal.Request", "Response");
+  dbus_message_set_destination(sig, dbus_message_get_sender(call));
+  dbus_uint32_t response = 0;
+  const char* key = "uris";
+  DBusMessageIter args, dict, entry, variant, list;
+  dbus_message_iter_init_append(sig, &args);
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_UINT32, &response);
+  dbus_message_iter_open_container(&args, DBUS_TYPE_ARRAY, "{sv}", &dict);
+  dbus_message_iter_open_container(&dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, "as", &variant);
+  dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, "s", &list);
+  for (int i = 0; i < count; i++) {
+    char uri[64];
+    snprintf(uri, sizeof(uri), "file:///tmp/picked%%20%d.txt", i + 1);
+    const char* u = uri;
+    dbus_message_iter_append_basic(&list, DBUS_TYPE_STRING, &u);
+  }
+  dbus_message_iter_close_container(&variant, &list);
+  dbus_message_iter_close_container(&entry, &variant);
+  dbus_message_iter_close_container(&dict, &entry);
+  dbus_message_iter_close_container(&args, &dict);
+  return sig;
+}
+
+static void fake_file_chooser(DBusMessage* call) {
+  const char* parent = NULL;
+  const char* title = NULL;
+  DBusMessageIter args;
+  dbus_message_iter_init(call, &args);
+  dbus_message_iter_get_basic(&args, &parent);
+  dbus_message_iter_next(&args);
+  dbus_message_iter_get_basic(&args, &title);
+  dbus_message_iter_next(&args);
+  const char* token = fake_handle_token(&args);
+
+  char path[256];
+  fake_request_path(call, token ? token : "none", path, sizeof(path));
+  const char* p = path;
+  DBusMessage* reply = dbus_message_new_method_return(call);
+  dbus_message_append_args(reply, DBUS_TYPE_OBJECT_PATH, &p, DBUS_TYPE_INVALID);
+
+  fake_send_t* sent;
+  if (strncmp(title, "respond:", 8) == 0) {
+    sent = fake_send_later(reply, 0);
+    fake_send_later(fake_response(call, path, atoi(title + 8)), 20);
+  } else if (strcmp(title, "respond-first") == 0) {
+    fake_send_later(fake_response(call, path, 1), 0);
+    sent = fake_send_later(reply, 50);
+  } else if (strcmp(title, "hold") == 0) {
+    sent = fake_send_later(reply, 200);
+  } else {
+    sent = fake_send_later(reply, 0);
+  }
+  if (sent) snprintf(sent->path, sizeof(sent->path), "%s", path);
+}
+
+static void fake_notify(DBusMessage* call) {
+  const char* app = NULL;
+  dbus_uint32_t replaces = 0;
+  const char* icon = NULL;
+  const char* summary = NULL;
+  dbus_message_get_args(call, NULL, DBUS_TYPE_STRING, &app, DBUS_TYPE_UINT32, &replaces,
+                        DBUS_TYPE_STRING, &icon, DBUS_TYPE_STRING, &summary, DBUS_TYPE_INVALID);
+
+  dbus_uint32_t id = ++fake_notify_id;
+  DBusMessage* reply = dbus_message_new_method_return(call);
+  dbus_message_append_args(reply, DBUS_TYPE_UINT32, &id, DBUS_TYPE_INVALID);
+  fake_send_later(reply, 0);
+
+  if (summary && strcmp(summary, "yes") == 0) {
+    const char* action = "yes";
+    DBusMessage* sig = dbus_message_new_signal("/org/freedesktop/Notifications",
+                                               "org.freedesktop.Notifications", "ActionInvoked");
+    dbus_message_append_args(sig, DBUS_TYPE_UINT32, &id, DBUS_TYPE_STRING, &action, DBUS_TYPE_INVALID);
+    fake_send_later(sig, 20);
+  }
+}
+
+static DBusHandlerResult fake_filter(DBusConnection* bus, DBusMessage* msg, void* unused) {
+  (void)bus; (void)unused;
+  if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL) return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  if (dbus_message_is_method_call(msg, "org.freedesktop.portal.FileChooser", "OpenFile") ||
+      dbus_message_is_method_call(msg, "org.freedesktop.portal.FileChooser", "SaveFile")) {
+    fake_file_chooser(msg);
+  } else if (dbus_message_is_method_call(msg, "org.freedesktop.Notifications", "Notify")) {
+    fake_notify(msg);
+  } else if (dbus_message_is_method_call(msg, "org.freedesktop.portal.Request", "Close")) {
+    if (fake_is_live(dbus_message_get_path(msg))) fake_closes++;
+    if (!dbus_message_get_no_reply(msg)) fake_send_later(dbus_message_new_method_return(msg), 0);
+  } else if (dbus_message_is_method_call(msg, "org.freedesktop.Notifications", "CloseNotification")) {
+    fake_closes++;
+    if (!dbus_message_get_no_reply(msg)) fake_send_later(dbus_message_new_method_return(msg), 0);
+  } else if (dbus_message_is_method_call(msg, FAKE_IFACE, "Closes")) {
+    DBusMessage* reply = dbus_message_new_method_return(msg);
+    dbus_message_append_args(reply, DBUS_TYPE_UINT32, &fake_closes, DBUS_TYPE_INVALID);
+    fake_send_later(reply, 0);
+  } else if (dbus_message_is_method_call(msg, FAKE_IFACE, "Quit")) {
+    fake_send_later(dbus_message_new_method_return(msg), 0);
+    fake_quit = true;
+  } else {
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  }
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+int main(void) {
+  DBusError err;
+  dbus_error_init(&err);
+  fake_bus = dbus_bus_get(DBUS_BUS_SESSION, &err);
+  if (!fake_bus) { fprintf(stderr, "fake_portal: %s\n", err.message); return 1; }
+  dbus_connection_add_filter(fake_bus, fake_filter, NULL, NULL);
+
+  static const char* const names[] = { "org.freedesktop.portal.Desktop", "org.freedesktop.Notifications", FAKE_IFACE };
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (dbus_bus_request_name(fake_bus, names[i], DBUS_NAME_FLAG_DO_NOT_QUEUE, &err) != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+      fprintf(stderr, "fake_portal: cannot own %s\n", names[i]);
+      return 1;
+    }
+  }
+
+  int wait_ms = 100;
+  while (!fake_quit && dbus_connection_read_write_dispatch(fake_bus, wait_ms)) wait_ms = fake_flush_due();
+  fake_flush_due();
+  return 0;
+}
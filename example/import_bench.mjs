@@ -0,0 +1,162 @@
+// Node benchmark for the web backend's import of picked files into MEMFS.
+//
+//   node --expose-gc import_bench.mjs [size_mb ...] [--chunk=bytes]
+//                                      (default sizes 10 500 2048, chunk 4 MiB)
+//
+// Runs the real pick__js_import_files_to_memfs body from ../pick.h against a
+// disk-backed Blob (fs.openAsBlob, like a browser File) and a stand-in for
+// MEMFS that reproduces its storage rules: FS.writeFile copies the caller's
+// array, appends grow the node geometrically, ftruncate sizes it exactly.
+// "lazy" is PICK_EM_LAZY_IMPORT: its time is the time to the callback, and
+// its reads are checked separately against an in-memory file. "spilled" runs
+// with a PICK_EM_MAX_IMPORT_BYTES budget the file does not fit, so it is
+// streamed into an OPFS stand-in on disk; a mixed import checks that files
+// within the budget still land in the heap and spilled ones read back intact.
+// "in heap" is what the imported file occupies in MEMFS. "peak extra" is the
+// most array-buffer memory held beyond that; slices the collector has not
+// reclaimed yet count too, so the chunked figure is a few chunks rather than
+// exactly one. The previous whole-file
+// import (arrayBuffer + FS.writeFile) is measured alongside it up to 1 GiB,
+// since beyond that it needs twice the file size in RAM. The release check
+// imports twice, into a request namespace each, then pick_release()s one
+// request's files and pick_release_request()s the other: array buffers must
+// fall back to where they were before the imports and the spill files go.
+import { openAsBlob, openSync, ftruncateSync, closeSync, unlinkSync, mkdtempSync, rmSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { makeMemFS, makeOpfsDir, makeGlue, importWithGlue } from "./emjs.mjs";
+
+const args = process.argv.slice(2);
+const chunkArg = args.find((a) => a.startsWith("--chunk="));
+const chunk = chunkArg ? Number(chunkArg.slice(8)) : 4 * 1024 * 1024;
+const sizesMb = args.filter((a) => !a.startsWith("--")).map(Number);
+const sizes = (sizesMb.length ? sizesMb : [10, 500, 2048]).map((mb) => mb * 1024 * 1024);
+const LEGACY_LIMIT = 1024 * 1024 * 1024;
+
+let peak = 0;
+function sample() {
+  const used = process.memoryUsage().arrayBuffers;
+  if (used > peak) peak = used;
+}
+
+async function legacyImport(FS, chosen, base) {
+  for (const { file, rel } of chosen) {
+    const ab = await file.arrayBuffer();
+    sample();
+    FS.writeFile(base + "/" + rel, new Uint8Array(ab));
+  }
+}
+
+const spillRoot = mkdtempSync(join(tmpdir(), "pick_import_bench_opfs_"));
+const spillDir = makeOpfsDir(spillRoot);
+const FileReaderSync = class { readAsArrayBuffer(blob) { return blob.bytes.slice().buffer; } };
+
+function memFile(bytes) {
+  return { size: bytes.length, slice: (a, b) => ({ bytes: bytes.subarray(a, b), arrayBuffer: async () => bytes.slice(a, b).buffer }) };
+}
+
+function checkReads(node, bytes, label) {
+  const stream = { node };
+  for (const [pos, len] of [[0, 16], [chunk - 5, 10], [bytes.length - 7, 64], [3 * chunk + 1, 2 * chunk]]) {
+    const buf = new Uint8Array(len);
+    const n = node.stream_ops.read(stream, buf, 0, len, pos);
+    const want = bytes.subarray(pos, pos + len);
+    if (n !== want.length || !buf.subarray(0, n).every((b, i) => b === want[i])) throw new Error(`${label} read at ${pos} mismatched`);
+  }
+}
+
+// Lazy reads, served through a FileReaderSync stand-in, must match the file,
+// whether they come from the picked File or its spilled copy.
+async function checkLazyReads() {
+  const bytes = new Uint8Array(10 * 1024 * 1024 + 123);
+  for (let i = 0; i < bytes.length; i++) bytes[i] = (i * 2654435761) >>> 24;
+  let FS = makeMemFS(sample);
+  const [lazyPath] = await importWithGlue(FS, [{ file: memFile(bytes), rel: "lazy.bin" }], { chunk, lazy: 1, scope: { FileReaderSync } });
+  checkReads(FS.nodes.get(lazyPath), bytes, "lazy");
+  console.log("lazy reads match");
+
+  FS = makeMemFS(sample);
+  const small = bytes.subarray(0, 1000);
+  const chosen = [{ file: memFile(small), rel: "small.bin" }, { file: memFile(bytes), rel: "big.bin" }, { file: memFile(small), rel: "small2.bin" }];
+  const paths = await importWithGlue(FS, chosen, { chunk, maxBytes: 4096, spillDir, scope: { FileReaderSync } });
+  const kinds = paths.map((p) => FS.nodes.get(p).pickStorage);
+  if (kinds.join() !== "2,4,2") throw new Error(`spilled storage kinds ${kinds}`);
+  checkReads(FS.nodes.get(paths[1]), bytes, "spilled");
+  console.log("spilled reads match, files within the budget stay in the heap");
+}
+
+// Imported files give their memory and spill files back once released.
+async function checkRelease() {
+  if (!global.gc) { console.log("release check skipped: run with --expose-gc"); return; }
+  const settle = async () => { for (let i = 0; i < 3; i++) { await new Promise((r) => setTimeout(r, 10)); global.gc(); } };
+  const files = [];
+  for (let i = 0; i < 8; i++) files.push(memFile(new Uint8Array(8 * 1024 * 1024).fill(i + 1)));
+  const chosen = files.map((file, i) => ({ file, rel: `release/${i % 2}/f${i}.bin` }));
+  const FS = makeMemFS();
+  const glue = makeGlue(FS, { chunk, maxBytes: 48 * 1024 * 1024, spillDir, scope: { FileReaderSync } });
+  const spills = async () => { let n = 0; for await (const _ of spillDir.keys()) n++; return n; };
+  const before = await spills();
+  await settle();
+  const baseline = process.memoryUsage().arrayBuffers;
+  const first = await glue.import(chosen);
+  const second = await glue.import(chosen);
+  if (first[0] === second[0]) throw new Error("two requests imported to the same path");
+  await settle();
+  const held = process.memoryUsage().arrayBuffers - baseline;
+  const spilled = await spills() - before;
+  const released = glue.release(first) + glue.releaseRequest(2);
+  await settle();
+  const left = process.memoryUsage().arrayBuffers - baseline;
+  if (released !== 16 || FS.nodes.size || left > 1048576 || !spilled || await spills() !== before) {
+    throw new Error(`release: ${released} files removed, ${FS.nodes.size} left, ${left} bytes held, ${await spills() - before} spill files`);
+  }
+  console.log(`release: ${(held / 1048576).toFixed(0)} MiB and ${spilled} spill files held by two imports, ` +
+              `${(left / 1048576).toFixed(1)} MiB after releasing them`);
+}
+
+async function run(label, size, body) {
+  if (global.gc) global.gc();
+  const FS = makeMemFS(sample);
+  const baseline = process.memoryUsage().arrayBuffers;
+  peak = baseline;
+  const t0 = process.hrtime.bigint();
+  await body(FS);
+  const secs = Number(process.hrtime.bigint() - t0) / 1e9;
+  const node = FS.nodes.get("/picked/1/asset.bin");
+  if (!node || node.usedBytes !== size) throw new Error(`${label}: imported ${node ? node.usedBytes : 0} of ${size} bytes`);
+  const heap = node.contents ? node.contents.length : 0;
+  const extra = Math.max(0, peak - baseline - heap);
+  const rate = label.startsWith("lazy") ? "-" : (size / 1048576 / secs).toFixed(0);
+  console.log(`${label.padEnd(22)} ${(size / 1048576).toFixed(0).padStart(6)} MiB  callback after ${(secs * 1000).toFixed(1).padStart(8)} ms` +
+              `  ${rate.padStart(6)} MiB/s  in heap ${(heap / 1048576).toFixed(0).padStart(6)} MiB  peak extra ${(extra / 1048576).toFixed(1).padStart(8)} MiB`);
+}
+
+console.log(`chunk ${chunk} bytes`);
+try {
+  await checkLazyReads();
+  await checkRelease();
+  for (const size of sizes) {
+    const path = join(tmpdir(), `pick_import_bench_${process.pid}.bin`);
+    const fd = openSync(path, "w");
+    ftruncateSync(fd, size);
+    closeSync(fd);
+    try {
+      const file = await openAsBlob(path);
+      const chosen = () => [{ file, rel: "asset.bin" }];
+
+      await run("chunked (pick.h)", size, (FS) => importWithGlue(FS, chosen(), { chunk }));
+      await run("lazy (pick.h)", size, (FS) => importWithGlue(FS, chosen(), { chunk, lazy: 1 }));
+      await run("spilled (pick.h)", size, (FS) => importWithGlue(FS, chosen(), { chunk, maxBytes: 1, spillDir }));
+
+      if (size <= LEGACY_LIMIT) {
+        await run("whole-file (previous)", size, (FS) => legacyImport(FS, chosen(), "/picked/1"));
+      } else {
+        console.log(`${"whole-file (previous)".padEnd(22)} ${(size / 1048576).toFixed(0).padStart(6)} MiB  skipped: needs about ${(2 * size / 1073741824).toFixed(0)} GiB`);
+      }
+    } finally {
+      unlinkSync(path);
+    }
+  }
+} finally {
+  rmSync(spillRoot, { recursive: true, force: true });
+}
@@ -0,0 +1,66 @@
+// Node benchmark for creating the folders of a deep picked tree in MEMFS.
+//
+//   node mkdir_bench.mjs [count] [--depth=n]
+//                        (default 20000 files, 12 folder levels)
+//
+// Every file sits `depth` folders down a tree that splits in two at each
+// level, so most folders hold a handful of files. The files are 16 bytes
+// each, leaving the folders as the work. "per file" is the previous import
+// loop's folder handling, an FS.analyzePath() and maybe an FS.mkdir() on each
+// parent of each file, followed by the file's write. "skeleton" is the real
+// pick__js_import_files_to_memfs from ../pick.h, which makes every folder once
+// before the first file. "lookups" counts the folder steps MEMFS takes to
+// resolve the paths given to analyzePath() and mkdir() (see makeMemFS). Both
+// must produce the same folders and files.
+import { makeMemFS, importWithGlue } from "./emjs.mjs";
+
+const args = process.argv.slice(2);
+const opt = (name, def) => { const a = args.find((x) => x.startsWith(`--${name}=`)); return a ? Number(a.split("=")[1]) : def; };
+const count = Number(args.find((a) => !a.startsWith("--")) || 20000);
+const depth = opt("depth", 12);
+
+const bytes = new Uint8Array(16);
+const file = { size: bytes.length, lastModified: 0, slice: () => ({ arrayBuffer: async () => bytes.slice().buffer }) };
+const chosen = [];
+for (let i = 0; i < count; i++) {
+  const parts = [];
+  for (let level = 0; level < depth; level++) parts.push(`l${level}_${(i >> (depth - 1 - level)) & 1 ? "b" : "a"}`);
+  chosen.push({ file, rel: `${parts.join("/")}/file_${i}.bin` });
+}
+
+function perFile(FS, base) {
+  FS.mkdir(base);
+  const out = [];
+  for (const { rel } of chosen) {
+    const parts = rel.split("/").filter(Boolean);
+    let dir = base;
+    for (let k = 0; k < parts.length - 1; k++) {
+      dir = dir + "/" + parts[k];
+      try { if (!FS.analyzePath(dir).exists) FS.mkdir(dir); } catch (e) {}
+    }
+    FS.writeFile(base + "/" + rel, bytes);
+    out.push(base + "/" + rel);
+  }
+  return out;
+}
+
+async function run(label, body) {
+  const FS = makeMemFS();
+  FS.mkdir("/picked");
+  FS.lookups = 0;
+  const t0 = process.hrtime.bigint();
+  const paths = await body(FS);
+  const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+  if (paths.length !== count) throw new Error(`${label}: ${paths.length} of ${count} files`);
+  console.log(`${label.padEnd(20)} ${ms.toFixed(1).padStart(9)} ms  ${String(FS.lookups).padStart(9)} lookups`);
+  return { FS, ms, lookups: FS.lookups };
+}
+
+const folders = new Set(chosen.map((c) => c.rel.slice(0, c.rel.lastIndexOf("/"))).flatMap((d) => d.split("/").map((_, i, a) => a.slice(0, i + 1).join("/"))));
+console.log(`${count} files ${depth} folders deep, ${folders.size} folders`);
+const before = await run("per file (previous)", (FS) => perFile(FS, "/picked/1"));
+const after = await run("skeleton (pick.h)", (FS) => importWithGlue(FS, chosen, {}));
+
+const tree = (FS, base) => [...FS.nodes.keys(), ...[...folders].map((d) => base + "/" + d).filter((d) => FS.analyzePath(d).exists)].sort().join("\n");
+if (tree(before.FS, "/picked/1") !== tree(after.FS, "/picked/1")) throw new Error("the two imports made different trees");
+console.log(`lookups        ${(before.lookups / after.lookups).toFixed(1)}x fewer, ${(before.ms / after.ms).toFixed(1)}x faster, same tree`);
@@ -0,0 +1,153 @@
+// Node benchmark for importing many small picked files into MEMFS.
+//
+//   node pool_bench.mjs [count] [--size=bytes] [--latency=ms]
+//                       (default 10000 files of 4096 bytes, 0 ms)
+//
+// Runs the real pick__js_import_files_to_memfs body from ../pick.h over files
+// on disk opened as Blobs (fs.openAsBlob, like browser Files), once reading
+// one file at a time and once with PICK_EM_IMPORT_CONCURRENCY reads in flight.
+// --latency adds a fixed delay to every read, standing in for a browser's
+// per-File read cost, which node's local disk reads mostly hide. Both runs
+// must deliver the same paths in selection order with the same contents.
+// "progress" counts the crossings into C at the default PICK_EM_PROGRESS_HZ,
+// and an import aborted from its progress callback must leave nothing behind.
+// The cached runs go through PICK_EM_IMPORT_CACHE_BYTES over an OPFS stand-in
+// on disk: the first pick writes every file through, and the repeat pick,
+// from a cache reopened as a new session would, reads none of the sources.
+// A cache capped at half the selection checks LRU eviction. The dedup runs
+// (PICK_EM_IMPORT_DEDUP) pick a folder where every source file appears ten
+// times; "in heap" counts each stored array once, writing to a linked copy
+// must leave the others untouched, and pick_release() must uncount them.
+// The storage run imports the selection three times under a
+// PICK_EM_STORAGE_MAX_BYTES cap of two selections: older requests must be
+// evicted oldest first, except a file held open and one opened since.
+import { openAsBlob, mkdtempSync, writeFileSync, rmSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { loadEmJs, makeMemFS, makeOpfsDir, openImportCache, openDedup, makeGlue, importWithGlue } from "./emjs.mjs";
+
+const args = process.argv.slice(2);
+const opt = (name, def) => { const a = args.find((x) => x.startsWith(`--${name}=`)); return a ? Number(a.split("=")[1]) : def; };
+const count = Number(args.find((a) => !a.startsWith("--")) || 10000);
+const size = opt("size", 4096);
+const latency = opt("latency", 0);
+const POOL = 8;
+
+function delayed(blob) {
+  if (!latency) return blob;
+  const wait = () => new Promise((r) => setTimeout(r, latency));
+  return {
+    size: blob.size,
+    slice: (a, b) => { const part = blob.slice(a, b); return { arrayBuffer: () => wait().then(() => part.arrayBuffer()) }; },
+  };
+}
+
+const dir = mkdtempSync(join(tmpdir(), "pick_pool_bench_"));
+try {
+  const chosen = [];
+  for (let i = 0; i < count; i++) {
+    // Sizes vary a little so a reordered write would land in the wrong file.
+    const bytes = new Uint8Array(size + (i % 13)).fill(i & 255);
+    const rel = `assets/${(i % 50).toString().padStart(2, "0")}/tile_${i}.bin`;
+    const path = join(dir, `f${i}`);
+    writeFileSync(path, bytes);
+    chosen.push({ file: delayed(await openAsBlob(path)), rel });
+  }
+
+  async function run(label, concurrency, cache = null) {
+    const FS = makeMemFS();
+    let calls = 0, last = null;
+    const progress = (...counts) => { calls++; last = counts; return true; };
+    const t0 = process.hrtime.bigint();
+    const paths = await importWithGlue(FS, chosen, { concurrency, progress, cache });
+    const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+    if (paths.length !== count) throw new Error(`${label}: delivered ${paths.length} of ${count}`);
+    for (let i = 0; i < count; i++) {
+      const node = FS.nodes.get(paths[i]);
+      if (paths[i] !== `/picked/1/${chosen[i].rel}` || !node || node.usedBytes !== size + (i % 13) || node.contents[0] !== (i & 255)) {
+        throw new Error(`${label}: path ${i} out of order or mismatched`);
+      }
+    }
+    if (last[0] !== count || last[2] !== last[3]) throw new Error(`${label}: last progress ${last}`);
+    console.log(`${label.padEnd(14)} ${ms.toFixed(1).padStart(9)} ms  ${(count / ms * 1000).toFixed(0).padStart(7)} files/s  progress ${calls} calls`);
+    return ms;
+  }
+
+  console.log(`${count} files of ~${size} bytes, ${latency} ms per read`);
+  const serial = await run("1 at a time", 1);
+  const pooled = await run(`${POOL} in flight`, POOL);
+  console.log(`speedup        ${(serial / pooled).toFixed(2)}x, same order`);
+
+  const FS = makeMemFS();
+  const aborted = await importWithGlue(FS, chosen, { progressHz: 1000, progress: (done) => done < count / 2 });
+  await new Promise((r) => setTimeout(r, 50 + latency * 8));
+  if (aborted !== null || FS.nodes.size) throw new Error(`abort left ${FS.nodes.size} files`);
+  console.log("abort from progress leaves no files");
+
+  const opfs = makeOpfsDir(join(dir, "opfs"));
+  const total = chosen.reduce((n, c) => n + c.file.size, 0);
+  let cache = await openImportCache(opfs, total * 2);
+  await run("first, cached", POOL, cache);
+  await cache.save();
+  cache = await openImportCache(opfs, total * 2);
+  const repeat = await run("repeat, cached", POOL, cache);
+  if (cache.hits !== count || cache.misses !== 0) throw new Error(`repeat pick: ${cache.hits} hits, ${cache.misses} misses`);
+  console.log(`repeat pick    ${(pooled / repeat).toFixed(2)}x faster than uncached, ${cache.hits} hits, ${(cache.hitBytes / 1048576).toFixed(1)} MiB not read again`);
+
+  const small = await openImportCache(makeOpfsDir(join(dir, "opfs-small")), total / 2);
+  await run("half cap, 1st", POOL, small);
+  await run("half cap, 2nd", POOL, small);
+  await small.save();
+  if (small.bytes > total / 2 || !small.evictions) throw new Error(`LRU: ${small.bytes} of ${total / 2} bytes, ${small.evictions} evictions`);
+  console.log(`LRU at half the selection: ${small.entries} entries kept, ${small.evictions} evicted, ${small.hits} hits read back intact`);
+
+  const copies = chosen.map((c, i) => ({ file: chosen[Math.floor(i / 10)].file, rel: `copies/${i % 10}/${c.rel}` }));
+  async function dedupRun(label, dedup) {
+    const FS = makeMemFS();
+    const t0 = process.hrtime.bigint();
+    const paths = await importWithGlue(FS, copies, { concurrency: POOL, dedup });
+    const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+    const arrays = new Set();
+    for (let i = 0; i < count; i++) {
+      const node = FS.nodes.get(paths[i]), src = Math.floor(i / 10);
+      if (node.usedBytes !== size + (src % 13) || node.contents[node.usedBytes - 1] !== (src & 255)) throw new Error(`${label}: path ${i} mismatched`);
+      arrays.add(node.contents);
+    }
+    const heap = [...arrays].reduce((n, a) => n + a.length, 0);
+    console.log(`${label.padEnd(14)} ${ms.toFixed(1).padStart(9)} ms  in heap ${(heap / 1048576).toFixed(1).padStart(6)} MiB`);
+    return { FS, paths, ms, heap };
+  }
+  const plain = await dedupRun("copies, plain", null);
+  const dedup = openDedup();
+  const shared = await dedupRun("copies, dedup", dedup);
+  if (dedup.linked !== count - count / 10 || shared.heap * 9 > plain.heap) throw new Error(`dedup: ${dedup.linked} linked, ${shared.heap} of ${plain.heap} bytes`);
+  console.log(`dedup          ${dedup.linked} linked, ${(dedup.saved / 1048576).toFixed(1)} MiB saved, ${(dedup.hashed / 1048576).toFixed(1)} MiB hashed, ` +
+              `${((shared.ms / plain.ms - 1) * 100).toFixed(0)}% time`);
+  const [a, b] = [shared.FS.nodes.get(shared.paths[0]), shared.FS.nodes.get(shared.paths[1])];
+  shared.FS.write({ node: a, position: 0 }, new Uint8Array([7]), 0, 1, 0);
+  if (a.contents[0] !== 7 || b.contents[0] !== 0 || dedup.linked !== count - count / 10 - 1) throw new Error("write to a linked copy leaked");
+  console.log("a write to a linked copy leaves the others intact");
+  const release = loadEmJs("pick__js_release", { FS: shared.FS, Module: { __pickDedup: dedup } });
+  for (const p of shared.paths) release(p);
+  if (shared.FS.nodes.size || dedup.linked || dedup.saved) throw new Error(`released copies still counted: ${dedup.linked} linked`);
+  console.log("released copies are no longer counted as linked");
+
+  const capped = makeMemFS();
+  const glue = makeGlue(capped, { concurrency: POOL, storage: { maxBytes: total * 2 } });
+  const store = glue.Module.__pickStore;
+  const picks = [await glue.import(chosen)];
+  const held = capped.nodes.get(picks[0][0]), reopened = capped.nodes.get(picks[0][1]);
+  held.stream_ops.open({ node: held });
+  picks.push(await glue.import(chosen));
+  reopened.stream_ops.open({ node: reopened });
+  reopened.stream_ops.close({ node: reopened });
+  picks.push(await glue.import(chosen));
+  const kept = picks.map((paths) => paths.filter((p) => capped.nodes.has(p)).length);
+  if (store.bytes > total * 2 || kept[0] !== 2 || !capped.nodes.has(picks[0][1]) || kept[1] === count || kept[2] !== count) {
+    throw new Error(`storage cap: ${store.bytes} of ${total * 2} bytes, files kept per import ${kept}`);
+  }
+  console.log(`storage cap of 2 selections: ${store.files} files kept (per import ${kept.join(", ")}), ${store.evictions} evicted, ` +
+              `${(store.bytes / 1048576).toFixed(1)} MiB held`);
+} finally {
+  rmSync(dir, { recursive: true, force: true });
+}
@@ -0,0 +1,139 @@
+// Tests for the xdg-desktop-portal backend against fake_portal.c on a private
+// session bus:
+//
+//   make portal-test
+//
+// Built with AddressSanitizer, so a request freed while its method call is
+// still pending fails the run instead of passing by luck.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define PICK_IMPLEMENTATION
+#include "../pick.h"
+#include "test_util.h"
+
+static DBusConnection* test_bus;
+
+static dbus_uint32_t test_fake_call(const char* method) {
+  DBusMessage* msg = dbus_message_new_method_call("org.pick.FakePortal", "/", "org.pick.FakePortal", method);
+  DBusMessage* reply = dbus_connection_send_with_reply_and_block(test_bus, msg, 2000, NULL);
+  dbus_uint32_t value = 0;
+  if (reply) {
+    dbus_message_get_args(reply, NULL, DBUS_TYPE_UINT32, &value, DBUS_TYPE_INVALID);
+    dbus_message_unref(reply);
+  }
+  dbus_message_unref(msg);
+  return value;
+}
+
+static void test_single_and_multi(void) {
+  test_result_t one = {0}, many = {0};
+  PickFileOptions opts = { .title = "respond:1" };
+  TEST_CHECK(pick_file(&opts, test_on_single, &one) != PICK_REQUEST_NONE, "pick_file returned no request");
+  opts.title = "respond:3";
+  TEST_CHECK(pick_files(&opts, test_on_multi, &many) != PICK_REQUEST_NONE, "pick_files returned no request");
+  test_run(&many.done, 2000);
+  test_run(&one.done, 2000);
+  TEST_CHECK(one.done && one.count == 1 && strcmp(one.first, "/tmp/picked 1.txt") == 0,
+             "single selection: done %d count %d path '%s'", one.done, one.count, one.first);
+  TEST_CHECK(many.done && many.count == 3 && strcmp(many.first, "/tmp/picked 1.txt") == 0,
+             "multi selection: done %d count %d first '%s'", many.done, many.count, many.first);
+}
+
+// With handle_token the Response can arrive before the method reply; the
+// request must stay alive until the reply too.
+static void test_response_before_reply(void) {
+  test_result_t r = {0};
+  PickFileOptions opts = { .title = "respond-first" };
+  PickRequest id = pick_file(&opts, test_on_single, &r);
+  test_run(&r.done, 2000);
+  TEST_CHECK(r.done && r.count == 1, "response before reply: done %d count %d", r.done, r.count);
+  TEST_CHECK(!pick_cancel(id), "a delivered request can still be cancelled");
+  r.done = false;
+  test_run(NULL, 150);
+  TEST_CHECK(!r.done, "callback ran twice");
+}
+
+typedef struct {
+  PickRequest id;
+  int         calls;
+} test_reentrant_t;
+
+static void test_on_single_cancel(const char* path, void* user) {
+  (void)path;
+  test_reentrant_t* r = (test_reentrant_t*)user;
+  r->calls++;
+  pick_cancel(r->id);
+}
+
+// A callback that cancels its own handle must neither run twice nor free the
+// entry under the filter, whether or not the method reply came first.
+static void test_cancel_from_callback(void) {
+  static const char* const titles[] = { "respond:1", "respond-first" };
+  for (int i = 0; i < 2; i++) {
+    test_reentrant_t r = {0};
+    PickFileOptions opts = { .title = titles[i] };
+    r.id = pick_file(&opts, test_on_single_cancel, &r);
+    double end = pick__now_ms() + 2000;
+    while (!r.calls && pick__now_ms() < end) test_run(NULL, 10);
+    test_run(NULL, 150);
+    TEST_CHECK(r.calls == 1, "%s: callback ran %d time(s)", titles[i], r.calls);
+  }
+}
+
+static void test_cancel_in_flight(void) {
+  test_result_t r = {0};
+  dbus_uint32_t closes = test_fake_call("Closes");
+  PickFileOptions opts = { .title = "hold" };
+  PickRequest id = pick_file(&opts, test_on_single, &r);
+  TEST_CHECK(pick_cancel(id), "pick_cancel found no request");
+  TEST_CHECK(r.done && r.count == 0, "cancel did not deliver a cancelled result at once");
+  r.done = false;
+  test_run(NULL, 400);
+  TEST_CHECK(!r.done, "callback ran again once the reply arrived");
+  TEST_CHECK(test_fake_call("Closes") == closes + 1, "the dialog revealed by the late reply was not closed");
+}
+
+static void test_timeout(void) {
+  test_result_t r = {0};
+  dbus_uint32_t closes = test_fake_call("Closes");
+  PickFileOptions opts = { .title = "silent", .timeout_ms = 100 };
+  double start = pick__now_ms();
+  pick_file(&opts, test_on_single, &r);
+  TEST_CHECK(test_wait(&r.done), "the deadline never woke pick_poll_fd()");
+  double took = pick__now_ms() - start;
+  TEST_CHECK(r.done && r.count == 0, "timeout: done %d count %d", r.done, r.count);
+  TEST_CHECK(took >= 100 && took < 1000, "timeout fired after %.0f ms", took);
+  test_run(NULL, 50);
+  TEST_CHECK(test_fake_call("Closes") == closes + 1, "the timed out dialog was not closed");
+}
+
+static void test_message(void) {
+  test_result_t r = {0};
+  PickMessageOptions opts = { .title = "yes", .message = "Continue?", .buttons = PICK_BUTTON_YES_NO };
+  pick_message(&opts, test_on_button, &r);
+  test_run(&r.done, 2000);
+  TEST_CHECK(r.done && r.button == PICK_RESULT_YES, "message: done %d button %d", r.done, (int)r.button);
+}
+
+int main(void) {
+  test_bus = dbus_bus_get_private(DBUS_BUS_SESSION, NULL);
+  if (!test_bus) { fprintf(stderr, "portal_test: no session bus\n"); return 1; }
+  for (int i = 0; i < 200 && !dbus_bus_name_has_owner(test_bus, "org.pick.FakePortal", NULL); i++) test_run(NULL, 10);
+
+  test_single_and_multi();
+  test_response_before_reply();
+  test_cancel_from_callback();
+  test_cancel_in_flight();
+  test_timeout();
+  test_message();
+
+  test_fake_call("Quit");
+  dbus_connection_close(test_bus);
+  dbus_connection_unref(test_bus);
+  if (test_failures) { fprintf(stderr, "portal_test: %d failure(s)\n", test_failures); return 1; }
+  printf("portal_test: all passed\n");
+  return 0;
+}
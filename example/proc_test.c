@@ -0,0 +1,114 @@
+// Tests for the zenity/kdialog subprocess backend against the stub helpers in
+// stubs/, which `make proc-test` puts first on PATH:
+//
+//   make proc-test
+//
+// Every wait blocks on pick_poll_fd() alone (test_util.h), so a request whose
+// completion does not make the descriptor readable fails the run.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#ifndef PICK_LINUX_SUBPROCESS
+#define PICK_LINUX_SUBPROCESS
+#endif
+#define PICK_IMPLEMENTATION
+#include "../pick.h"
+#include "test_util.h"
+
+static bool test_idle(const void* unused) {
+  (void)unused;
+  return pick__g_proc_reqs == NULL;
+}
+
+// test_wait() that also cancels whatever is left when it gives up, so no
+// callback outlives the test's stack frame; `done` NULL waits until every
+// helper is reaped.
+static bool test_settle(const bool* done) {
+  if (done ? test_wait(done) : test_wait_until(test_idle, NULL)) return true;
+  PickRequest ids[16];
+  int n = 0;
+  for (pick__proc_req_t* r = pick__g_proc_reqs; r && n < 16; r = r->next) ids[n++] = r->id;
+  for (int i = 0; i < n; i++) pick_cancel(ids[i]);
+  return false;
+}
+
+static void test_single_and_multi(void) {
+  test_result_t one = {0}, many = {0};
+  PickFileOptions opts = { .title = "pick:1" };
+  pick_file(&opts, test_on_single, &one);
+  opts.title = "pick:3";
+  pick_files(&opts, test_on_multi, &many);
+  TEST_CHECK(test_settle(&one.done) && test_settle(&many.done), "pick_poll_fd() never became readable");
+  TEST_CHECK(one.count == 1 && strcmp(one.first, "/tmp/picked 1.txt") == 0,
+             "single selection: count %d path '%s'", one.count, one.first);
+  TEST_CHECK(many.count == 3 && strcmp(many.first, "/tmp/picked 1.txt") == 0 && strcmp(many.last, "/tmp/picked 3.txt") == 0,
+             "multi selection: count %d first '%s' last '%s'", many.count, many.first, many.last);
+}
+
+static void test_cancel_exit(void) {
+  test_result_t r = { .count = -1 };
+  PickFileOptions opts = { .title = "cancel" };
+  pick_file(&opts, test_on_single, &r);
+  TEST_CHECK(test_settle(&r.done), "pick_poll_fd() never became readable");
+  TEST_CHECK(r.count == 0, "exit 1 delivered %d path(s)", r.count);
+}
+
+static void test_kill_on_cancel(void) {
+  test_result_t r = { .count = -1 };
+  PickFileOptions opts = { .title = "hang" };
+  PickRequest id = pick_file(&opts, test_on_single, &r);
+  pid_t pid = pick__g_proc_reqs ? pick__g_proc_reqs->pid : 0;
+  double start = pick__now_ms();
+  TEST_CHECK(pick_cancel(id), "pick_cancel found no request");
+  TEST_CHECK(r.done && r.count == 0, "cancel did not deliver a cancelled result at once");
+  TEST_CHECK(!pick_cancel(id), "a cancelled request can be cancelled again");
+  TEST_CHECK(test_settle(NULL), "the killed helper was never reaped");
+  TEST_CHECK(pick__now_ms() - start < 2000, "the helper was not killed");
+  TEST_CHECK(pid > 0 && kill(pid, 0) != 0 && errno == ESRCH, "helper %d is still around", (int)pid);
+}
+
+// The helper closes stdout a second before it exits: only its pidfd can say when.
+static void test_exit_after_eof(void) {
+  test_result_t r = {0};
+  PickFileOptions opts = { .title = "late-exit" };
+  pick_file(&opts, test_on_single, &r);
+  TEST_CHECK(test_settle(&r.done), "exit after EOF never woke pick_poll_fd()");
+  TEST_CHECK(r.count == 1 && strcmp(r.first, "/tmp/picked 1.txt") == 0, "late exit: count %d path '%s'", r.count, r.first);
+}
+
+static void test_timeout(void) {
+  test_result_t r = { .count = -1 };
+  PickFileOptions opts = { .title = "hang", .timeout_ms = 100 };
+  double start = pick__now_ms();
+  pick_file(&opts, test_on_single, &r);
+  TEST_CHECK(test_settle(&r.done), "the deadline never woke pick_poll_fd()");
+  double took = pick__now_ms() - start;
+  TEST_CHECK(r.count == 0, "timeout delivered %d path(s)", r.count);
+  TEST_CHECK(took >= 100 && took < 1000, "timeout fired after %.0f ms", took);
+  TEST_CHECK(test_settle(NULL), "the timed out helper was never reaped");
+}
+
+static void test_message(void) {
+  test_result_t r = {0};
+  PickMessageOptions opts = { .title = "yes", .message = "Continue?", .buttons = PICK_BUTTON_YES_NO };
+  pick_message(&opts, test_on_button, &r);
+  TEST_CHECK(test_settle(&r.done), "pick_poll_fd() never became readable");
+  TEST_CHECK(r.button == PICK_RESULT_YES, "message: button %d", (int)r.button);
+}
+
+int main(void) {
+  test_single_and_multi();
+  test_cancel_exit();
+  test_kill_on_cancel();
+  test_exit_after_eof();
+  test_timeout();
+  test_message();
+
+  const char* tool = pick__g_tool ? pick__g_tool : "no helper";
+  if (test_failures) { fprintf(stderr, "proc_test (%s): %d failure(s)\n", tool, test_failures); return 1; }
+  printf("proc_test (%s): all passed\n", tool);
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Node benchmark for pick_folder_resync() against a full re-import.
+//
+//   node resync_bench.mjs [count] [--changes=n] [--size=bytes] [--latency=ms]
+//                         (default 10000 files of 4096 bytes, 10 changes, 0 ms)
+//
+// Picks a folder on disk through the real walk and import glue from ../pick.h
+// (makeOpfsDir stands in for the FileSystemDirectoryHandle), then modifies,
+// adds and removes `changes` files each and resyncs. The resync still walks
+// the tree to compare sizes and modification times, but reads only the files
+// that changed; --latency adds a delay to every read, as in pool_bench.mjs.
+// The change list must name exactly the touched files, their MEMFS copies
+// must match the disk, and a resync with nothing changed must report nothing.
+import { mkdtempSync, mkdirSync, writeFileSync, rmSync, utimesSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { makeMemFS, makeOpfsDir, makeGlue } from "./emjs.mjs";
+
+const args = process.argv.slice(2);
+const opt = (name, def) => { const a = args.find((x) => x.startsWith(`--${name}=`)); return a ? Number(a.split("=")[1]) : def; };
+const count = Number(args.find((a) => !a.startsWith("--")) || 10000);
+const changes = opt("changes", 10);
+const size = opt("size", 4096);
+const latency = opt("latency", 0);
+
+// Delays every read of the folder's files, leaving the walk itself alone.
+function delayedDir(handle) {
+  if (!latency) return handle;
+  const wait = () => new Promise((r) => setTimeout(r, latency));
+  const slow = (file) => ({ size: file.size, lastModified: file.lastModified,
+                            slice: (a, b) => { const part = file.slice(a, b); return { arrayBuffer: () => wait().then(() => part.arrayBuffer()) }; } });
+  return {
+    ...handle,
+    async *entries() {
+      for await (const [name, h] of handle.entries()) {
+        yield [name, h.kind === "directory" ? delayedDir(h) : { ...h, getFile: async () => slow(await h.getFile()) }];
+      }
+    },
+  };
+}
+
+const root = mkdtempSync(join(tmpdir(), "pick_resync_bench_"));
+try {
+  const rel = (i) => `assets/${(i % 50).toString().padStart(2, "0")}/tile_${i}.bin`;
+  const write = (i, fill) => {
+    mkdirSync(join(root, "assets", (i % 50).toString().padStart(2, "0")), { recursive: true });
+    writeFileSync(join(root, rel(i)), new Uint8Array(size).fill(fill));
+  };
+  for (let i = 0; i < count; i++) write(i, i & 255);
+  const dir = delayedDir(makeOpfsDir(root));
+
+  const FS = makeMemFS();
+  const glue = makeGlue(FS);
+  let t0 = process.hrtime.bigint();
+  const { id, paths } = await glue.pickFolder(dir);
+  const full = Number(process.hrtime.bigint() - t0) / 1e6;
+  if (paths.length !== count) throw new Error(`picked ${paths.length} of ${count}`);
+
+  const expect = [];
+  const later = new Date(Date.now() + 60000);
+  for (let k = 0; k < changes; k++) {
+    const i = k * 3;
+    write(i, 0xee);
+    utimesSync(join(root, rel(i)), later, later);
+    expect.push(`~/picked/${id}/${rel(i)}`);
+    rmSync(join(root, rel(i + 1)));
+    expect.push(`-/picked/${id}/${rel(i + 1)}`);
+    write(count + k, 0xad);
+    expect.push(`+/picked/${id}/${rel(count + k)}`);
+  }
+
+  t0 = process.hrtime.bigint();
+  const list = await glue.resync(id);
+  const resync = Number(process.hrtime.bigint() - t0) / 1e6;
+  if (JSON.stringify([...list].sort()) !== JSON.stringify(expect.sort())) throw new Error(`change list ${JSON.stringify(list)}`);
+  for (const entry of list) {
+    const node = FS.nodes.get(entry.slice(1));
+    const want = entry[0] === "~" ? 0xee : 0xad;
+    if (entry[0] === "-" ? node : !node || node.usedBytes !== size || node.contents[size - 1] !== want) throw new Error(`${entry} mismatched`);
+  }
+  const again = await glue.resync(id);
+  if (again.length) throw new Error(`unchanged folder reported ${again.length} changes`);
+
+  console.log(`${count} files of ${size} bytes, ${latency} ms per read, ${changes} each modified, added and removed`);
+  console.log(`full import   ${full.toFixed(1).padStart(9)} ms`);
+  console.log(`resync        ${resync.toFixed(1).padStart(9)} ms  ${list.length} changes, ${(full / resync).toFixed(1)}x faster; a second resync reports none`);
+} finally {
+  rmSync(root, { recursive: true, force: true });
+}
@@ -0,0 +1,83 @@
+// Cold-start cost of compiling pick.h into a Linux binary.
+//
+// Each variant below is the same tiny program built with different flags; the
+// runner execs every binary it is given many times and reports wall time for
+// a process that starts, touches nothing, and exits.
+//
+//   STARTUP_WITH_PICK  compile the pick.h implementation in (backend chosen
+//                      by PICK_LINUX_GTK etc.) and reference its entry points
+//
+// Build and run all variants with `make startup-bench`.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#ifdef STARTUP_WITH_PICK
+#define PICK_IMPLEMENTATION
+#include "../pick.h"
+
+// Keep the backend linked in without running any of it.
+PickRequest (*volatile startup_keep_file)(const PickFileOptions*, PickFileCallback, void*) = pick_file;
+PickRequest (*volatile startup_keep_message)(const PickMessageOptions*, PickMessageCallback, void*) = pick_message;
+#endif
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static bool run_once(const char* exe, double* out_us) {
+  double t0 = now_us();
+  pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    execl(exe, exe, "--probe", (char*)NULL);
+    _exit(127);
+  }
+  int status = 0;
+  if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return false;
+  *out_us = now_us() - t0;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "--probe") == 0) return 0;
+
+  int runs = 200;
+  int first = 1;
+  if (argc > 2 && strcmp(argv[1], "-n") == 0) { runs = atoi(argv[2]); first = 3; }
+  if (first >= argc || runs <= 0) {
+    fprintf(stderr, "usage: %s [-n runs] binary...\n", argv[0]);
+    return 1;
+  }
+
+  double* samples = (double*)malloc(sizeof(double) * (size_t)runs);
+  if (!samples) return 1;
+
+  printf("%-28s %10s %10s %10s\n", "binary", "median_us", "p90_us", "mean_us");
+  for (int b = first; b < argc; b++) {
+    double warm;
+    if (!run_once(argv[b], &warm)) { printf("%-28s %10s\n", argv[b], "failed"); continue; }
+
+    double sum = 0;
+    for (int i = 0; i < runs; i++) {
+      if (!run_once(argv[b], &samples[i])) samples[i] = 0;
+      sum += samples[i];
+    }
+    qsort(samples, (size_t)runs, sizeof(double), cmp_double);
+    printf("%-28s %10.1f %10.1f %10.1f\n", argv[b], samples[runs / 2], samples[(runs * 9) / 10], sum / runs);
+  }
+
+  free(samples);
+  return 0;
+}
@@ -0,0 +1,82 @@
+// Scaffolding shared by portal_test.c and proc_test.c. Include it after pick.h
+// (with PICK_IMPLEMENTATION), which provides pick_poll_fd() and pick__now_ms().
+#ifndef PICK_TEST_UTIL_H
+#define PICK_TEST_UTIL_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <poll.h>
+
+// How long pick_poll_fd() may stay quiet before test_wait() gives up.
+#ifndef TEST_QUIET_MS
+#define TEST_QUIET_MS 3000
+#endif
+
+typedef struct {
+  bool             done;
+  int              count;
+  char             first[256];
+  char             last[256];
+  PickButtonResult button;
+} test_result_t;
+
+static int test_failures;
+
+#define TEST_CHECK(cond, ...) do { \
+  if (!(cond)) { test_failures++; fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } \
+} while (0)
+
+static inline void test_on_single(const char* path, void* user) {
+  test_result_t* r = (test_result_t*)user;
+  r->done = true;
+  r->count = path ? 1 : 0;
+  snprintf(r->first, sizeof(r->first), "%s", path ? path : "");
+}
+
+static inline void test_on_multi(const char** paths, int count, void* user) {
+  test_result_t* r = (test_result_t*)user;
+  r->done = true;
+  r->count = count;
+  snprintf(r->first, sizeof(r->first), "%s", count > 0 ? paths[0] : "");
+  snprintf(r->last, sizeof(r->last), "%s", count > 0 ? paths[count - 1] : "");
+}
+
+static inline void test_on_button(PickButtonResult result, void* user) {
+  test_result_t* r = (test_result_t*)user;
+  r->done = true;
+  r->button = result;
+}
+
+// Runs the backend from pick_poll_fd() until `done` is set or `ms` pass.
+static inline void test_run(const bool* done, int ms) {
+  double end = pick__now_ms() + ms;
+  while ((!done || !*done) && pick__now_ms() < end) {
+    struct pollfd pfd = { .fd = pick_poll_fd(), .events = POLLIN };
+    poll(&pfd, 1, 10);
+    pick_poll();
+  }
+}
+
+// Blocks on pick_poll_fd() alone, never on a timer, until `until(ctx)` holds,
+// so a completion that does not make the descriptor readable fails the test.
+// Returns false if the descriptor stayed quiet for TEST_QUIET_MS.
+static inline bool test_wait_until(bool (*until)(const void* ctx), const void* ctx) {
+  while (!until(ctx)) {
+    struct pollfd pfd = { .fd = pick_poll_fd(), .events = POLLIN };
+    if (poll(&pfd, 1, TEST_QUIET_MS) == 0) return false;
+    pick_poll();
+  }
+  return true;
+}
+
+static inline bool test_flag_set(const void* flag) {
+  return *(const bool*)flag;
+}
+
+// test_wait_until() for a callback's `done` flag.
+static inline bool test_wait(const bool* done) {
+  return test_wait_until(test_flag_set, done);
+}
+
+#endif
@@ -0,0 +1,125 @@
+// Node benchmark for walking a picked folder's FileSystemDirectoryHandle.
+//
+//   node walk_bench.mjs [entries] [--latency=ms] [--fanout=n]
+//                       (default 50000 entries, 0.2 ms, 10 subfolders per folder)
+//
+// The tree is an in-memory mock of FileSystemDirectoryHandle: every entries()
+// listing and every getFile() waits `latency` before answering, standing in
+// for the round trip to the browser's file system backend. "sequential" is
+// the previous walk in pick__js_open, an async generator awaiting each
+// getFile() and recursing into one subfolder at a time. "pooled" is the real
+// pick__js_walk_dir from ../pick.h at PICK_EM_WALK_CONCURRENCY; it must list
+// the same files, and "first rows" is when its on_found could first have
+// drawn something in the dialog. "filtered" walks again with PickFilter
+// extensions and exclude globs: skipped folders must never be listed and
+// skipped files never looked up.
+import { loadEmJs } from "./emjs.mjs";
+
+const args = process.argv.slice(2);
+const opt = (name, def) => { const a = args.find((x) => x.startsWith(`--${name}=`)); return a ? Number(a.split("=")[1]) : def; };
+const entries = Number(args.find((a) => !a.startsWith("--")) || 50000);
+const latency = opt("latency", 0.2);
+const fanout = opt("fanout", 10);
+const POOL = 16;
+
+// Sub-millisecond waits: setTimeout cannot go below 1 ms, so due waits are
+// released by a loop that polls the clock between turns of the event loop.
+const waits = [];
+let polling = false;
+function sleep(ms) {
+  if (!ms) return Promise.resolve();
+  return new Promise((resolve) => {
+    waits.push({ at: performance.now() + ms, resolve });
+    if (!polling) { polling = true; setImmediate(poll); }
+  });
+}
+function poll() {
+  const now = performance.now();
+  for (let i = waits.length - 1; i >= 0; i--) if (waits[i].at <= now) { waits[i].resolve(); waits.splice(i, 1); }
+  if (waits.length) setImmediate(poll); else polling = false;
+}
+
+// A folder of `files` files and the given subfolders, as a directory handle.
+function mockDir(name, files, subdirs) {
+  const children = [];
+  for (let i = 0; i < files; i++) {
+    const fname = `${name}_${i}`;
+    const ext = i % 4 ? ".png" : ".tmp";
+    children.push([fname + ext, { kind: "file", getFile: async () => { lookups++; await sleep(latency); return { name: fname + ext, size: 4096, lastModified: 0 }; } }]);
+  }
+  for (const d of subdirs) children.push([d.name.slice(d.name.lastIndexOf("_") + 1), d]);
+  return {
+    kind: "directory",
+    name,
+    async *entries() {
+      listings++;
+      await sleep(latency);
+      yield* children;
+    },
+  };
+}
+
+// Three levels of `fanout` subfolders, the files spread evenly over all folders.
+const dirCount = 1 + fanout + fanout ** 2 + fanout ** 3;
+const perDir = Math.max(1, Math.round((entries - dirCount) / dirCount));
+function build(level, name) {
+  const subs = level < 3 ? Array.from({ length: fanout }, (_, i) => build(level + 1, `${name}_d${i}`)) : [];
+  return mockDir(name, perDir, subs);
+}
+const root = build(0, "root");
+const total = dirCount - 1 + dirCount * perDir;
+
+async function sequentialWalk(dir) {
+  async function* walk(rootHandle, prefix) {
+    for await (const [name, handle] of rootHandle.entries()) {
+      const rel = prefix ? (prefix + "/" + name) : name;
+      if (handle.kind === "file") {
+        const file = await handle.getFile();
+        file._rel = rel;
+        yield file;
+      } else if (handle.kind === "directory") {
+        yield* walk(handle, rel);
+      }
+    }
+  }
+  const out = [];
+  for await (const f of walk(dir, "")) out.push({ file: f, rel: f._rel });
+  return out;
+}
+
+let listings = 0, lookups = 0;
+const walkDir = loadEmJs("pick__js_walk_dir", {
+  Module: { __pickImport: { walkConcurrency: POOL } },
+  pick__call_req_alive: () => 1,
+});
+
+async function time(fn) {
+  const t0 = performance.now();
+  const out = await fn();
+  return { ms: performance.now() - t0, out };
+}
+
+console.log(`${total} entries (${dirCount} folders, ${perDir} files each), ${latency} ms per listing and getFile()`);
+const seq = await time(() => sequentialWalk(root));
+console.log(`sequential     ${seq.ms.toFixed(0).padStart(8)} ms  ${seq.out.length} files`);
+let first = null;
+const t0 = performance.now();
+const pooled = await time(() => walkDir(root, 1, () => { if (first === null) first = performance.now() - t0; }));
+console.log(`pooled (${POOL})    ${pooled.ms.toFixed(0).padStart(8)} ms  ${pooled.out.length} files, first rows after ${first.toFixed(1)} ms`);
+
+const names = (list) => list.map((x) => x.rel).sort().join("\n");
+if (pooled.out.length !== seq.out.length || names(pooled.out) !== names(seq.out)) throw new Error("pooled walk listed different files");
+const bfs = pooled.out.map((x) => x.rel.split("/").length);
+if (bfs.some((depth, i) => i && depth < bfs[i - 1])) throw new Error("pooled walk is not breadth first");
+console.log(`speedup        ${(seq.ms / pooled.ms).toFixed(1)}x, same files, breadth first`);
+
+// Skip every d0 and d9 folder (a name without "/" matches at any depth), the
+// top-level d1, and the .tmp files.
+const filter = loadEmJs("pick__js_path_filter")(".png", ["d0", "d1/**", "**/d9/", "*.tmp"].join("\n"));
+listings = lookups = 0;
+const filtered = await time(() => walkDir(root, 1, 0, filter));
+const kept = pooled.out.filter((x) => filter.path(x.rel));
+if (names(filtered.out) !== names(kept)) throw new Error("filtered walk listed different files");
+if (filtered.out.some((x) => /^d[01]\/|(^|\/)d9\/|\.tmp$/.test(x.rel))) throw new Error("filtered walk kept an excluded file");
+if (lookups !== kept.length) throw new Error(`filtered walk looked up ${lookups} files for ${kept.length}`);
+console.log(`filtered       ${filtered.ms.toFixed(0).padStart(8)} ms  ${filtered.out.length} files, ${listings} of ${dirCount} folders listed, ${lookups} getFile() calls`);
@@ -0,0 +1,80 @@
+// Node benchmark for main-thread stalls while importing large picked files.
+//
+//   node worker_bench.mjs [size_mb] [--chunk=bytes]
+//                         (default 1024 MiB, chunk 4 MiB)
+//
+// Imports two files of `size_mb` each, with different bytes but the same size
+// so PICK_EM_IMPORT_DEDUP hashes both, through the real
+// pick__js_import_files_to_memfs from ../pick.h. "main thread" does every
+// read and hash on the main thread; "import worker" runs
+// PICK_EM_IMPORT_WORKER's worker on a worker thread (see workerScope in
+// emjs.mjs), leaving the main thread the copies into MEMFS. A timer re-armed
+// every turn of the event loop stands in for the render loop: "longest" is
+// the longest the main thread went without running it, and "over a frame"
+// counts the gaps past 16.7 ms; "busy" is the main thread's event loop
+// utilization over the import, the timer included. Node reads Blobs off the
+// main thread already, where a browser tab spends main-thread time on them,
+// so the stand-in shows the hashing moved off and not the reads. Both runs
+// must import the same bytes.
+import { openSync, writeSync, closeSync, unlinkSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { makeMemFS, diskFile, openDedup, makeGlue } from "./emjs.mjs";
+
+const args = process.argv.slice(2);
+const chunkArg = args.find((a) => a.startsWith("--chunk="));
+const chunk = chunkArg ? Number(chunkArg.slice(8)) : 4 * 1024 * 1024;
+const size = Number(args.find((a) => !a.startsWith("--")) || 1024) * 1024 * 1024;
+const FRAME = 1000 / 60;
+
+// Watches the main thread until stopped; returns the gaps between turns.
+function watch() {
+  const gaps = [];
+  let last = performance.now(), on = true;
+  (function tick() {
+    const now = performance.now();
+    gaps.push(now - last);
+    last = now;
+    if (on) setTimeout(tick, 0);
+  })();
+  return () => { on = false; return gaps; };
+}
+
+const paths = [0, 1].map((k) => {
+  const path = join(tmpdir(), `pick_worker_bench_${process.pid}_${k}.bin`);
+  const fd = openSync(path, "w");
+  const block = new Uint8Array(1024 * 1024).fill(k + 1);
+  for (let pos = 0; pos < size; pos += block.length) writeSync(fd, block, 0, Math.min(block.length, size - pos));
+  closeSync(fd);
+  return path;
+});
+
+try {
+  const chosen = paths.map((path, k) => ({ file: diskFile(path), rel: `big_${k}.bin` }));
+  async function run(label, worker) {
+    const FS = makeMemFS(), dedup = openDedup();
+    const glue = makeGlue(FS, { chunk, dedup, worker });
+    const stop = watch(), elu = performance.eventLoopUtilization();
+    const t0 = performance.now();
+    const out = await glue.import(chosen);
+    const ms = performance.now() - t0;
+    const busy = performance.eventLoopUtilization(elu);
+    const gaps = stop();
+    for (let k = 0; k < 2; k++) {
+      const node = FS.nodes.get(out[k]);
+      if (node.usedBytes !== size || node.contents[0] !== k + 1 || node.contents[size - 1] !== k + 1) throw new Error(`${label}: file ${k} mismatched`);
+    }
+    if (dedup.hashed !== 2 * size || dedup.linked) throw new Error(`${label}: ${dedup.hashed} bytes hashed, ${dedup.linked} linked`);
+    const longest = Math.max(...gaps);
+    const over = gaps.filter((g) => g > FRAME).length;
+    console.log(`${label.padEnd(14)} ${ms.toFixed(0).padStart(7)} ms  main thread busy ${busy.active.toFixed(0).padStart(6)} ms` +
+                `  longest ${longest.toFixed(1).padStart(6)} ms  over a frame ${String(over).padStart(4)}`);
+    return { longest, over, busy: busy.active };
+  }
+  console.log(`2 files of ${(size / 1048576).toFixed(0)} MiB, chunk ${chunk} bytes, hashed for dedup`);
+  const on = await run("main thread", false);
+  const off = await run("import worker", true);
+  console.log(`import worker  ${(on.busy / off.busy).toFixed(2)}x less main-thread time`);
+} finally {
+  for (const path of paths) unlinkSync(path);
+}
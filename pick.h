@@ -8,16 +8,21 @@
 //   - [File Picker Functions](#file-picker-functions)
 //   - [Message Functions](#message-functions)
 //   - [Callback Signatures](#callback-signatures)
+//   - [Cancellation and Timeouts](#cancellation-and-timeouts)
+//   - [Import Progress](#import-progress)
+//   - [Releasing Imported Files](#releasing-imported-files)
 // - [Data Structures](#data-structures)
 //   - [PickFileOptions](#pickfileoptions)
 //   - [PickFilter](#pickfilter)
 //   - [PickMessageOptions](#pickmessageoptions)
 //   - [PickIconType](#pickicontype)
+//   - [PickStorage](#pickstorage)
 // - [Platform-Specific Details](#platform-specific-details)
 //   - [macOS](#macos)
 //   - [Windows](#windows)
 //   - [Linux](#linux)
 //   - [Web/Emscripten](#webemscripten)
+//   - [Headless](#headless)
 // - [Configuration Macros](#configuration-macros)
 // - [Examples](#examples)
 // - [License](#license)
@@ -71,12 +76,75 @@
 // | `PickFileCallback` | `void (*)(const char* path, void* user)` | `path` is NULL on cancel |
 // | `PickMultiFileCallback` | `void (*)(const char** paths, int count, void* user)` | `paths` is NULL on cancel |
 // | `PickMessageCallback` | `void (*)(PickButtonResult result, void* user)` | `result` indicates which button |
+// | `PickProgressCallback` | `bool (*)(int files_done, int files_total, unsigned long long bytes_done, unsigned long long bytes_total, void* user)` | Return false to abort |
+// | `PickResultCallback` | `void (*)(bool ok, void* user)` | `ok` is false on failure or cancel |
+// | `PickResyncCallback` | `void (*)(bool ok, const char** paths, const PickChangeKind* kinds, int count, void* user)` | `ok` is false on failure or cancel |
 //
 // **Important:** 
 // - All APIs are asynchronous (non-blocking) if you provide a parent window handle. Otherwise, they are blocking.
 // - Callbacks are invoked on the main thread
 // - String pointers are only valid during callback execution
 //
+// ### Cancellation and Timeouts
+//
+// Every `pick_*` call returns a `PickRequest` handle (`PICK_REQUEST_NONE` if the dialog
+// could not be shown; its callback has then already run).
+//
+// ```c
+// bool pick_cancel(PickRequest request);
+// ```
+//
+// `pick_cancel()` dismisses the dialog, stops work still running for it (the web backend
+// stops copying files into MEMFS and removes the partial copy), and runs the callback
+// with the cancelled result (`NULL` paths or `PICK_RESULT_CLOSED`) before returning true.
+// Finished, cancelled and unknown handles return false, so an app can cancel on scene
+// change without tracking which callbacks already fired.
+//
+// A non-zero `timeout_ms` in `PickFileOptions`/`PickMessageOptions` cancels the request
+// the same way once it has been pending that long. On Linux and headless the deadline
+// is checked by `pick_poll()`, so it fires at the first poll after it expires; the
+// portal and subprocess backends also make `pick_poll_fd()` readable at that moment.
+//
+// ### Import Progress
+//
+// Set `progress` in `PickFileOptions` to follow the copy of picked files into MEMFS
+// on the web backend (other backends hand out native paths and never call it). It
+// gets the request's `user_data` and runs at most `PICK_EM_PROGRESS_HZ` times a
+// second while files are copied, plus once when the import starts and once when it
+// has finished. Returning false aborts the import exactly like `pick_cancel()`: the
+// partial copy is removed and the result callback runs with `NULL` before the
+// progress callback returns. Lazy imports copy nothing and report no progress.
+//
+// ```c
+// static bool on_progress(int files_done, int files_total,
+//                         unsigned long long bytes_done, unsigned long long bytes_total, void* user) {
+//   ui_set_progress(bytes_total ? (double)bytes_done / bytes_total : 1.0);
+//   return !ui_cancel_pressed();
+// }
+// ```
+//
+// ### Releasing Imported Files
+//
+// ```c
+// void pick_release(const char *const *paths, int count);
+// bool pick_release_request(PickRequest request);
+// ```
+//
+// On the web backend every import lands in a folder of its own, `/picked/<request>/`,
+// so two picks of files with the same name do not overwrite each other, and nothing is
+// deleted until the app says so. `pick_release()` deletes imported paths from MEMFS and
+// `pick_release_request()` deletes everything a request imported, forgetting its folder
+// for `pick_folder_resync()`. The heap copies become garbage, and files served from OPFS
+// give back their spill file or cache entry. Only paths under the import directory are
+// touched; paths elsewhere, and native paths on other backends, are left alone.
+//
+// ```c
+// static void on_files(const char** paths, int count, void* user) {
+//   for (int i = 0; i < count; i++) load_asset(paths[i]);
+//   pick_release(paths, count);  // the assets are parsed; drop the copies
+// }
+// ```
+//
 // ---
 //
 // ## Data Structures
@@ -95,6 +163,10 @@
 // | `can_create_dirs` | `bool` | Allow creating directories (save only) | false |
 // | `allow_multiple` | `bool` | Allow multiple selection | false |
 // | `parent_handle` | `const void*` | Parent window handle | NULL |
+// | `timeout_ms` | `unsigned` | Cancel after this many milliseconds | 0 (never) |
+// | `progress` | `PickProgressCallback` | Import progress, see [Import Progress](#import-progress) | NULL |
+// | `exclude` | `const char* const*` | Glob patterns skipped in a picked folder, web only | NULL |
+// | `exclude_count` | `int` | Number of exclude patterns | 0 |
 //
 // ### PickFilter
 //
@@ -120,6 +192,7 @@
 // | `icon_type` | `PickIconType` | Icon type | `PICK_ICON_DEFAULT` |
 // | `icon_path` | `const char*` | Path to custom icon | NULL |
 // | `parent_handle` | `const void*` | Parent window | NULL |
+// | `timeout_ms` | `unsigned` | Cancel after this many milliseconds | 0 (never) |
 //
 // ### PickButtonType
 //
@@ -162,7 +235,7 @@
 // | Enum Value | Description | Platform Support |
 // |------------|-------------|------------------|
 // | `PICK_ICON_DEFAULT` | Platform default | All |
-// | `PICK_ICON_CUSTOM` | Custom from file | macOS, Web |
+// | `PICK_ICON_CUSTOM` | Custom from file | macOS, Web, Linux |
 // | `PICK_ICON_APP` | Application icon | macOS |
 // | `PICK_ICON_TRASH` | Trash/Recycle bin | macOS |
 // | `PICK_ICON_FOLDER` | Folder | macOS, Web |
@@ -176,6 +249,19 @@
 // | `PICK_ICON_STOP` | Stop sign | macOS |
 // | `PICK_ICON_INVALID` | Invalid data | macOS |
 //
+// ### PickStorage
+//
+// Where a returned path's bytes live, as reported by `pick_path_storage(path)`.
+// Call it from the callback for each path, or any time later.
+//
+// | Enum Value | Description | Platform |
+// |------------|-------------|----------|
+// | `PICK_STORAGE_NONE` | Not a file pick.h knows about | All |
+// | `PICK_STORAGE_NATIVE` | A path on the native file system | macOS, Linux, Headless |
+// | `PICK_STORAGE_MEMORY` | Copied into MEMFS, in the wasm heap | Web |
+// | `PICK_STORAGE_LAZY` | Read from the picked File on demand | Web |
+// | `PICK_STORAGE_OPFS` | Spilled to the Origin Private File System, read on demand | Web |
+//
 // ---
 //
 // ## Platform-Specific Details
@@ -217,10 +303,77 @@
 //
 // ### Linux
 //
-// **Status:** Not implemented  
-// **Planned Backend:** xdg-desktop-portal, GTK
+// **Status:** Implemented  
+// **Backend:** xdg-desktop-portal (`org.freedesktop.portal.FileChooser`), `org.freedesktop.Notifications` via libdbus
 //
-// Including the implementation will trigger `#error`.
+// #### Build Requirements
+//
+// ```bash
+// cc myapp.c $(pkg-config --cflags --libs dbus-1) -o myapp
+// ```
+//
+// #### CMake Example
+//
+// ```cmake
+// if(CMAKE_SYSTEM_NAME STREQUAL Linux)
+//   find_package(PkgConfig REQUIRED)
+//   pkg_check_modules(DBUS REQUIRED IMPORTED_TARGET dbus-1)
+//   target_link_libraries(myapp PRIVATE PkgConfig::DBUS)
+// endif()
+// ```
+//
+// #### Event Loop
+//
+// No GUI toolkit is linked. All requests share one private session-bus connection,
+// opened on the first call, and results arrive as D-Bus signals. Nothing is delivered
+// until the application pumps the connection:
+//
+// ```c
+// void pick_poll(void);     // dispatch finished dialogs; call once per frame
+// int  pick_poll_fd(void);  // or poll() this descriptor and call pick_poll() when readable
+// ```
+//
+// #### Notes
+//
+// - `parent_handle` is a portal parent-window identifier string such as `"x11:1c00007"`
+//   or `"wayland:<exported handle>"`; it makes the dialog modal to that window.
+// - Message boxes are shown as notifications with one action per button.
+//   `PICK_RESULT_CLOSED` is delivered when the notification is dismissed.
+// - The portal returns file URIs; they are decoded to plain paths before delivery.
+//   Inside a sandbox these are document-portal paths under `/run/user/<uid>/doc/`.
+// - To test against a fake portal, point `DBUS_SESSION_BUS_ADDRESS` at a private
+//   `dbus-daemon --session` that owns `org.freedesktop.portal.Desktop`.
+//   `make portal-test` in `example/` does this with `example/fake_portal.c`.
+//
+// #### GTK Backend (`PICK_LINUX_GTK`)
+//
+// Define `PICK_LINUX_GTK` to use `GtkFileChooserNative` and `GtkMessageDialog` instead.
+// Nothing links against GTK: libgtk-3 or libgtk-4 is `dlopen`ed on the first dialog
+// call and the needed symbols are resolved into a function table, so binaries that
+// never show a dialog pay no toolkit load or init cost. If neither library loads (or
+// there is no display), callbacks receive a cancel result.
+//
+// ```bash
+// cc myapp.c -DPICK_LINUX_GTK -ldl -o myapp
+// ```
+//
+// `parent_handle` is a `GtkWindow*`. GTK has no pollable descriptor here, so
+// `pick_poll_fd()` returns -1; call `pick_poll()` every frame to run the GTK main context.
+// `make startup-bench` in `example/` compares cold-process start times.
+//
+// #### Subprocess Backend (`PICK_LINUX_SUBPROCESS`)
+//
+// Define `PICK_LINUX_SUBPROCESS` for minimal environments: each dialog is a `zenity`
+// (or `kdialog`) child started with `posix_spawnp`, found on `PATH` the first time it
+// is needed. Its stdout is a non-blocking pipe registered with one epoll instance,
+// together with a pidfd for the child and a timerfd for `timeout_ms` deadlines, so
+// `pick_poll_fd()` is a single descriptor covering every pending dialog and no threads
+// are created. `pick_poll()` drains the pipes, reaps children as they exit and invokes
+// callbacks. No libraries beyond libc are required.
+//
+// Stub scripts named `zenity`/`kdialog` placed first on `PATH` make the backend scriptable;
+//   `make proc-test` in `example/` runs `example/proc_test.c` against `example/stubs/`.
+// `parent_handle` is ignored; kdialog has no multi-folder mode and returns one folder.
 //
 // ### Web/Emscripten
 //
@@ -231,7 +384,7 @@
 //
 // ```bash
 // emcc main.c -DPICK_IMPLEMENTATION \
-//   -sEXPORTED_FUNCTIONS='["_pick__deliver_single","_pick__deliver_multi_lines","_pick__deliver_msg","_main"]' \
+//   -sEXPORTED_FUNCTIONS='["_pick__deliver_single","_pick__deliver_multi_buf","_pick__deliver_msg","_pick__result_alloc","_pick__req_alive","_pick__deliver_progress","_main"]' \
 //   -sEXPORTED_RUNTIME_METHODS='["ccall"]' \
 //   -sFORCE_FILESYSTEM=1 \
 //   -sALLOW_MEMORY_GROWTH=1 \
@@ -245,7 +398,7 @@
 //   target_link_options(myapp PRIVATE
 //     -sFORCE_FILESYSTEM=1
 //     "-sEXPORTED_RUNTIME_METHODS=['ccall']"
-//     "-sEXPORTED_FUNCTIONS=['_pick__deliver_single','_pick__deliver_multi_lines','_pick__deliver_msg','_main']"
+//     "-sEXPORTED_FUNCTIONS=['_pick__deliver_single','_pick__deliver_multi_buf','_pick__deliver_msg','_pick__result_alloc','_pick__req_alive','_pick__deliver_progress','_main']"
 //     -sALLOW_MEMORY_GROWTH=1
 //   )
 // endif()
@@ -255,24 +408,173 @@
 //
 // | Operation | Default Path | Description |
 // |-----------|--------------|-------------|
-// | File import | `/picked/` | Selected files copied here |
+// | File import | `/picked/<request>/` | Selected files copied here |
 // | Save operations | `/saved/` | Created files go here |
-// | Directory import | `/picked/{structure}/` | Preserves folder hierarchy |
+// | Directory import | `/picked/<request>/{structure}/` | Preserves folder hierarchy |
+//
+// A folder picked through `showDirectoryPicker` is walked breadth first with up to
+// `PICK_EM_WALK_CONCURRENCY` listings and file lookups in flight, and the dialog lists
+// files as they are found; Import is enabled once the walk is done.
+//
+// Folder picks honor `filters` as include patterns: only files with one of the listed
+// extensions are imported. `exclude` lists glob patterns matched against paths relative
+// to the picked folder: `*` and `?` stay within a name, `**` spans folders, a pattern
+// without `/` matches at any depth, and a folder that matches is skipped whole. Skipped
+// files and folders are never read or even listed.
+//
+// ```c
+// const char* skip[] = { ".git", "node_modules/**", "build/", "*.tmp" };
+// PickFileOptions opts = { .filters = filters, .filter_count = 1, .exclude = skip, .exclude_count = 4 };
+// pick_folder(&opts, on_folder, NULL);
+// ```
+//
+// With `PICK_EM_LAZY_IMPORT` defined to 1, picked files are not copied: the
+// callback gets its paths as soon as the dialog closes, and each file's bytes
+// are read from the browser in `PICK_EM_IMPORT_CHUNK` windows only when C
+// reads them. Those reads are synchronous, which off a worker means a
+// synchronous XHR on the main thread. Lazy files are read-only.
+//
+// `PICK_EM_MAX_IMPORT_BYTES` caps how much one import copies into the heap.
+// Files that would take it over the budget are streamed into the Origin
+// Private File System instead and served from there like lazy files
+// (`PICK_STORAGE_OPFS`). Without OPFS write support they stay lazy over the
+// picked File (`PICK_STORAGE_LAZY`). Spilled copies live in a per-tab
+// directory that the next page load removes once the tab is gone.
 //
 // #### Extended API (Emscripten Only)
 //
 // ```c
 // typedef void (*PickResultCallback)(bool success, void* user_data);
 //
-// void pick_export_file(
+// PickRequest pick_export_file(
 //     const char* src_path, 
 //     const PickFileOptions* options,
 //     PickResultCallback callback, 
 //     void* user_data
 // );
+//
+// PickRequest pick_export_buffer(
+//     const void* data,
+//     size_t len,
+//     const PickFileOptions* options,
+//     PickResultCallback callback,
+//     void* user_data
+// );
 // ```
 //
 // Exports a file from MEMFS to user's downloads folder using File System Access API when available.
+// The file is read `PICK_EM_IMPORT_CHUNK` bytes at a time and written out as it goes, so
+// exporting it needs one chunk of free memory rather than a second copy of the file.
+// `pick_export_buffer()` exports bytes the app generated straight from the wasm heap,
+// with no MEMFS file to write first; the buffer must stay untouched until the callback.
+// Both exist on every backend so shared code compiles; natively the callback runs
+// at once with false and `PICK_REQUEST_NONE` is returned.
+//
+// #### Import Cache
+//
+// With `PICK_EM_IMPORT_CACHE_BYTES` set, every imported file is also kept in OPFS
+// (`pick-cache/`), keyed by relative path, size and last-modified time. A later pick of the
+// same file, in this session or a later one, reads the cached copy instead of the
+// picked File. `PICK_EM_IMPORT_CACHE_HASH` adds a SHA-256 of the file's first,
+// middle and last 64 KiB to the key, for sources whose timestamps cannot be
+// trusted. Least recently used entries are evicted to stay under the cap. Files
+// past `PICK_EM_MAX_IMPORT_BYTES` are served straight from their cache entry. Tabs
+// share the cache; if two save its index at once, the entries only one of them
+// knew about are dropped on the next load.
+//
+// ```c
+// PickCacheStats st;
+// if (pick_em_cache_stats(&st)) printf("%llu hits, %llu misses\n", st.hits, st.misses);
+// ```
+//
+// #### Import Deduplication
+//
+// With `PICK_EM_IMPORT_DEDUP`, files imported into the heap are hashed (xxHash32) while
+// they stream in, when another file of the same size was picked. A file whose bytes
+// match one already in MEMFS shares its storage, so a folder with many copies of a
+// texture or font holds it once. Shared paths behave like separate files: writing or
+// truncating one gives it its own copy first. Lazy and spilled files are not
+// deduplicated, and the shared bytes count only once against `PICK_EM_MAX_IMPORT_BYTES`.
+//
+// ```c
+// PickDedupStats st;
+// if (pick_em_dedup_stats(&st)) printf("%llu files linked, %llu bytes saved\n", st.linked_files, st.saved_bytes);
+// ```
+//
+// #### Import Worker
+//
+// With `PICK_EM_IMPORT_WORKER`, on by default in `-pthread` builds, picked files are read
+// and hashed in a Web Worker started from a `blob:` URL. The Files are handed to it by
+// structured clone, which passes the handle and not the bytes. Each slice is transferred
+// back, so the main thread only copies it into MEMFS. Progress and completion are
+// still delivered on the main thread. Where no worker can be started, as under a CSP
+// without `blob:` workers, or once it fails, the reads fall back to the main thread.
+//
+// The worker does not make imports jank-free. MEMFS lives in the main thread's
+// JavaScript heap, so every `FS.write` of every chunk still runs there, and with the
+// bookkeeping around it the main thread can stall for about 20 ms at a time, more
+// than a 60 Hz frame; `make worker-bench` measures it. `PICK_EM_LAZY_IMPORT` skips
+// the copy entirely.
+//
+// #### Folder Resync
+//
+// A folder picked through `showDirectoryPicker` keeps its directory handle. Passing the
+// request that picked it to `pick_folder_resync()` walks the folder again and compares
+// each file's size and last-modified time with the last import: only added and changed
+// files are copied, and files gone from the folder are deleted from MEMFS. The callback
+// gets the changed paths, each with its `PickChangeKind`; progress covers only the copies.
+// Folders picked through the `<input webkitdirectory>` fallback cannot be resynced.
+// Cancelling a resync drops the files it was copying; the next resync copies them again.
+//
+// ```c
+// static void on_resync(bool ok, const char** paths, const PickChangeKind* kinds, int count, void* user) {
+//   for (int i = 0; ok && i < count; i++) if (kinds[i] != PICK_CHANGE_REMOVED) reload_asset(paths[i]);
+// }
+// pick_folder_resync(folder_request, NULL, on_resync, NULL);
+// ```
+//
+// #### Storage Eviction
+//
+// Imported and saved files stay in MEMFS until the app deletes them or calls
+// `pick_release()`. For long sessions, `PICK_EM_STORAGE_MAX_BYTES` and
+// `PICK_EM_STORAGE_MAX_AGE` delete them automatically, least recently used first: a
+// file's age restarts whenever the app opens it, and files with an open stream are
+// never deleted. The caps are applied as imports and saves arrive, sparing the files
+// that just arrived, and periodically for the age cap. Lazy and OPFS-backed files
+// count no heap bytes. An evicted file of a picked folder is copied again by the next
+// `pick_folder_resync()`.
+//
+// ```c
+// #define PICK_EM_STORAGE_MAX_BYTES (512ull << 20)
+// #define PICK_EM_STORAGE_MAX_AGE (30 * 60)
+// ...
+// PickStorageStats st;
+// if (pick_em_storage_stats(&st)) printf("%llu files, %llu bytes, %llu evicted\n", st.files, st.bytes, st.evictions);
+// ```
+//
+// ### Headless
+//
+// **Status:** Implemented  
+// **Backend:** Scripted answers, no display
+//
+// Define `PICK_PLATFORM_HEADLESS` before including the header (on any OS) to replace
+// the native backend with one that answers every `pick_*` call from a FIFO script.
+// Requests go through the same request table and `pick__deliver_*` entry points the
+// web backend uses, so delivery, filter handling and request bookkeeping can be
+// tested and benchmarked on a CI machine.
+//
+// ```c
+// const char* paths[] = { "/data/a.png", "/data/b.txt" };
+// pick_headless_push_paths(paths, 2, 0);          // next file request gets these
+// pick_headless_push_button(PICK_RESULT_YES, 10); // next message box, after 10 ms
+// pick_headless_push_cancel(0);                   // next request is cancelled
+//
+// pick_files(&opts, on_files, NULL);  // filters drop b.txt if only png is allowed
+// pick_poll();                        // callbacks run here, never inside pick_files()
+// ```
+//
+// Requests with no scripted answer left are cancelled. A message box given a path
+// answer, or a file request given a button answer, is cancelled as well.
 //
 // ---
 //
@@ -283,9 +585,26 @@
 // | Macro | Description | Default | Platform |
 // |-------|-------------|---------|----------|
 // | `PICK_IMPLEMENTATION` | Enable implementation | undefined | All |
-// | `PICK_EM_MAX_REQUESTS` | Max concurrent operations | 64 | Emscripten |
+// | `PICK_MALLOC`, `PICK_CALLOC`, `PICK_REALLOC`, `PICK_FREE` | Allocator used for results and bookkeeping (define all four) | libc | All |
+// | `PICK_LINUX_GTK` | Use the dlopen GTK backend instead of the portal | undefined | Linux |
+// | `PICK_GTK_LIBRARIES` | Comma-separated sonames tried in order | `"libgtk-3.so.0", "libgtk-4.so.1"` | Linux |
+// | `PICK_LINUX_SUBPROCESS` | Use the zenity/kdialog subprocess backend | undefined | Linux |
+// | `PICK_SUBPROCESS_TOOLS` | Comma-separated helper names tried in order | `"zenity", "kdialog"` | Linux |
+// | `PICK_EM_MAX_REQUESTS` | Initial request slab capacity (grows on demand) | 64 | Emscripten, Headless |
 // | `PICK_EM_BASE_PICKED` | Import directory | "/picked" | Emscripten |
 // | `PICK_EM_BASE_SAVED` | Save directory | "/saved" | Emscripten |
+// | `PICK_EM_IMPORT_CHUNK` | Bytes read per step when importing a picked file or exporting one; bounds the extra memory either needs | 4 MiB | Emscripten |
+// | `PICK_EM_IMPORT_CONCURRENCY` | Picked files read from the browser at once during an import | 8 | Emscripten |
+// | `PICK_EM_WALK_CONCURRENCY` | Directory listings and file lookups in flight while walking a picked folder | 16 | Emscripten |
+// | `PICK_EM_MAX_IMPORT_BYTES` | Bytes one import may copy into the heap before further files spill to OPFS (0 = no limit) | 0 | Emscripten |
+// | `PICK_EM_IMPORT_CACHE_BYTES` | Size cap of the persistent OPFS import cache (0 = no cache) | 0 | Emscripten |
+// | `PICK_EM_IMPORT_CACHE_HASH` | Also key the import cache by a content hash (1) | 0 | Emscripten |
+// | `PICK_EM_IMPORT_DEDUP` | Store identical imported files once, shared between their paths (1) | 0 | Emscripten |
+// | `PICK_EM_IMPORT_WORKER` | Read and hash picked files in a Web Worker, off the main thread (1); MEMFS writes stay on it | 1 with `-pthread`, else 0 | Emscripten |
+// | `PICK_EM_PROGRESS_HZ` | Most `PickFileOptions.progress` calls per second during an import | 10 | Emscripten |
+// | `PICK_EM_LAZY_IMPORT` | Deliver picked paths at once and read bytes from the browser only when the file is read (1) | 0 | Emscripten |
+// | `PICK_EM_STORAGE_MAX_BYTES` | Heap bytes imported and saved files may hold before the least recently used are deleted (0 = no cap) | 0 | Emscripten |
+// | `PICK_EM_STORAGE_MAX_AGE` | Seconds an imported or saved file may go unopened before it is deleted (0 = no cap) | 0 | Emscripten |
 //
 // ---
 //
@@ -367,7 +686,9 @@
 extern "C" {
 #endif
 
-#if defined(__APPLE__) && defined(__MACH__)
+#if defined(PICK_PLATFORM_HEADLESS)
+  // Scripted backend selected explicitly; no native dialogs are used.
+#elif defined(__APPLE__) && defined(__MACH__)
   #define PICK_PLATFORM_MACOS
 #elif defined(_WIN32) || defined(_WIN64)
   #define PICK_PLATFORM_WINDOWS
@@ -379,6 +700,8 @@ extern "C" {
   #error "Unsupported platform"
 #endif
 
+#include <stddef.h>
+
 /// @brief File type filter for file dialogs
 typedef struct PickFilter {
   const char *name;        ///< Display name (e.g., "Images")
@@ -429,6 +752,47 @@ typedef enum PickIconType {
   PICK_ICON_INVALID
 } PickIconType;
 
+/// @brief Callback for import progress (web backend)
+/// @param files_done Files fully copied so far
+/// @param files_total Files being imported
+/// @param bytes_done Bytes copied so far
+/// @param bytes_total Bytes being imported
+/// @param user_data Context passed to the pick_* call
+/// @return false to abort the import, as pick_cancel() would
+typedef bool (*PickProgressCallback)(int files_done, int files_total,
+                                     unsigned long long bytes_done,
+                                     unsigned long long bytes_total, void *user_data);
+
+/// @brief Where the bytes of a returned path live (see pick_path_storage())
+typedef enum PickStorage {
+  PICK_STORAGE_NONE = 0, ///< Unknown path
+  PICK_STORAGE_NATIVE,   ///< Native file system
+  PICK_STORAGE_MEMORY,   ///< MEMFS copy in the wasm heap
+  PICK_STORAGE_LAZY,     ///< Read from the picked File on demand
+  PICK_STORAGE_OPFS      ///< Spilled to the Origin Private File System, read on demand
+} PickStorage;
+
+/// @brief How a path changed since the last import of its folder (see pick_folder_resync())
+typedef enum PickChangeKind {
+  PICK_CHANGE_ADDED = 0, ///< New in the folder, copied
+  PICK_CHANGE_MODIFIED,  ///< Size or last-modified time changed, copied again
+  PICK_CHANGE_REMOVED    ///< Gone from the folder, deleted from MEMFS
+} PickChangeKind;
+
+/// @brief Callback for pick_folder_resync()
+/// @param ok false if the folder could not be walked or the resync was cancelled
+/// @param paths Changed paths, NULL when count is 0
+/// @param kinds Change of each path
+/// @param count Number of changed paths (0 when nothing changed)
+/// @param user_data User-provided context
+typedef void (*PickResyncCallback)(bool ok, const char **paths, const PickChangeKind *kinds,
+                                   int count, void *user_data);
+
+/// @brief Callback for pick_export_file() and pick_export_buffer()
+/// @param ok true once the file was written or handed to the browser's download
+/// @param user_data User-provided context
+typedef void (*PickResultCallback)(bool ok, void *user_data);
+
 /// @brief Configuration for file picker dialogs
 typedef struct PickFileOptions {
   const char *title;        ///< Dialog title/message
@@ -439,6 +803,10 @@ typedef struct PickFileOptions {
   bool can_create_dirs;     ///< Allow creating directories (save dialogs)
   bool allow_multiple;      ///< Allow selecting multiple items
   const void *parent_handle;///< Platform-specific parent window handle (optional)
+  unsigned timeout_ms;      ///< Cancel automatically after this many milliseconds (0 = never)
+  PickProgressCallback progress; ///< Import progress, web only (optional)
+  const char *const *exclude;    ///< Glob patterns skipped when importing a picked folder, web only (optional)
+  int exclude_count;             ///< Number of exclude patterns
 } PickFileOptions;
 
 /// @brief Configuration for message boxes and sheets
@@ -451,8 +819,15 @@ typedef struct PickMessageOptions {
   PickIconType icon_type;  ///< Icon type to use
   const char *icon_path;   ///< Path to custom icon (if icon_type == PICK_ICON_CUSTOM)
   const void *parent_handle;///< If set, shows as sheet/modal dialog on parent
+  unsigned timeout_ms;     ///< Cancel automatically after this many milliseconds (0 = never)
 } PickMessageOptions;
 
+/// @brief Handle for a pending dialog, returned by every pick_* call
+/// @note PICK_REQUEST_NONE means nothing is pending: the dialog could not be
+///       shown and its callback has already run.
+typedef int PickRequest;
+#define PICK_REQUEST_NONE 0
+
 /// @brief Callback for single file selection
 /// @param path Selected file path or NULL if cancelled
 /// @param user_data User-provided context
@@ -474,49 +849,56 @@ typedef void (*PickMessageCallback)(PickButtonResult result, void *user_data);
 /// @param options Dialog configuration (can be NULL for defaults)
 /// @param callback Function called with selected file
 /// @param user_data Context passed to callback
-void pick_file(const PickFileOptions *options, PickFileCallback callback,
-               void *user_data);
+/// @return Handle for pick_cancel()
+PickRequest pick_file(const PickFileOptions *options, PickFileCallback callback,
+                      void *user_data);
 
 /// @brief Shows file open dialog for multiple file selection 
 /// @param options Dialog configuration (can be NULL for defaults)
 /// @param callback Function called with selected files
 /// @param user_data Context passed to callback
-void pick_files(const PickFileOptions *options, PickMultiFileCallback callback,
-                void *user_data);
+/// @return Handle for pick_cancel()
+PickRequest pick_files(const PickFileOptions *options, PickMultiFileCallback callback,
+                       void *user_data);
 
 /// @brief Shows folder selection dialog 
 /// @param options Dialog configuration (can be NULL for defaults)
 /// @param callback Function called with selected folder
 /// @param user_data Context passed to callback
-void pick_folder(const PickFileOptions *options, PickFileCallback callback,
-                 void *user_data);
+/// @return Handle for pick_cancel()
+PickRequest pick_folder(const PickFileOptions *options, PickFileCallback callback,
+                        void *user_data);
 
 /// @brief Shows folder selection dialog for multiple folders 
 /// @param options Dialog configuration (can be NULL for defaults)
 /// @param callback Function called with selected folders
 /// @param user_data Context passed to callback
-void pick_folders(const PickFileOptions *options,
-                  PickMultiFileCallback callback, void *user_data);
+/// @return Handle for pick_cancel()
+PickRequest pick_folders(const PickFileOptions *options,
+                         PickMultiFileCallback callback, void *user_data);
 
 /// @brief Shows file save dialog 
 /// @param options Dialog configuration (can be NULL for defaults)
 /// @param callback Function called with save path
 /// @param user_data Context passed to callback
-void pick_save(const PickFileOptions *options, PickFileCallback callback,
-               void *user_data);
+/// @return Handle for pick_cancel()
+PickRequest pick_save(const PickFileOptions *options, PickFileCallback callback,
+                      void *user_data);
 
 /// @brief Shows message box or sheet 
 /// @param options Message box configuration
 /// @param callback Function called with user response (can be NULL)
 /// @param user_data Context passed to callback
-void pick_message(const PickMessageOptions *options,
-                  PickMessageCallback callback, void *user_data);
+/// @return Handle for pick_cancel()
+PickRequest pick_message(const PickMessageOptions *options,
+                         PickMessageCallback callback, void *user_data);
 
 /// @brief Shows simple alert dialog with OK button
 /// @param title Alert title
 /// @param message Alert message
 /// @param parent_handle Parent window (NULL for standalone)
-void pick_alert(const char *title, const char *message, void *parent_handle);
+/// @return Handle for pick_cancel()
+PickRequest pick_alert(const char *title, const char *message, void *parent_handle);
 
 /// @brief Shows confirmation dialog with OK/Cancel buttons
 /// @param title Dialog title
@@ -524,56 +906,270 @@ void pick_alert(const char *title, const char *message, void *parent_handle);
 /// @param parent_handle Parent window (NULL for standalone)
 /// @param callback Function called with user response
 /// @param user_data Context passed to callback
-void pick_confirm(const char *title, const char *message, void *parent_handle,
-                  PickMessageCallback callback, void *user_data);
+/// @return Handle for pick_cancel()
+PickRequest pick_confirm(const char *title, const char *message, void *parent_handle,
+                         PickMessageCallback callback, void *user_data);
+
+/// @brief Dismisses a pending dialog and stops any work still running for it
+/// @param request Handle returned by a pick_* call
+/// @return true if the request was still pending. Its callback has then already
+///         run with the cancelled result (NULL paths or PICK_RESULT_CLOSED).
+/// @note Handles of finished or cancelled requests are ignored, so it is safe
+///       to cancel a handle whose callback may already have fired.
+bool pick_cancel(PickRequest request);
 
 /// @brief Frees memory for a single path returned by the library
 /// @param path Path to free
 void pick_free(char *path);
 
 /// @brief Frees memory for multiple paths returned by the library
+/// @note The array and its strings are one allocation; individual entries
+///       must not be freed or reallocated on their own.
 /// @param paths Array of paths to free
-/// @param count Number of paths
+/// @param count Number of paths (unused, kept for source compatibility)
 void pick_free_multiple(char **paths, int count);
 
+/// @brief Reports where the bytes of a path handed to a callback live
+/// @param path A path from a pick_* callback
+/// @return PICK_STORAGE_NATIVE on native backends; on the web, whether the
+///         import copied the file into the heap or left it in the browser
+PickStorage pick_path_storage(const char *path);
+
+/// @brief Deletes imported files from MEMFS and frees their memory (web backend)
+/// @param paths Paths from a pick_* callback; paths outside the import directory are ignored
+/// @param count Number of paths
+/// @note A no-op on native backends, whose paths are the user's own files.
+void pick_release(const char *const *paths, int count);
+
+/// @brief Deletes everything a request imported (web backend)
+/// @param request Handle returned by the pick_* call, finished or not
+/// @return true if the request had imported files; always false on native backends
+bool pick_release_request(PickRequest request);
+
+/// @brief Saves a MEMFS file outside the browser, through a save picker or a download (web backend)
+/// @param src_path File to export
+/// @param options Only default_name and timeout_ms are used (can be NULL)
+/// @param callback Receives whether the file was written
+/// @param user_data Context passed to callback
+/// @return Handle for pick_cancel(), or PICK_REQUEST_NONE after the callback ran with false
+/// @note Native backends have nothing to export; the callback runs with false.
+PickRequest pick_export_file(const char *src_path, const PickFileOptions *options,
+                             PickResultCallback callback, void *user_data);
+
+/// @brief Saves bytes from memory outside the browser, without a MEMFS copy (web backend)
+/// @param data Bytes to export; must stay valid and unchanged until the callback runs
+/// @param len Number of bytes
+/// @param options Only default_name and timeout_ms are used (can be NULL)
+/// @param callback Receives whether the file was written
+/// @param user_data Context passed to callback
+/// @return Handle for pick_cancel(), or PICK_REQUEST_NONE after the callback ran with false
+/// @note Native backends have nothing to export; the callback runs with false.
+PickRequest pick_export_buffer(const void *data, size_t len, const PickFileOptions *options,
+                               PickResultCallback callback, void *user_data);
+
+#if defined(PICK_PLATFORM_LINUX) || defined(PICK_PLATFORM_HEADLESS)
+/// @brief Dispatches finished dialogs and invokes their callbacks (Linux, headless)
+/// @note Call once per frame, or whenever pick_poll_fd() becomes readable.
+///       Callbacks run on the thread that calls this function.
+void pick_poll(void);
+
+/// @brief Returns a descriptor that becomes readable when pick_poll() has work (Linux, headless)
+/// @return Pollable file descriptor, or -1 if no backend connection is available
+int pick_poll_fd(void);
+#endif
+
+#ifdef PICK_PLATFORM_EMSCRIPTEN
+/// @brief Counters of the persistent import cache (PICK_EM_IMPORT_CACHE_BYTES)
+typedef struct PickCacheStats {
+  unsigned long long hits;      ///< Picked files restored from the cache
+  unsigned long long misses;    ///< Picked files read from the browser
+  unsigned long long hit_bytes; ///< Bytes restored instead of read again
+  unsigned long long evictions; ///< Entries dropped to stay under the cap
+  unsigned long long bytes;     ///< Bytes the cache holds now
+  unsigned long long entries;   ///< Entries the cache holds now
+} PickCacheStats;
+
+/// @brief Reads the import cache counters (Emscripten)
+/// @param out Receives the counters for this page load; bytes and entries cover all sessions
+/// @return false if the cache is disabled, not open yet, or OPFS is unavailable
+bool pick_em_cache_stats(PickCacheStats *out);
+
+/// @brief Counters of import deduplication (PICK_EM_IMPORT_DEDUP)
+typedef struct PickDedupStats {
+  unsigned long long linked_files; ///< Imported files sharing another file's storage
+  unsigned long long saved_bytes;  ///< Heap bytes those files would otherwise take
+  unsigned long long hashed_bytes; ///< Bytes hashed to find them
+} PickDedupStats;
+
+/// @brief Reads the import deduplication counters (Emscripten)
+/// @param out Receives the counters for this page load; a shared file that is written stops counting
+/// @return false if deduplication is disabled
+bool pick_em_dedup_stats(PickDedupStats *out);
+
+/// @brief Usage of the import and save directories (PICK_EM_STORAGE_MAX_BYTES, PICK_EM_STORAGE_MAX_AGE)
+typedef struct PickStorageStats {
+  unsigned long long bytes;         ///< Heap bytes held by files imported or saved and still present
+  unsigned long long files;         ///< Number of those files
+  unsigned long long evictions;     ///< Files deleted by the eviction policy
+  unsigned long long evicted_bytes; ///< Heap bytes those files held
+} PickStorageStats;
+
+/// @brief Reads the storage counters (Emscripten)
+/// @param out Receives the counters for this page load
+/// @return false if no eviction cap is set
+bool pick_em_storage_stats(PickStorageStats *out);
+
+/// @brief Re-imports what changed in a folder since it was picked or last resynced (Emscripten)
+/// @param folder Request of the pick_folder()/pick_folders() call that picked the folder
+/// @param options Only progress and timeout_ms are used (can be NULL)
+/// @param callback Receives the change list
+/// @param user_data Context passed to callback
+/// @return Handle for pick_cancel(); PICK_REQUEST_NONE if the folder has no retained
+///         directory handle, after the callback ran with ok false
+PickRequest pick_folder_resync(PickRequest folder, const PickFileOptions *options,
+                               PickResyncCallback callback, void *user_data);
+
+#endif
+
+#ifdef PICK_PLATFORM_HEADLESS
+/// @brief Queues a scripted answer: the next file/folder/save request receives these paths
+/// @param paths Paths to report (copied); open requests drop paths that fail their filters
+/// @param count Number of paths (0 behaves like pick_headless_push_cancel())
+/// @param delay_ms Milliseconds after the request before pick_poll() delivers it
+void pick_headless_push_paths(const char *const *paths, int count, unsigned delay_ms);
+
+/// @brief Queues a scripted answer: the next request is cancelled
+/// @param delay_ms Milliseconds after the request before pick_poll() delivers it
+void pick_headless_push_cancel(unsigned delay_ms);
+
+/// @brief Queues a scripted answer: the next message box reports this button
+/// @param result Button result to deliver
+/// @param delay_ms Milliseconds after the request before pick_poll() delivers it
+void pick_headless_push_button(PickButtonResult result, unsigned delay_ms);
+
+/// @brief Drops all scripted answers and undelivered results without invoking callbacks
+void pick_headless_reset(void);
+
+/// @brief Returns the number of requests whose results have not been delivered yet
+int pick_headless_pending(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
 
 #ifdef PICK_IMPLEMENTATION
 
-void pick__file_impl(const PickFileOptions *options, PickFileCallback callback, void *user_data);
-void pick__files_impl(const PickFileOptions *options, PickMultiFileCallback callback, void *user_data);
-void pick__folder_impl(const PickFileOptions *options, PickFileCallback callback, void *user_data);
-void pick__folders_impl(const PickFileOptions *options, PickMultiFileCallback callback, void *user_data);
-void pick__save_impl(const PickFileOptions *options, PickFileCallback callback, void *user_data);
-void pick__message_impl(const PickMessageOptions *options, PickMessageCallback callback, void *user_data);
+#if !defined(PICK_MALLOC) || !defined(PICK_CALLOC) || !defined(PICK_REALLOC) || !defined(PICK_FREE)
+#include <stdlib.h>
+#undef PICK_MALLOC
+#undef PICK_CALLOC
+#undef PICK_REALLOC
+#undef PICK_FREE
+#define PICK_MALLOC(size)       malloc(size)
+#define PICK_CALLOC(count, size) calloc(count, size)
+#define PICK_REALLOC(ptr, size) realloc(ptr, size)
+#define PICK_FREE(ptr)          free(ptr)
+#endif
+
+#include <string.h>
+
+#if defined(PICK_PLATFORM_MACOS) || defined(PICK_PLATFORM_LINUX)
+// Native backends number their requests here; the web and headless backends
+// use request slab ids instead.
+static PickRequest pick__next_request(void) {
+  static unsigned counter;
+  unsigned id;
+  do {
+    id = __atomic_add_fetch(&counter, 1u, __ATOMIC_RELAXED) & 0x7FFFFFFFu;
+  } while (id == 0);
+  return (PickRequest)id;
+}
+#endif
+
+#if defined(PICK_PLATFORM_LINUX) || defined(PICK_PLATFORM_HEADLESS)
+#include <time.h>
+
+// Milliseconds on CLOCK_MONOTONIC, for deadlines and scripted delays.
+static double pick__now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+#endif
+
+#ifdef PICK_PLATFORM_LINUX
+#ifndef PICK_LINUX_GTK
+static char *pick__strdup(const char *s) {
+  size_t len = strlen(s);
+  char *copy = (char *)PICK_MALLOC(len + 1);
+  if (copy) memcpy(copy, s, len + 1);
+  return copy;
+}
+#endif
+
+// Linux backends have no timer of their own; pick_poll() checks deadlines.
+static double pick__deadline_ms(unsigned timeout_ms) {
+  return timeout_ms ? pick__now_ms() + timeout_ms : 0;
+}
+
+#ifndef PICK_LINUX_GTK
+#include <sys/timerfd.h>
+
+// Arms a CLOCK_MONOTONIC timerfd for `due_ms` on the pick__now_ms() clock, or
+// disarms it when `due_ms` is 0. Backends that hand out a pick_poll_fd() keep
+// one in their epoll set so deadlines wake the caller.
+static void pick__timerfd_arm(int timer, double due_ms) {
+  if (timer < 0) return;
+  struct itimerspec its = {0};
+  if (due_ms > 0) {
+    // Round up so the timer never fires before pick_poll() sees the deadline as passed.
+    long long ns = (long long)(due_ms * 1e6) + 1;
+    its.it_value.tv_sec = (time_t)(ns / 1000000000LL);
+    its.it_value.tv_nsec = (long)(ns % 1000000000LL);
+  }
+  timerfd_settime(timer, TFD_TIMER_ABSTIME, &its, NULL);
+}
+#endif
+#endif
+
+PickRequest pick__file_impl(const PickFileOptions *options, PickFileCallback callback, void *user_data);
+PickRequest pick__files_impl(const PickFileOptions *options, PickMultiFileCallback callback, void *user_data);
+PickRequest pick__folder_impl(const PickFileOptions *options, PickFileCallback callback, void *user_data);
+PickRequest pick__folders_impl(const PickFileOptions *options, PickMultiFileCallback callback, void *user_data);
+PickRequest pick__save_impl(const PickFileOptions *options, PickFileCallback callback, void *user_data);
+PickRequest pick__message_impl(const PickMessageOptions *options, PickMessageCallback callback, void *user_data);
+bool pick__cancel_impl(PickRequest request);
+
+PickRequest pick_file(const PickFileOptions *options, PickFileCallback callback, void *user_data) {
+  return pick__file_impl(options, callback, user_data);
+}
 
-void pick_file(const PickFileOptions *options, PickFileCallback callback, void *user_data) {
-  pick__file_impl(options, callback, user_data);
+PickRequest pick_files(const PickFileOptions *options, PickMultiFileCallback callback, void *user_data) {
+  return pick__files_impl(options, callback, user_data);
 }
 
-void pick_files(const PickFileOptions *options, PickMultiFileCallback callback, void *user_data) {
-  pick__files_impl(options, callback, user_data);
+PickRequest pick_folder(const PickFileOptions *options, PickFileCallback callback, void *user_data) {
+  return pick__folder_impl(options, callback, user_data);
 }
 
-void pick_folder(const PickFileOptions *options, PickFileCallback callback, void *user_data) {
-  pick__folder_impl(options, callback, user_data);
+PickRequest pick_folders(const PickFileOptions *options, PickMultiFileCallback callback, void *user_data) {
+  return pick__folders_impl(options, callback, user_data);
 }
 
-void pick_folders(const PickFileOptions *options, PickMultiFileCallback callback, void *user_data) {
-  pick__folders_impl(options, callback, user_data);
+PickRequest pick_save(const PickFileOptions *options, PickFileCallback callback, void *user_data) {
+  return pick__save_impl(options, callback, user_data);
 }
 
-void pick_save(const PickFileOptions *options, PickFileCallback callback, void *user_data) {
-  pick__save_impl(options, callback, user_data);
+PickRequest pick_message(const PickMessageOptions *options, PickMessageCallback callback, void *user_data) {
+  return pick__message_impl(options, callback, user_data);
 }
 
-void pick_message(const PickMessageOptions *options, PickMessageCallback callback, void *user_data) {
-  pick__message_impl(options, callback, user_data);
+bool pick_cancel(PickRequest request) {
+  return request != PICK_REQUEST_NONE && pick__cancel_impl(request);
 }
 
-void pick_alert(const char *title, const char *message, void *parent_handle) {
+PickRequest pick_alert(const char *title, const char *message, void *parent_handle) {
   PickMessageOptions opts = {
     .title = title,
     .message = message,
@@ -584,11 +1180,11 @@ void pick_alert(const char *title, const char *message, void *parent_handle) {
     .icon_path = NULL,
     .parent_handle = parent_handle
   };
-  pick_message(&opts, NULL, NULL);
+  return pick_message(&opts, NULL, NULL);
 }
 
-void pick_confirm(const char *title, const char *message, void *parent_handle,
-                  PickMessageCallback callback, void *user_data) {
+PickRequest pick_confirm(const char *title, const char *message, void *parent_handle,
+                         PickMessageCallback callback, void *user_data) {
   PickMessageOptions opts = {
     .title = title,
     .message = message,
@@ -599,24 +1195,109 @@ void pick_confirm(const char *title, const char *message, void *parent_handle,
     .icon_path = NULL,
     .parent_handle = parent_handle
   };
-  pick_message(&opts, callback, user_data);
+  return pick_message(&opts, callback, user_data);
 }
 
 void pick_free(char *path) { 
-  free(path); 
+  PICK_FREE(path); 
 }
 
+// Multi-path results are one block: the pointer table followed by the
+// NUL-terminated strings it points into, so this is a single free however
+// many paths were picked.
 void pick_free_multiple(char **paths, int count) {
-  if (paths) {
-    for (int i = 0; i < count; i++) {
-      free(paths[i]);
-    }
-    free(paths);
+  (void)count;
+  PICK_FREE(paths);
+}
+
+#ifndef PICK_PLATFORM_EMSCRIPTEN
+PickStorage pick_path_storage(const char *path) {
+  return path ? PICK_STORAGE_NATIVE : PICK_STORAGE_NONE;
+}
+
+void pick_release(const char *const *paths, int count) {
+  (void)paths; (void)count;
+}
+
+bool pick_release_request(PickRequest request) {
+  (void)request;
+  return false;
+}
+
+PickRequest pick_export_file(const char *src_path, const PickFileOptions *options,
+                             PickResultCallback callback, void *user_data) {
+  (void)src_path; (void)options;
+  if (callback) callback(false, user_data);
+  return PICK_REQUEST_NONE;
+}
+
+PickRequest pick_export_buffer(const void *data, size_t len, const PickFileOptions *options,
+                               PickResultCallback callback, void *user_data) {
+  (void)data; (void)len; (void)options;
+  if (callback) callback(false, user_data);
+  return PICK_REQUEST_NONE;
+}
+#endif
+
+#if defined(PICK_PLATFORM_MACOS) || (defined(PICK_PLATFORM_LINUX) && defined(PICK_LINUX_GTK))
+// Copies `count` strings (NULL entries are skipped) into one packed block.
+static char **pick__pack_paths(const char *const *src, int count, int *out_count) {
+  size_t bytes = 0;
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    if (src[i]) { bytes += strlen(src[i]) + 1; kept++; }
+  }
+  *out_count = 0;
+  if (!kept) return NULL;
+
+  char **table = (char **)PICK_MALLOC(sizeof(char *) * (size_t)kept + bytes);
+  if (!table) return NULL;
+  char *cursor = (char *)(table + kept);
+  for (int i = 0; i < count; i++) {
+    if (!src[i]) continue;
+    size_t len = strlen(src[i]) + 1;
+    memcpy(cursor, src[i], len);
+    table[(*out_count)++] = cursor;
+    cursor += len;
+  }
+  return table;
+}
+#endif
+
+#if defined(PICK_PLATFORM_LINUX) && defined(PICK_LINUX_SUBPROCESS)
+// Splits newline-separated text into one packed block, skipping empty lines.
+static char **pick__pack_lines(const char *text, int *out_count) {
+  int lines = 0;
+  size_t len = 0;
+  for (const char *p = text; *p; p++, len++) {
+    if (*p == '\n') lines++;
+  }
+  *out_count = 0;
+  if (!len) return NULL;
+  lines++;
+
+  // The text with each '\n' turned into a NUL, plus the final NUL, always fits.
+  char **table = (char **)PICK_MALLOC(sizeof(char *) * (size_t)lines + len + 1);
+  if (!table) return NULL;
+  char *bytes = (char *)(table + lines);
+  memcpy(bytes, text, len + 1);
+
+  int count = 0;
+  for (char *line = bytes; line;) {
+    char *nl = strchr(line, '\n');
+    if (nl) *nl = 0;
+    if (*line) table[count++] = line;
+    line = nl ? nl + 1 : NULL;
   }
+  if (!count) { PICK_FREE(table); return NULL; }
+  *out_count = count;
+  return table;
 }
+#endif
 
 #ifdef PICK_PLATFORM_MACOS
 
+#include <dispatch/dispatch.h>
 #include <objc/message.h>
 
 #ifndef nil
@@ -669,25 +1350,52 @@ static id pick__objc_url_from_path(const char *path, bool is_directory) {
       is_directory ? YES : NO);
 }
 
-static char *pick__objc_path_from_url(id url) {
+static const char *pick__objc_utf8_from_url(id url) {
   if (!url)
     return NULL;
   id path = ((id (*)(id, SEL))objc_msgSend)(url, sel_registerName("path"));
   if (!path)
     return NULL;
-  const char *utf8 = ((const char *(*)(id, SEL))objc_msgSend)(
+  return ((const char *(*)(id, SEL))objc_msgSend)(
       path, sel_registerName("UTF8String"));
+}
+
+static char *pick__objc_path_from_url(id url) {
+  const char *utf8 = pick__objc_utf8_from_url(url);
   if (!utf8)
     return NULL;
 
   size_t len = strlen(utf8);
-  char *result = (char *)malloc(len + 1);
+  char *result = (char *)PICK_MALLOC(len + 1);
   if (result) {
     memcpy(result, utf8, len + 1);
   }
   return result;
 }
 
+// Packs every URL in an NSArray into one pick_free_multiple() block. The
+// UTF8String buffers are autoreleased, so they outlive the copy.
+static char **pick__objc_paths_from_urls(id urls, int *out_count) {
+  *out_count = 0;
+  NSUInteger url_count =
+      ((NSUInteger (*)(id, SEL))objc_msgSend)(urls, sel_registerName("count"));
+  if (url_count == 0)
+    return NULL;
+
+  const char **utf8 =
+      (const char **)PICK_MALLOC(url_count * sizeof(const char *));
+  if (!utf8)
+    return NULL;
+  for (NSUInteger i = 0; i < url_count; i++) {
+    id url = ((id (*)(id, SEL, NSUInteger))objc_msgSend)(
+        urls, sel_registerName("objectAtIndex:"), i);
+    utf8[i] = pick__objc_utf8_from_url(url);
+  }
+  char **paths = pick__pack_paths(utf8, (int)url_count, out_count);
+  PICK_FREE(utf8);
+  return paths;
+}
+
 static id pick__objc_app_instance(void) {
   return ((id (*)(id, SEL))objc_msgSend)((id)objc_getClass("NSApplication"),
                                          sel_registerName("sharedApplication"));
@@ -844,12 +1552,134 @@ static id pick__objc_create_save_panel(const PickFileOptions *options) {
   return panel;
 }
 
+// Dialogs currently on screen, so pick_cancel() can find them by handle.
+// Only touched on the main thread.
+typedef struct pick__objc_pending {
+  struct pick__objc_pending *next;
+  PickRequest request;
+  id window;      ///< The panel, or the alert's window
+  id parent;      ///< Sheet parent, nil for free-standing dialogs
+  bool is_alert;
+} pick__objc_pending;
+
+static pick__objc_pending *pick__g_objc_pending;
+
 typedef struct {
+  pick__objc_pending pending;
   PickMessageCallback callback;
   void *user_data;
   PickMessageOptions options;
 } pick__message_context;
 
+typedef struct {
+  pick__objc_pending pending;
+  PickFileCallback single_callback;
+  PickMultiFileCallback multi_callback;
+  void *user_data;
+} pick__file_context;
+
+static void pick__objc_track(pick__objc_pending *pending, PickRequest request,
+                             id window, id parent, bool is_alert,
+                             unsigned timeout_ms) {
+  pending->request = request;
+  pending->window = window;
+  pending->parent = parent;
+  pending->is_alert = is_alert;
+  pending->next = pick__g_objc_pending;
+  pick__g_objc_pending = pending;
+
+  if (timeout_ms) {
+    dispatch_after(
+        dispatch_time(DISPATCH_TIME_NOW, (int64_t)timeout_ms * NSEC_PER_MSEC),
+        dispatch_get_main_queue(), ^{
+          pick_cancel(request);
+        });
+  }
+}
+
+static void pick__objc_untrack(pick__objc_pending *pending) {
+  for (pick__objc_pending **it = &pick__g_objc_pending; *it;
+       it = &(*it)->next) {
+    if (*it == pending) {
+      *it = pending->next;
+      pending->next = NULL;
+      return;
+    }
+  }
+}
+
+// Reports the request as cancelled, then dismisses its dialog. Dismissing
+// runs the completion handler, which finds no callbacks left and only
+// releases the context, so nothing here may touch it afterwards.
+static bool pick__objc_cancel(PickRequest request) {
+  pick__objc_pending *pending = pick__g_objc_pending;
+  while (pending && pending->request != request) {
+    pending = pending->next;
+  }
+  if (!pending) {
+    return false;
+  }
+
+  pick__objc_untrack(pending);
+  pending->request = PICK_REQUEST_NONE;
+  id window = pending->window;
+  id parent = pending->parent;
+
+  if (pending->is_alert) {
+    pick__message_context *ctx = (pick__message_context *)pending;
+    PickMessageCallback callback = ctx->callback;
+    ctx->callback = NULL;
+    if (callback) {
+      callback(PICK_RESULT_CLOSED, ctx->user_data);
+    }
+    if (parent) {
+      ((void (*)(id, SEL, id, NSInteger))objc_msgSend)(
+          parent, sel_registerName("endSheet:returnCode:"), window,
+          NSModalResponseCancel);
+    } else {
+      id app = ((id (*)(id, SEL))objc_msgSend)(
+          (id)objc_getClass("NSApplication"),
+          sel_registerName("sharedApplication"));
+      id modal = ((id (*)(id, SEL))objc_msgSend)(
+          app, sel_registerName("modalWindow"));
+      if (modal == window) {
+        ((void (*)(id, SEL, NSInteger))objc_msgSend)(
+            app, sel_registerName("stopModalWithCode:"),
+            NSModalResponseCancel);
+      }
+    }
+  } else {
+    pick__file_context *ctx = (pick__file_context *)pending;
+    PickFileCallback single = ctx->single_callback;
+    PickMultiFileCallback multi = ctx->multi_callback;
+    ctx->single_callback = NULL;
+    ctx->multi_callback = NULL;
+    if (single) {
+      single(NULL, ctx->user_data);
+    }
+    if (multi) {
+      multi(NULL, 0, ctx->user_data);
+    }
+    ((void (*)(id, SEL, id))objc_msgSend)(window, sel_registerName("cancel:"),
+                                          nil);
+  }
+  return true;
+}
+
+bool pick__cancel_impl(PickRequest request) {
+  BOOL is_main = ((BOOL (*)(id, SEL))objc_msgSend)(
+      (id)objc_getClass("NSThread"), sel_registerName("isMainThread"));
+
+  if (is_main) {
+    return pick__objc_cancel(request);
+  }
+  __block bool found = false;
+  dispatch_sync(dispatch_get_main_queue(), ^{
+    found = pick__objc_cancel(request);
+  });
+  return found;
+}
+
 static NSInteger pick__objc_alert_style(PickMessageStyle style) {
   switch (style) {
   case PICK_STYLE_ERROR:
@@ -1057,14 +1887,10 @@ static id pick__objc_create_alert(const PickMessageOptions *options) {
   return alert;
 }
 
-typedef struct {
-  PickFileCallback single_callback;
-  PickMultiFileCallback multi_callback;
-  void *user_data;
-} pick__file_context;
-
-void pick__file_impl(const PickFileOptions *options, PickFileCallback callback,
-               void *user_data) {
+PickRequest pick__file_impl(const PickFileOptions *options, PickFileCallback callback,
+                           void *user_data) {
+  PickRequest request = pick__next_request();
+  unsigned timeout_ms = options ? options->timeout_ms : 0;
   pick__objc_run_on_main(^{
     pick__objc_ensure_app_initialized();
 
@@ -1073,12 +1899,15 @@ void pick__file_impl(const PickFileOptions *options, PickFileCallback callback,
         pick__objc_window_from_handle(options ? options->parent_handle : NULL);
 
     pick__file_context *ctx =
-        (pick__file_context *)malloc(sizeof(pick__file_context));
+        (pick__file_context *)PICK_MALLOC(sizeof(pick__file_context));
     ctx->single_callback = callback;
     ctx->multi_callback = NULL;
     ctx->user_data = user_data;
+    pick__objc_track(&ctx->pending, request, panel, parent_window, false,
+                     timeout_ms);
 
     void (^completion_handler)(NSInteger) = ^(NSInteger response) {
+      pick__objc_untrack(&ctx->pending);
       char *path = NULL;
       if (response == NSModalResponseOK) {
         id url =
@@ -1088,8 +1917,8 @@ void pick__file_impl(const PickFileOptions *options, PickFileCallback callback,
       if (ctx->single_callback) {
         ctx->single_callback(path, ctx->user_data);
       }
-      free(path);
-      free(ctx);
+      PICK_FREE(path);
+      PICK_FREE(ctx);
     };
 
     if (parent_window) {
@@ -1103,10 +1932,13 @@ void pick__file_impl(const PickFileOptions *options, PickFileCallback callback,
           (id)completion_handler);
     }
   });
+  return request;
 }
 
-void pick__files_impl(const PickFileOptions *options, PickMultiFileCallback callback,
-                void *user_data) {
+PickRequest pick__files_impl(const PickFileOptions *options, PickMultiFileCallback callback,
+                            void *user_data) {
+  PickRequest request = pick__next_request();
+  unsigned timeout_ms = options ? options->timeout_ms : 0;
   pick__objc_run_on_main(^{
     pick__objc_ensure_app_initialized();
 
@@ -1118,34 +1950,22 @@ void pick__files_impl(const PickFileOptions *options, PickMultiFileCallback call
         pick__objc_window_from_handle(options ? options->parent_handle : NULL);
 
     pick__file_context *ctx =
-        (pick__file_context *)malloc(sizeof(pick__file_context));
+        (pick__file_context *)PICK_MALLOC(sizeof(pick__file_context));
     ctx->single_callback = NULL;
     ctx->multi_callback = callback;
     ctx->user_data = user_data;
+    pick__objc_track(&ctx->pending, request, panel, parent_window, false,
+                     timeout_ms);
 
     void (^completion_handler)(NSInteger) = ^(NSInteger response) {
+      pick__objc_untrack(&ctx->pending);
       char **paths = NULL;
       int count = 0;
 
       if (response == NSModalResponseOK) {
         id urls =
             ((id (*)(id, SEL))objc_msgSend)(panel, sel_registerName("URLs"));
-        NSUInteger url_count = ((NSUInteger (*)(id, SEL))objc_msgSend)(
-            urls, sel_registerName("count"));
-
-        if (url_count > 0) {
-          paths = (char **)calloc(url_count, sizeof(char *));
-          if (paths) {
-            for (NSUInteger i = 0; i < url_count; i++) {
-              id url = ((id (*)(id, SEL, NSUInteger))objc_msgSend)(
-                  urls, sel_registerName("objectAtIndex:"), i);
-              char *path = pick__objc_path_from_url(url);
-              if (path) {
-                paths[count++] = path;
-              }
-            }
-          }
-        }
+        paths = pick__objc_paths_from_urls(urls, &count);
       }
 
       if (ctx->multi_callback) {
@@ -1153,7 +1973,7 @@ void pick__files_impl(const PickFileOptions *options, PickMultiFileCallback call
       }
 
       pick_free_multiple(paths, count);
-      free(ctx);
+      PICK_FREE(ctx);
     };
 
     if (parent_window) {
@@ -1167,10 +1987,13 @@ void pick__files_impl(const PickFileOptions *options, PickMultiFileCallback call
           (id)completion_handler);
     }
   });
+  return request;
 }
 
-void pick__folder_impl(const PickFileOptions *options, PickFileCallback callback,
-                 void *user_data) {
+PickRequest pick__folder_impl(const PickFileOptions *options, PickFileCallback callback,
+                             void *user_data) {
+  PickRequest request = pick__next_request();
+  unsigned timeout_ms = options ? options->timeout_ms : 0;
   pick__objc_run_on_main(^{
     pick__objc_ensure_app_initialized();
 
@@ -1179,12 +2002,15 @@ void pick__folder_impl(const PickFileOptions *options, PickFileCallback callback
         pick__objc_window_from_handle(options ? options->parent_handle : NULL);
 
     pick__file_context *ctx =
-        (pick__file_context *)malloc(sizeof(pick__file_context));
+        (pick__file_context *)PICK_MALLOC(sizeof(pick__file_context));
     ctx->single_callback = callback;
     ctx->multi_callback = NULL;
     ctx->user_data = user_data;
+    pick__objc_track(&ctx->pending, request, panel, parent_window, false,
+                     timeout_ms);
 
     void (^completion_handler)(NSInteger) = ^(NSInteger response) {
+      pick__objc_untrack(&ctx->pending);
       char *path = NULL;
       if (response == NSModalResponseOK) {
         id url =
@@ -1194,8 +2020,8 @@ void pick__folder_impl(const PickFileOptions *options, PickFileCallback callback
       if (ctx->single_callback) {
         ctx->single_callback(path, ctx->user_data);
       }
-      free(path);
-      free(ctx);
+      PICK_FREE(path);
+      PICK_FREE(ctx);
     };
 
     if (parent_window) {
@@ -1209,10 +2035,13 @@ void pick__folder_impl(const PickFileOptions *options, PickFileCallback callback
           (id)completion_handler);
     }
   });
+  return request;
 }
 
-void pick__folders_impl(const PickFileOptions *options,
-                  PickMultiFileCallback callback, void *user_data) {
+PickRequest pick__folders_impl(const PickFileOptions *options,
+                              PickMultiFileCallback callback, void *user_data) {
+  PickRequest request = pick__next_request();
+  unsigned timeout_ms = options ? options->timeout_ms : 0;
   pick__objc_run_on_main(^{
     pick__objc_ensure_app_initialized();
 
@@ -1224,34 +2053,22 @@ void pick__folders_impl(const PickFileOptions *options,
         pick__objc_window_from_handle(options ? options->parent_handle : NULL);
 
     pick__file_context *ctx =
-        (pick__file_context *)malloc(sizeof(pick__file_context));
+        (pick__file_context *)PICK_MALLOC(sizeof(pick__file_context));
     ctx->single_callback = NULL;
     ctx->multi_callback = callback;
     ctx->user_data = user_data;
+    pick__objc_track(&ctx->pending, request, panel, parent_window, false,
+                     timeout_ms);
 
     void (^completion_handler)(NSInteger) = ^(NSInteger response) {
+      pick__objc_untrack(&ctx->pending);
       char **paths = NULL;
       int count = 0;
 
       if (response == NSModalResponseOK) {
         id urls =
             ((id (*)(id, SEL))objc_msgSend)(panel, sel_registerName("URLs"));
-        NSUInteger url_count = ((NSUInteger (*)(id, SEL))objc_msgSend)(
-            urls, sel_registerName("count"));
-
-        if (url_count > 0) {
-          paths = (char **)calloc(url_count, sizeof(char *));
-          if (paths) {
-            for (NSUInteger i = 0; i < url_count; i++) {
-              id url = ((id (*)(id, SEL, NSUInteger))objc_msgSend)(
-                  urls, sel_registerName("objectAtIndex:"), i);
-              char *path = pick__objc_path_from_url(url);
-              if (path) {
-                paths[count++] = path;
-              }
-            }
-          }
-        }
+        paths = pick__objc_paths_from_urls(urls, &count);
       }
 
       if (ctx->multi_callback) {
@@ -1259,7 +2076,7 @@ void pick__folders_impl(const PickFileOptions *options,
       }
 
       pick_free_multiple(paths, count);
-      free(ctx);
+      PICK_FREE(ctx);
     };
 
     if (parent_window) {
@@ -1273,10 +2090,13 @@ void pick__folders_impl(const PickFileOptions *options,
           (id)completion_handler);
     }
   });
+  return request;
 }
 
-void pick__save_impl(const PickFileOptions *options, PickFileCallback callback,
-               void *user_data) {
+PickRequest pick__save_impl(const PickFileOptions *options, PickFileCallback callback,
+                           void *user_data) {
+  PickRequest request = pick__next_request();
+  unsigned timeout_ms = options ? options->timeout_ms : 0;
   pick__objc_run_on_main(^{
     pick__objc_ensure_app_initialized();
 
@@ -1285,12 +2105,15 @@ void pick__save_impl(const PickFileOptions *options, PickFileCallback callback,
         pick__objc_window_from_handle(options ? options->parent_handle : NULL);
 
     pick__file_context *ctx =
-        (pick__file_context *)malloc(sizeof(pick__file_context));
+        (pick__file_context *)PICK_MALLOC(sizeof(pick__file_context));
     ctx->single_callback = callback;
     ctx->multi_callback = NULL;
     ctx->user_data = user_data;
+    pick__objc_track(&ctx->pending, request, panel, parent_window, false,
+                     timeout_ms);
 
     void (^completion_handler)(NSInteger) = ^(NSInteger response) {
+      pick__objc_untrack(&ctx->pending);
       char *path = NULL;
       if (response == NSModalResponseOK) {
         id url =
@@ -1300,8 +2123,8 @@ void pick__save_impl(const PickFileOptions *options, PickFileCallback callback,
       if (ctx->single_callback) {
         ctx->single_callback(path, ctx->user_data);
       }
-      free(path);
-      free(ctx);
+      PICK_FREE(path);
+      PICK_FREE(ctx);
     };
 
     if (parent_window) {
@@ -1315,14 +2138,17 @@ void pick__save_impl(const PickFileOptions *options, PickFileCallback callback,
           (id)completion_handler);
     }
   });
+  return request;
 }
 
-void pick__message_impl(const PickMessageOptions *options,
-                  PickMessageCallback callback, void *user_data) {
+PickRequest pick__message_impl(const PickMessageOptions *options,
+                              PickMessageCallback callback, void *user_data) {
+  PickRequest request = pick__next_request();
+  unsigned timeout_ms = options ? options->timeout_ms : 0;
   pick__objc_run_on_main(^{
     pick__objc_ensure_app_initialized();
     pick__message_context *ctx =
-        (pick__message_context *)malloc(sizeof(pick__message_context));
+        (pick__message_context *)PICK_MALLOC(sizeof(pick__message_context));
     ctx->callback = callback;
     ctx->user_data = user_data;
     if (options) {
@@ -1334,13 +2160,18 @@ void pick__message_impl(const PickMessageOptions *options,
     }
     id alert = pick__objc_create_alert(&ctx->options);
     id parent_window = pick__objc_window_from_handle(ctx->options.parent_handle);
+    id alert_window =
+        ((id (*)(id, SEL))objc_msgSend)(alert, sel_registerName("window"));
+    pick__objc_track(&ctx->pending, request, alert_window, parent_window, true,
+                     timeout_ms);
     void (^completion_handler)(NSInteger) = ^(NSInteger response) {
+      pick__objc_untrack(&ctx->pending);
       PickButtonResult result =
           pick__objc_button_result(response, ctx->options.buttons);
       if (ctx->callback) {
         ctx->callback(result, ctx->user_data);
       }
-      free(ctx);
+      PICK_FREE(ctx);
     };
     if (parent_window) {
       ((void (*)(id, SEL, id, id))objc_msgSend)(
@@ -1349,12 +2180,18 @@ void pick__message_impl(const PickMessageOptions *options,
           parent_window, (id)completion_handler);
     } else {
       dispatch_async(dispatch_get_main_queue(), ^{
+        // Cancelled before the modal loop started.
+        if (ctx->pending.request == PICK_REQUEST_NONE) {
+          completion_handler(NSModalResponseCancel);
+          return;
+        }
         NSInteger response = ((NSInteger (*)(id, SEL))objc_msgSend)(
             alert, sel_registerName("runModal"));
         completion_handler(response);
       });
     }
   });
+  return request;
 }
 
 #endif
@@ -1363,25 +2200,34 @@ void pick__message_impl(const PickMessageOptions *options,
 #error "Windows implementation not yet available"
 #endif
 
-#ifdef PICK_PLATFORM_LINUX
-#error "Linux implementation not yet available"
-#endif
-
-#ifdef PICK_PLATFORM_EMSCRIPTEN
+#if defined(PICK_PLATFORM_LINUX) && defined(PICK_LINUX_GTK)
 
-#include <emscripten/emscripten.h>
+#include <dlfcn.h>
+#include <stdio.h>
 
-#ifndef PICK_EM_MAX_REQUESTS
-#define PICK_EM_MAX_REQUESTS 64
+#ifndef PICK_GTK_LIBRARIES
+#define PICK_GTK_LIBRARIES "libgtk-3.so.0", "libgtk-4.so.1"
 #endif
 
-#ifndef PICK_EM_BASE_PICKED
-#define PICK_EM_BASE_PICKED "/picked"
-#endif
+enum {
+  PICK_GTK_RESPONSE_DELETE_EVENT = -4,
+  PICK_GTK_RESPONSE_ACCEPT       = -3,
+  PICK_GTK_RESPONSE_OK           = -5,
+  PICK_GTK_RESPONSE_CANCEL       = -6,
+  PICK_GTK_RESPONSE_CLOSE        = -7,
+  PICK_GTK_RESPONSE_YES          = -8,
+  PICK_GTK_RESPONSE_NO           = -9
+};
 
-#ifndef PICK_EM_BASE_SAVED
-#define PICK_EM_BASE_SAVED "/saved"
-#endif
+enum {
+  PICK_GTK_ACTION_OPEN          = 0,
+  PICK_GTK_ACTION_SAVE          = 1,
+  PICK_GTK_ACTION_SELECT_FOLDER = 2
+};
+
+enum { PICK_GTK_DIALOG_MODAL = 1, PICK_GTK_DIALOG_DESTROY_WITH_PARENT = 2 };
+enum { PICK_GTK_MESSAGE_INFO = 0, PICK_GTK_MESSAGE_WARNING, PICK_GTK_MESSAGE_QUESTION, PICK_GTK_MESSAGE_ERROR };
+enum { PICK_GTK_BUTTONS_NONE = 0, PICK_GTK_BUTTONS_OK = 1, PICK_GTK_BUTTONS_YES_NO = 4, PICK_GTK_BUTTONS_OK_CANCEL = 5 };
 
 typedef enum {
   PICK_REQ_NONE = 0,
@@ -1390,83 +2236,2989 @@ typedef enum {
   PICK_REQ_OPEN_DIR_SINGLE,
   PICK_REQ_OPEN_DIR_MULTI,
   PICK_REQ_SAVE,
-  PICK_REQ_MESSAGE,
-  PICK_REQ_EXPORT
+  PICK_REQ_MESSAGE
 } pick__req_kind_t;
 
-typedef void (*PickResultCallback)(bool ok, void* user_data);
+typedef struct pick__gslist_t { void* data; struct pick__gslist_t* next; } pick__gslist_t;
 
+/// Everything the backend needs from GTK and its GLib stack, resolved on first use.
 typedef struct {
-  pick__req_kind_t       kind;
+  int   version;  ///< 3 or 4 once loaded, -1 if loading failed
+  void* lib;
+
+  void          (*g_free)(void*);
+  void          (*g_object_unref)(void*);
+  unsigned long (*g_signal_connect_data)(void*, const char*, void (*)(void), void*, void*, int);
+  void          (*g_signal_handler_disconnect)(void*, unsigned long);
+  int           (*g_main_context_iteration)(void*, int);
+  void          (*g_slist_free)(pick__gslist_t*);
+  void*         (*g_file_new_for_path)(const char*);
+  char*         (*g_file_get_path)(void*);
+  unsigned      (*g_list_model_get_n_items)(void*);
+  void*         (*g_list_model_get_item)(void*, unsigned);
+
+  int   (*gtk_init_check3)(int*, char***);
+  int   (*gtk_init_check4)(void);
+  void* (*gtk_file_chooser_native_new)(const char*, void*, int, const char*, const char*);
+  void  (*gtk_native_dialog_set_modal)(void*, int);
+  void  (*gtk_native_dialog_show)(void*);
+  void  (*gtk_native_dialog_hide)(void*);
+  void  (*gtk_file_chooser_set_select_multiple)(void*, int);
+  void  (*gtk_file_chooser_set_create_folders)(void*, int);
+  void  (*gtk_file_chooser_set_current_name)(void*, const char*);
+  void  (*gtk_file_chooser_set_current_folder3)(void*, const char*);
+  int   (*gtk_file_chooser_set_current_folder4)(void*, void*, void**);
+  void  (*gtk_file_chooser_add_filter)(void*, void*);
+  void* (*gtk_file_chooser_get_file)(void*);
+  void* (*gtk_file_chooser_get_files)(void*);
+  void* (*gtk_file_filter_new)(void);
+  void  (*gtk_file_filter_set_name)(void*, const char*);
+  void  (*gtk_file_filter_add_pattern)(void*, const char*);
+  void* (*gtk_message_dialog_new)(void*, int, int, int, const char*, ...);
+  void  (*gtk_message_dialog_format_secondary_text)(void*, const char*, ...);
+  void* (*gtk_dialog_add_button)(void*, const char*, int);
+  void  (*gtk_window_set_title)(void*, const char*);
+  void  (*gtk_window_present)(void*);
+  void  (*gtk_window_destroy)(void*);  ///< gtk_widget_destroy on GTK 3
+} pick__gtk_api_t;
+
+static pick__gtk_api_t pick__g_gtk;
+
+typedef struct pick__gtk_req_t {
+  struct pick__gtk_req_t* next;
+  PickRequest           id;
+  pick__req_kind_t      kind;
   PickFileCallback      single_cb;
   PickMultiFileCallback multi_cb;
   PickMessageCallback   msg_cb;
-  PickResultCallback    result_cb;
   void*                 user;
   PickButtonType        button_type;
-} pick__em_req_t;
-
-static pick__em_req_t pick__g_reqs[PICK_EM_MAX_REQUESTS];
-static int pick__g_next_req_id = 1;
-
-static int pick__alloc_req(void) {
-  for (int tries = 0; tries < PICK_EM_MAX_REQUESTS; tries++) {
-    int id = pick__g_next_req_id++;
-    if (pick__g_next_req_id <= 0) pick__g_next_req_id = 1;
-    if (id <= 0 || id >= PICK_EM_MAX_REQUESTS) { id = 1; pick__g_next_req_id = 2; }
-    if (pick__g_reqs[id].kind == PICK_REQ_NONE) return id;
+  void*                 dialog;       ///< GtkFileChooserNative or GtkMessageDialog
+  unsigned long         handler;      ///< "response" signal handler id
+  double                deadline_ms;  ///< pick_poll() cancels the dialog after this, 0 = never
+} pick__gtk_req_t;
+
+static pick__gtk_req_t* pick__g_gtk_reqs;
+
+static bool pick__gtk_resolve(void* lib, int version) {
+  pick__gtk_api_t* g = &pick__g_gtk;
+#define PICK_GTK_SYM(field, name) \
+  if (!(*(void**)&g->field = dlsym(lib, name))) { fprintf(stderr, "pick: missing GTK symbol %s\n", name); return false; }
+
+  PICK_GTK_SYM(g_free,                                   "g_free");
+  PICK_GTK_SYM(g_object_unref,                           "g_object_unref");
+  PICK_GTK_SYM(g_signal_connect_data,                    "g_signal_connect_data");
+  PICK_GTK_SYM(g_signal_handler_disconnect,              "g_signal_handler_disconnect");
+  PICK_GTK_SYM(g_main_context_iteration,                 "g_main_context_iteration");
+  PICK_GTK_SYM(g_slist_free,                             "g_slist_free");
+  PICK_GTK_SYM(g_file_new_for_path,                      "g_file_new_for_path");
+  PICK_GTK_SYM(g_file_get_path,                          "g_file_get_path");
+  PICK_GTK_SYM(gtk_file_chooser_native_new,              "gtk_file_chooser_native_new");
+  PICK_GTK_SYM(gtk_native_dialog_set_modal,              "gtk_native_dialog_set_modal");
+  PICK_GTK_SYM(gtk_native_dialog_show,                   "gtk_native_dialog_show");
+  PICK_GTK_SYM(gtk_native_dialog_hide,                   "gtk_native_dialog_hide");
+  PICK_GTK_SYM(gtk_file_chooser_set_select_multiple,     "gtk_file_chooser_set_select_multiple");
+  PICK_GTK_SYM(gtk_file_chooser_set_create_folders,      "gtk_file_chooser_set_create_folders");
+  PICK_GTK_SYM(gtk_file_chooser_set_current_name,        "gtk_file_chooser_set_current_name");
+  PICK_GTK_SYM(gtk_file_chooser_add_filter,              "gtk_file_chooser_add_filter");
+  PICK_GTK_SYM(gtk_file_chooser_get_file,                "gtk_file_chooser_get_file");
+  PICK_GTK_SYM(gtk_file_chooser_get_files,               "gtk_file_chooser_get_files");
+  PICK_GTK_SYM(gtk_file_filter_new,                      "gtk_file_filter_new");
+  PICK_GTK_SYM(gtk_file_filter_set_name,                 "gtk_file_filter_set_name");
+  PICK_GTK_SYM(gtk_file_filter_add_pattern,              "gtk_file_filter_add_pattern");
+  PICK_GTK_SYM(gtk_message_dialog_new,                   "gtk_message_dialog_new");
+  PICK_GTK_SYM(gtk_message_dialog_format_secondary_text, "gtk_message_dialog_format_secondary_text");
+  PICK_GTK_SYM(gtk_dialog_add_button,                    "gtk_dialog_add_button");
+  PICK_GTK_SYM(gtk_window_set_title,                     "gtk_window_set_title");
+  PICK_GTK_SYM(gtk_window_present,                       "gtk_window_present");
+  if (version == 4) {
+    PICK_GTK_SYM(gtk_init_check4,                        "gtk_init_check");
+    PICK_GTK_SYM(gtk_file_chooser_set_current_folder4,   "gtk_file_chooser_set_current_folder");
+    PICK_GTK_SYM(gtk_window_destroy,                     "gtk_window_destroy");
+    PICK_GTK_SYM(g_list_model_get_n_items,               "g_list_model_get_n_items");
+    PICK_GTK_SYM(g_list_model_get_item,                  "g_list_model_get_item");
+  } else {
+    PICK_GTK_SYM(gtk_init_check3,                        "gtk_init_check");
+    PICK_GTK_SYM(gtk_file_chooser_set_current_folder3,   "gtk_file_chooser_set_current_folder");
+    PICK_GTK_SYM(gtk_window_destroy,                     "gtk_widget_destroy");
   }
-  return 0;
+
+#undef PICK_GTK_SYM
+  return true;
 }
-static void pick__clear_req(int id) { if (id > 0 && id < PICK_EM_MAX_REQUESTS) pick__g_reqs[id] = (pick__em_req_t){0}; }
+
+// Loads GTK the first time a dialog is requested. Processes that never show a
+// dialog never map the toolkit at all.
+static bool pick__gtk_load(void) {
+  if (pick__g_gtk.version > 0) return true;
+  if (pick__g_gtk.version < 0) return false;
+
+  static const char* const libs[] = { PICK_GTK_LIBRARIES };
+  for (size_t i = 0; i < sizeof(libs) / sizeof(libs[0]); i++) {
+    void* lib = dlopen(libs[i], RTLD_LAZY | RTLD_GLOBAL);
+    if (!lib) continue;
+
+    int version = strstr(libs[i], "gtk-4") ? 4 : 3;
+    memset(&pick__g_gtk, 0, sizeof(pick__g_gtk));
+    if (!pick__gtk_resolve(lib, version)) {
+      // Nothing ran yet, so this one can still make way for the next library.
+      dlclose(lib);
+      continue;
+    }
+
+    bool ok = (version == 4) ? pick__g_gtk.gtk_init_check4() != 0
+                             : pick__g_gtk.gtk_init_check3(NULL, NULL) != 0;
+    if (ok) {
+      pick__g_gtk.lib = lib;
+      pick__g_gtk.version = version;
+      return true;
+    }
+    // The library stays mapped: GTK cannot be unloaded once it has been touched,
+    // and GTK 4 aborts in a process that has GTK 2/3 symbols, so stop here.
+    fprintf(stderr, "pick: %s failed to initialize (no display?)\n", libs[i]);
+    memset(&pick__g_gtk, 0, sizeof(pick__g_gtk));
+    pick__g_gtk.version = -1;
+    return false;
+  }
+
+  memset(&pick__g_gtk, 0, sizeof(pick__g_gtk));
+  pick__g_gtk.version = -1;
+  fprintf(stderr, "pick: no usable GTK library found\n");
+  return false;
+}
+
+static void pick__gtk_deliver(pick__gtk_req_t* req, char** paths, int count) {
+  switch (req->kind) {
+    case PICK_REQ_OPEN_SINGLE:
+    case PICK_REQ_OPEN_DIR_SINGLE:
+    case PICK_REQ_SAVE:
+      if (req->single_cb) req->single_cb(count > 0 ? paths[0] : NULL, req->user);
+      break;
+    case PICK_REQ_OPEN_MULTI:
+    case PICK_REQ_OPEN_DIR_MULTI:
+      if (req->multi_cb) req->multi_cb(count > 0 ? (const char**)paths : NULL, count, req->user);
+      break;
+    case PICK_REQ_MESSAGE:
+      if (req->msg_cb) req->msg_cb(PICK_RESULT_CLOSED, req->user);
+      break;
+    default: break;
+  }
+}
+
+static void pick__gtk_unlink(pick__gtk_req_t* req) {
+  for (pick__gtk_req_t** it = &pick__g_gtk_reqs; *it; it = &(*it)->next) {
+    if (*it == req) { *it = req->next; req->next = NULL; return; }
+  }
+}
+
+static char* pick__gtk_file_gpath(void* file) {
+  return file ? pick__g_gtk.g_file_get_path(file) : NULL;
+}
+
+// Gathers the chooser's g_file_get_path() strings, then packs them into one
+// block so pick_free_multiple() can own the result.
+static int pick__gtk_collect(void* chooser, bool multi, char*** out_paths) {
+  pick__gtk_api_t* g = &pick__g_gtk;
+  *out_paths = NULL;
+
+  unsigned total = 0;
+  char** gpaths = NULL;
+  if (!multi) {
+    void* file = g->gtk_file_chooser_get_file(chooser);
+    char* gpath = pick__gtk_file_gpath(file);
+    if (file) g->g_object_unref(file);
+    if (!gpath) return 0;
+    int count = 0;
+    *out_paths = pick__pack_paths((const char* const*)&gpath, 1, &count);
+    g->g_free(gpath);
+    return count;
+  }
+
+  if (g->version == 4) {
+    void* model = g->gtk_file_chooser_get_files(chooser);
+    total = model ? g->g_list_model_get_n_items(model) : 0;
+    gpaths = total ? (char**)PICK_CALLOC(total, sizeof(char*)) : NULL;
+    for (unsigned i = 0; gpaths && i < total; i++) {
+      void* file = g->g_list_model_get_item(model, i);
+      gpaths[i] = pick__gtk_file_gpath(file);
+      if (file) g->g_object_unref(file);
+    }
+    if (model) g->g_object_unref(model);
+  } else {
+    pick__gslist_t* list = (pick__gslist_t*)g->gtk_file_chooser_get_files(chooser);
+    for (pick__gslist_t* it = list; it; it = it->next) total++;
+    gpaths = total ? (char**)PICK_CALLOC(total, sizeof(char*)) : NULL;
+    unsigned i = 0;
+    for (pick__gslist_t* it = list; it; it = it->next, i++) {
+      if (gpaths) gpaths[i] = pick__gtk_file_gpath(it->data);
+      g->g_object_unref(it->data);
+    }
+    if (list) g->g_slist_free(list);
+  }
+  if (!gpaths) return 0;
+
+  int count = 0;
+  *out_paths = pick__pack_paths((const char* const*)gpaths, (int)total, &count);
+  for (unsigned i = 0; i < total; i++) g->g_free(gpaths[i]);
+  PICK_FREE(gpaths);
+  return count;
+}
+
+static void pick__gtk_on_file_response(void* native, int response, void* data) {
+  pick__gtk_req_t* req = (pick__gtk_req_t*)data;
+  char** paths = NULL;
+  int count = 0;
+  if (response == PICK_GTK_RESPONSE_ACCEPT) {
+    count = pick__gtk_collect(native, req->kind == PICK_REQ_OPEN_MULTI || req->kind == PICK_REQ_OPEN_DIR_MULTI, &paths);
+  }
+  pick__gtk_unlink(req);
+  pick__gtk_deliver(req, paths, count);
+  pick_free_multiple(paths, count);
+  pick__g_gtk.g_object_unref(native);
+  PICK_FREE(req);
+}
+
+static PickRequest pick__gtk_file_chooser(pick__req_kind_t kind, const PickFileOptions* opts,
+                                          PickFileCallback single_cb, PickMultiFileCallback multi_cb, void* ud) {
+  pick__gtk_req_t* req = (pick__gtk_req_t*)PICK_CALLOC(1, sizeof(pick__gtk_req_t));
+  if (!req) { if (single_cb) single_cb(NULL, ud); if (multi_cb) multi_cb(NULL, 0, ud); return PICK_REQUEST_NONE; }
+  *req = (pick__gtk_req_t){ .kind = kind, .single_cb = single_cb, .multi_cb = multi_cb, .user = ud };
+
+  if (!pick__gtk_load()) { pick__gtk_deliver(req, NULL, 0); PICK_FREE(req); return PICK_REQUEST_NONE; }
+  pick__gtk_api_t* g = &pick__g_gtk;
+
+  bool is_dir = kind == PICK_REQ_OPEN_DIR_SINGLE || kind == PICK_REQ_OPEN_DIR_MULTI;
+  int action  = kind == PICK_REQ_SAVE ? PICK_GTK_ACTION_SAVE : is_dir ? PICK_GTK_ACTION_SELECT_FOLDER : PICK_GTK_ACTION_OPEN;
+  const char* title = (opts && opts->title) ? opts->title
+                    : kind == PICK_REQ_SAVE ? "Save File"
+                    : is_dir ? "Open Folder" : "Open File";
+  void* parent = opts ? (void*)opts->parent_handle : NULL;
+
+  void* native = g->gtk_file_chooser_native_new(title, parent, action, NULL, NULL);
+  if (!native) { pick__gtk_deliver(req, NULL, 0); PICK_FREE(req); return PICK_REQUEST_NONE; }
+
+  if (parent) g->gtk_native_dialog_set_modal(native, 1);
+  if (kind == PICK_REQ_OPEN_MULTI || kind == PICK_REQ_OPEN_DIR_MULTI) g->gtk_file_chooser_set_select_multiple(native, 1);
+  if (kind == PICK_REQ_SAVE) {
+    g->gtk_file_chooser_set_create_folders(native, (opts && opts->can_create_dirs) ? 1 : 0);
+    if (opts && opts->default_name) g->gtk_file_chooser_set_current_name(native, opts->default_name);
+  }
+
+  if (opts && opts->default_path && *opts->default_path) {
+    if (g->version == 4) {
+      void* folder = g->g_file_new_for_path(opts->default_path);
+      if (folder) { g->gtk_file_chooser_set_current_folder4(native, folder, NULL); g->g_object_unref(folder); }
+    } else {
+      g->gtk_file_chooser_set_current_folder3(native, opts->default_path);
+    }
+  }
+
+  if (!is_dir && opts && opts->filters) {
+    for (int i = 0; i < opts->filter_count; i++) {
+      const PickFilter* f = &opts->filters[i];
+      void* filter = g->gtk_file_filter_new();
+      if (!filter) continue;
+      g->gtk_file_filter_set_name(filter, (f->name && *f->name) ? f->name : "Files");
+      for (int j = 0; j < f->extension_count; j++) {
+        const char* ext = f->extensions[j];
+        if (!ext || !*ext) continue;
+        char pattern[128];
+        snprintf(pattern, sizeof(pattern), "*.%s", ext);
+        g->gtk_file_filter_add_pattern(filter, pattern);
+      }
+      g->gtk_file_chooser_add_filter(native, filter);
+      // GTK3 filters are floating and the chooser sinks them; GTK4 ones are
+      // not, and the chooser's list store takes a reference of its own.
+      if (g->version == 4) g->g_object_unref(filter);
+    }
+  }
+
+  req->id = pick__next_request();
+  req->dialog = native;
+  req->deadline_ms = pick__deadline_ms(opts ? opts->timeout_ms : 0);
+  req->handler = g->g_signal_connect_data(native, "response", (void (*)(void))pick__gtk_on_file_response, req, NULL, 0);
+  req->next = pick__g_gtk_reqs;
+  pick__g_gtk_reqs = req;
+  g->gtk_native_dialog_show(native);
+  return req->id;
+}
+
+static void pick__gtk_on_message_response(void* dialog, int response, void* data) {
+  pick__gtk_req_t* req = (pick__gtk_req_t*)data;
+  if (req->msg_cb) {
+    PickButtonResult result = PICK_RESULT_CLOSED;
+    switch (response) {
+      case PICK_GTK_RESPONSE_OK:     result = PICK_RESULT_OK;     break;
+      case PICK_GTK_RESPONSE_CANCEL: result = PICK_RESULT_CANCEL; break;
+      case PICK_GTK_RESPONSE_YES:    result = PICK_RESULT_YES;    break;
+      case PICK_GTK_RESPONSE_NO:     result = PICK_RESULT_NO;     break;
+      default:                       result = PICK_RESULT_CLOSED; break;
+    }
+    req->msg_cb(result, req->user);
+  }
+  pick__gtk_unlink(req);
+  pick__g_gtk.gtk_window_destroy(dialog);
+  PICK_FREE(req);
+}
+
+// Tears the dialog down without emitting "response", then reports it as cancelled.
+static void pick__gtk_cancel(pick__gtk_req_t* req) {
+  pick__gtk_api_t* g = &pick__g_gtk;
+  pick__gtk_unlink(req);
+  g->g_signal_handler_disconnect(req->dialog, req->handler);
+  if (req->kind == PICK_REQ_MESSAGE) {
+    g->gtk_window_destroy(req->dialog);
+  } else {
+    g->gtk_native_dialog_hide(req->dialog);
+    g->g_object_unref(req->dialog);
+  }
+  pick__gtk_deliver(req, NULL, 0);
+  PICK_FREE(req);
+}
+
+PickRequest pick__file_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__gtk_file_chooser(PICK_REQ_OPEN_SINGLE, options, cb, NULL, ud);
+}
+
+PickRequest pick__files_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  return pick__gtk_file_chooser(PICK_REQ_OPEN_MULTI, options, NULL, cb, ud);
+}
+
+PickRequest pick__folder_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__gtk_file_chooser(PICK_REQ_OPEN_DIR_SINGLE, options, cb, NULL, ud);
+}
+
+PickRequest pick__folders_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  return pick__gtk_file_chooser(PICK_REQ_OPEN_DIR_MULTI, options, NULL, cb, ud);
+}
+
+PickRequest pick__save_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__gtk_file_chooser(PICK_REQ_SAVE, options, cb, NULL, ud);
+}
+
+PickRequest pick__message_impl(const PickMessageOptions *opts, PickMessageCallback cb, void *ud) {
+  if (!pick__gtk_load()) { if (cb) cb(PICK_RESULT_CLOSED, ud); return PICK_REQUEST_NONE; }
+  pick__gtk_api_t* g = &pick__g_gtk;
+
+  pick__gtk_req_t* req = (pick__gtk_req_t*)PICK_CALLOC(1, sizeof(pick__gtk_req_t));
+  if (!req) { if (cb) cb(PICK_RESULT_CLOSED, ud); return PICK_REQUEST_NONE; }
+  PickButtonType btns = opts ? opts->buttons : PICK_BUTTON_OK;
+  *req = (pick__gtk_req_t){ .kind = PICK_REQ_MESSAGE, .msg_cb = cb, .user = ud, .button_type = btns };
+
+  int type = PICK_GTK_MESSAGE_INFO;
+  switch (opts ? opts->style : PICK_STYLE_INFO) {
+    case PICK_STYLE_WARNING:  type = PICK_GTK_MESSAGE_WARNING;  break;
+    case PICK_STYLE_ERROR:    type = PICK_GTK_MESSAGE_ERROR;    break;
+    case PICK_STYLE_QUESTION: type = PICK_GTK_MESSAGE_QUESTION; break;
+    default:                  type = PICK_GTK_MESSAGE_INFO;     break;
+  }
+
+  int buttons = PICK_GTK_BUTTONS_OK;
+  switch (btns) {
+    case PICK_BUTTON_OK:            buttons = PICK_GTK_BUTTONS_OK;        break;
+    case PICK_BUTTON_OK_CANCEL:     buttons = PICK_GTK_BUTTONS_OK_CANCEL; break;
+    case PICK_BUTTON_YES_NO:        buttons = PICK_GTK_BUTTONS_YES_NO;    break;
+    case PICK_BUTTON_YES_NO_CANCEL: buttons = PICK_GTK_BUTTONS_NONE;      break;
+  }
+
+  void* parent = opts ? (void*)opts->parent_handle : NULL;
+  int flags = parent ? (PICK_GTK_DIALOG_MODAL | PICK_GTK_DIALOG_DESTROY_WITH_PARENT) : 0;
+  const char* message = (opts && opts->message) ? opts->message : "";
+
+  void* dialog = g->gtk_message_dialog_new(parent, flags, type, buttons, "%s", message);
+  if (!dialog) { PICK_FREE(req); if (cb) cb(PICK_RESULT_CLOSED, ud); return PICK_REQUEST_NONE; }
+
+  if (btns == PICK_BUTTON_YES_NO_CANCEL) {
+    g->gtk_dialog_add_button(dialog, "_Cancel", PICK_GTK_RESPONSE_CANCEL);
+    g->gtk_dialog_add_button(dialog, "_No", PICK_GTK_RESPONSE_NO);
+    g->gtk_dialog_add_button(dialog, "_Yes", PICK_GTK_RESPONSE_YES);
+  }
+  if (opts && opts->title) g->gtk_window_set_title(dialog, opts->title);
+  if (opts && opts->detail && *opts->detail) g->gtk_message_dialog_format_secondary_text(dialog, "%s", opts->detail);
+
+  req->id = pick__next_request();
+  req->dialog = dialog;
+  req->deadline_ms = pick__deadline_ms(opts ? opts->timeout_ms : 0);
+  req->handler = g->g_signal_connect_data(dialog, "response", (void (*)(void))pick__gtk_on_message_response, req, NULL, 0);
+  req->next = pick__g_gtk_reqs;
+  pick__g_gtk_reqs = req;
+  g->gtk_window_present(dialog);
+  return req->id;
+}
+
+bool pick__cancel_impl(PickRequest request) {
+  for (pick__gtk_req_t* r = pick__g_gtk_reqs; r; r = r->next) {
+    if (r->id == request) { pick__gtk_cancel(r); return true; }
+  }
+  return false;
+}
+
+void pick_poll(void) {
+  if (pick__g_gtk.version <= 0) return;
+  // Bounded so an always-ready idle source cannot stall the caller's frame.
+  for (int i = 0; i < 64 && pick__g_gtk.g_main_context_iteration(NULL, 0); i++) {}
+
+  // Restart after every expiry: the callback may have cancelled other requests.
+  double now = pick__now_ms();
+  for (pick__gtk_req_t* r = pick__g_gtk_reqs; r;) {
+    if (r->deadline_ms > 0 && now >= r->deadline_ms) { pick__gtk_cancel(r); r = pick__g_gtk_reqs; continue; }
+    r = r->next;
+  }
+}
+
+int pick_poll_fd(void) {
+  return -1;
+}
+
+#endif
+
+#if defined(PICK_PLATFORM_LINUX) && defined(PICK_LINUX_SUBPROCESS)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef PICK_SUBPROCESS_TOOLS
+#define PICK_SUBPROCESS_TOOLS "zenity", "kdialog"
+#endif
+
+// Without pidfd_open() (Linux < 5.3), how soon after a helper closes stdout
+// the timer wakes pick_poll_fd() to try reaping it again.
+#define PICK_PROC_REAP_RETRY_MS 20
+
+extern char** environ;
+
+typedef enum {
+  PICK_REQ_NONE = 0,
+  PICK_REQ_OPEN_SINGLE,
+  PICK_REQ_OPEN_MULTI,
+  PICK_REQ_OPEN_DIR_SINGLE,
+  PICK_REQ_OPEN_DIR_MULTI,
+  PICK_REQ_SAVE,
+  PICK_REQ_MESSAGE
+} pick__req_kind_t;
+
+typedef struct pick__proc_req_t {
+  struct pick__proc_req_t* next;
+  PickRequest           id;       ///< PICK_REQUEST_NONE once cancelled; the child is still reaped
+  pick__req_kind_t      kind;
+  PickFileCallback      single_cb;
+  PickMultiFileCallback multi_cb;
+  PickMessageCallback   msg_cb;
+  void*                 user;
+  PickButtonType        button_type;
+  pid_t                 pid;
+  int                   fd;       ///< Read end of the child's stdout, -1 after EOF
+  int                   pidfd;    ///< Readable once the child exits, -1 once reaped or if unsupported
+  bool                  exited;   ///< Child reaped; the request finishes once stdout is closed too
+  int                   exit_code;///< Child's exit status, -1 if it did not exit normally
+  char*                 out;      ///< Everything the child printed so far
+  size_t                out_len;
+  size_t                out_cap;
+  double                deadline_ms;  ///< pick_poll() cancels the request after this, 0 = never
+} pick__proc_req_t;
+
+typedef struct {
+  char** items;
+  int    count;
+  int    cap;
+} pick__argv_t;
+
+static pick__proc_req_t* pick__g_proc_reqs;
+static int               pick__g_epoll = -1;
+static int               pick__g_proc_timer = -1;  ///< timerfd for the earliest deadline
+static const char*       pick__g_tool;
+static bool              pick__g_tool_searched;
+
+static bool pick__argv_push(pick__argv_t* a, const char* s) {
+  if (a->count + 2 > a->cap) {
+    int cap = a->cap ? a->cap * 2 : 16;
+    char** items = (char**)PICK_REALLOC(a->items, sizeof(char*) * (size_t)cap);
+    if (!items) return false;
+    a->items = items;
+    a->cap = cap;
+  }
+  char* copy = pick__strdup(s);
+  if (!copy) return false;
+  a->items[a->count++] = copy;
+  a->items[a->count] = NULL;
+  return true;
+}
+
+static bool pick__argv_pushf(pick__argv_t* a, const char* fmt, const char* s) {
+  size_t cap = strlen(fmt) + strlen(s) + 1;
+  char* buf = (char*)PICK_MALLOC(cap);
+  if (!buf) return false;
+  snprintf(buf, cap, fmt, s);
+  bool ok = pick__argv_push(a, buf);
+  PICK_FREE(buf);
+  return ok;
+}
+
+static void pick__argv_free(pick__argv_t* a) {
+  for (int i = 0; i < a->count; i++) PICK_FREE(a->items[i]);
+  PICK_FREE(a->items);
+  *a = (pick__argv_t){0};
+}
+
+static bool pick__proc_on_path(const char* name) {
+  const char* path = getenv("PATH");
+  if (!path || !*path) path = "/usr/local/bin:/usr/bin:/bin";
+  char buf[4096];
+  while (*path) {
+    const char* end = strchr(path, ':');
+    size_t len = end ? (size_t)(end - path) : strlen(path);
+    if (len > 0 && len + 1 + strlen(name) + 1 < sizeof(buf)) {
+      memcpy(buf, path, len);
+      snprintf(buf + len, sizeof(buf) - len, "/%s", name);
+      if (access(buf, X_OK) == 0) return true;
+    }
+    path += len;
+    if (*path == ':') path++;
+  }
+  return false;
+}
+
+static const char* pick__proc_tool(void) {
+  if (pick__g_tool_searched) return pick__g_tool;
+  pick__g_tool_searched = true;
+  static const char* const tools[] = { PICK_SUBPROCESS_TOOLS };
+  for (size_t i = 0; i < sizeof(tools) / sizeof(tools[0]); i++) {
+    if (pick__proc_on_path(tools[i])) { pick__g_tool = tools[i]; break; }
+  }
+  if (!pick__g_tool) fprintf(stderr, "pick: no dialog helper (zenity/kdialog) found on PATH\n");
+  return pick__g_tool;
+}
+
+static bool pick__proc_is_kdialog(void) {
+  return pick__g_tool && strstr(pick__g_tool, "kdialog") != NULL;
+}
+
+static void pick__proc_deliver(pick__proc_req_t* req, char** paths, int count) {
+  switch (req->kind) {
+    case PICK_REQ_OPEN_SINGLE:
+    case PICK_REQ_OPEN_DIR_SINGLE:
+    case PICK_REQ_SAVE:
+      if (req->single_cb) req->single_cb(count > 0 ? paths[0] : NULL, req->user);
+      break;
+    case PICK_REQ_OPEN_MULTI:
+    case PICK_REQ_OPEN_DIR_MULTI:
+      if (req->multi_cb) req->multi_cb(count > 0 ? (const char**)paths : NULL, count, req->user);
+      break;
+    case PICK_REQ_MESSAGE:
+      if (req->msg_cb) req->msg_cb(PICK_RESULT_CLOSED, req->user);
+      break;
+    default: break;
+  }
+}
+
+static void pick__proc_free_req(pick__proc_req_t* req) {
+  if (req->fd >= 0) close(req->fd);
+  if (req->pidfd >= 0) close(req->pidfd);
+  PICK_FREE(req->out);
+  PICK_FREE(req);
+}
+
+static PickButtonResult pick__proc_button_result(pick__proc_req_t* req, int exit_code) {
+  const char* out = req->out ? req->out : "";
+  if (pick__proc_is_kdialog()) {
+    // --yesnocancel: 0 = yes, 1 = no, 2 = cancel
+    switch (req->button_type) {
+      case PICK_BUTTON_OK:            return exit_code == 0 ? PICK_RESULT_OK : PICK_RESULT_CLOSED;
+      case PICK_BUTTON_OK_CANCEL:     return exit_code == 0 ? PICK_RESULT_OK : PICK_RESULT_CANCEL;
+      case PICK_BUTTON_YES_NO:        return exit_code == 0 ? PICK_RESULT_YES : PICK_RESULT_NO;
+      case PICK_BUTTON_YES_NO_CANCEL: return exit_code == 0 ? PICK_RESULT_YES
+                                           : exit_code == 1 ? PICK_RESULT_NO : PICK_RESULT_CANCEL;
+    }
+    return PICK_RESULT_CLOSED;
+  }
+
+  // zenity: 0 = ok label, 1 = cancel label or window closed; an --extra-button
+  // exits with 1 and prints its label.
+  switch (req->button_type) {
+    case PICK_BUTTON_OK:            return exit_code == 0 ? PICK_RESULT_OK : PICK_RESULT_CLOSED;
+    case PICK_BUTTON_OK_CANCEL:     return exit_code == 0 ? PICK_RESULT_OK : exit_code == 1 ? PICK_RESULT_CANCEL : PICK_RESULT_CLOSED;
+    case PICK_BUTTON_YES_NO:        return exit_code == 0 ? PICK_RESULT_YES : exit_code == 1 ? PICK_RESULT_NO : PICK_RESULT_CLOSED;
+    case PICK_BUTTON_YES_NO_CANCEL:
+      if (exit_code == 0) return PICK_RESULT_YES;
+      if (exit_code == 1) return strncmp(out, "Cancel", 6) == 0 ? PICK_RESULT_CANCEL : PICK_RESULT_NO;
+      return PICK_RESULT_CLOSED;
+  }
+  return PICK_RESULT_CLOSED;
+}
+
+static void pick__proc_finish(pick__proc_req_t* req, int exit_code) {
+  if (req->kind == PICK_REQ_MESSAGE) {
+    if (req->msg_cb) req->msg_cb(pick__proc_button_result(req, exit_code), req->user);
+    return;
+  }
+
+  char** paths = NULL;
+  int count = 0;
+  if (exit_code == 0 && req->out) {
+    paths = pick__pack_lines(req->out, &count);
+    // Single-selection requests only ever report the first line.
+    if (count > 1 && req->kind != PICK_REQ_OPEN_MULTI && req->kind != PICK_REQ_OPEN_DIR_MULTI) count = 1;
+  }
+  pick__proc_deliver(req, paths, count);
+  pick_free_multiple(paths, count);
+}
+
+// Drains the pipe without blocking. Returns true once the child closed stdout.
+static bool pick__proc_read(pick__proc_req_t* req) {
+  for (;;) {
+    if (req->out_cap - req->out_len < 1024) {
+      size_t cap = req->out_cap ? req->out_cap * 2 : 4096;
+      char* out = (char*)PICK_REALLOC(req->out, cap);
+      if (!out) return true;
+      req->out = out;
+      req->out_cap = cap;
+    }
+    ssize_t n = read(req->fd, req->out + req->out_len, req->out_cap - req->out_len - 1);
+    if (n > 0) { req->out_len += (size_t)n; req->out[req->out_len] = 0; continue; }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+    return true;
+  }
+}
+
+// One epoll instance holds every child's stdout and pidfd plus a timerfd for
+// deadlines, so pick_poll_fd() becomes readable whenever pick_poll() has work.
+static bool pick__proc_epoll(void) {
+  if (pick__g_epoll >= 0) return true;
+  pick__g_epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (pick__g_epoll < 0) { fprintf(stderr, "pick: epoll_create1 failed: %s\n", strerror(errno)); return false; }
+
+  pick__g_proc_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  struct epoll_event ev = { .events = EPOLLIN, .data = { .ptr = &pick__g_proc_timer } };
+  if (pick__g_proc_timer < 0 || epoll_ctl(pick__g_epoll, EPOLL_CTL_ADD, pick__g_proc_timer, &ev) != 0) {
+    // Deadlines then only fire from a pick_poll() the application makes anyway.
+    fprintf(stderr, "pick: timerfd unavailable: %s\n", strerror(errno));
+    if (pick__g_proc_timer >= 0) close(pick__g_proc_timer);
+    pick__g_proc_timer = -1;
+  }
+  return true;
+}
+
+// Arms the timer for the earliest deadline, or for a reap retry when a child
+// closed stdout and has no pidfd to report its exit; disarms it otherwise.
+static void pick__proc_arm_timer(void) {
+  if (pick__g_proc_timer < 0) return;
+  double due = 0;
+  for (pick__proc_req_t* r = pick__g_proc_reqs; r; r = r->next) {
+    double at = r->deadline_ms;
+    if (r->fd < 0 && !r->exited && r->pidfd < 0) {
+      double retry = pick__now_ms() + PICK_PROC_REAP_RETRY_MS;
+      if (!at || retry < at) at = retry;
+    }
+    if (at > 0 && (!due || at < due)) due = at;
+  }
+  pick__timerfd_arm(pick__g_proc_timer, due);
+}
+
+// Collects the child's exit status if it has exited; never blocks.
+static void pick__proc_reap(pick__proc_req_t* req) {
+  if (req->exited) return;
+  int status = 0;
+  pid_t r = waitpid(req->pid, &status, WNOHANG);
+  if (r == 0) return;
+  req->exited = true;
+  req->exit_code = (r > 0 && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+  if (req->pidfd >= 0) {
+    epoll_ctl(pick__g_epoll, EPOLL_CTL_DEL, req->pidfd, NULL);
+    close(req->pidfd);
+    req->pidfd = -1;
+  }
+}
+
+static bool pick__proc_spawn(pick__proc_req_t* req, pick__argv_t* argv) {
+  int fds[2];
+  // Close-on-exec from the start: a fork on another thread must not inherit
+  // the write end, or the read end would never see EOF. Called through
+  // syscall() because libc only declares pipe2() under _GNU_SOURCE.
+  if (!pick__proc_epoll() || syscall(SYS_pipe2, fds, O_CLOEXEC) != 0) return false;
+
+  posix_spawn_file_actions_t fa;
+  posix_spawn_file_actions_init(&fa);
+  posix_spawn_file_actions_adddup2(&fa, fds[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addopen(&fa, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+  int err = posix_spawnp(&req->pid, argv->items[0], &fa, NULL, argv->items, environ);
+  posix_spawn_file_actions_destroy(&fa);
+  close(fds[1]);
+
+  if (err != 0) {
+    fprintf(stderr, "pick: failed to run %s: %s\n", argv->items[0], strerror(err));
+    close(fds[0]);
+    return false;
+  }
+
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  req->fd = fds[0];
+
+  struct epoll_event ev = { .events = EPOLLIN | EPOLLHUP, .data = { .ptr = req } };
+  if (epoll_ctl(pick__g_epoll, EPOLL_CTL_ADD, req->fd, &ev) != 0) {
+    // Still tracked; pick_poll() will notice EOF when it sweeps the table.
+    fprintf(stderr, "pick: epoll_ctl failed: %s\n", strerror(errno));
+  }
+
+  // The child may exit after closing stdout; its pidfd wakes the loop then.
+#ifdef SYS_pidfd_open
+  req->pidfd = (int)syscall(SYS_pidfd_open, req->pid, 0);
+#endif
+  if (req->pidfd >= 0 && epoll_ctl(pick__g_epoll, EPOLL_CTL_ADD, req->pidfd, &ev) != 0) {
+    close(req->pidfd);
+    req->pidfd = -1;
+  }
+
+  req->next = pick__g_proc_reqs;
+  pick__g_proc_reqs = req;
+  pick__proc_arm_timer();
+  return true;
+}
+
+static bool pick__proc_zenity_args(pick__argv_t* a, pick__req_kind_t kind, const PickFileOptions* opts) {
+  bool is_dir = kind == PICK_REQ_OPEN_DIR_SINGLE || kind == PICK_REQ_OPEN_DIR_MULTI;
+  bool ok = pick__argv_push(a, pick__g_tool) && pick__argv_push(a, "--file-selection");
+  if (opts && opts->title) ok = ok && pick__argv_pushf(a, "--title=%s", opts->title);
+  if (is_dir) ok = ok && pick__argv_push(a, "--directory");
+  if (kind == PICK_REQ_OPEN_MULTI || kind == PICK_REQ_OPEN_DIR_MULTI) {
+    ok = ok && pick__argv_push(a, "--multiple") && pick__argv_push(a, "--separator=\n");
+  }
+  if (kind == PICK_REQ_SAVE) ok = ok && pick__argv_push(a, "--save") && pick__argv_push(a, "--confirm-overwrite");
+
+  const char* dir  = (opts && opts->default_path && *opts->default_path) ? opts->default_path : NULL;
+  const char* name = (kind == PICK_REQ_SAVE && opts && opts->default_name) ? opts->default_name : NULL;
+  if (dir || name) {
+    // --filename selects a directory when it ends in '/'.
+    size_t cap = (dir ? strlen(dir) : 0) + 1 + (name ? strlen(name) : 0) + 1;
+    char* start = (char*)PICK_MALLOC(cap);
+    if (!start) return false;
+    snprintf(start, cap, "%s%s%s", dir ? dir : "", (dir && dir[strlen(dir) - 1] != '/') ? "/" : "", name ? name : "");
+    ok = ok && pick__argv_pushf(a, "--filename=%s", start);
+    PICK_FREE(start);
+  }
+
+  if (!is_dir && opts && opts->filters) {
+    for (int i = 0; ok && i < opts->filter_count; i++) {
+      const PickFilter* f = &opts->filters[i];
+      char spec[1024];
+      size_t used = (size_t)snprintf(spec, sizeof(spec), "--file-filter=%s |", (f->name && *f->name) ? f->name : "Files");
+      for (int j = 0; j < f->extension_count && used < sizeof(spec); j++) {
+        if (f->extensions[j] && *f->extensions[j]) used += (size_t)snprintf(spec + used, sizeof(spec) - used, " *.%s", f->extensions[j]);
+      }
+      ok = ok && pick__argv_push(a, spec);
+    }
+  }
+  return ok;
+}
+
+static bool pick__proc_kdialog_args(pick__argv_t* a, pick__req_kind_t kind, const PickFileOptions* opts) {
+  bool is_dir = kind == PICK_REQ_OPEN_DIR_SINGLE || kind == PICK_REQ_OPEN_DIR_MULTI;
+  bool ok = pick__argv_push(a, pick__g_tool);
+  if (opts && opts->title) ok = ok && pick__argv_push(a, "--title") && pick__argv_push(a, opts->title);
+  if (kind == PICK_REQ_OPEN_MULTI) ok = ok && pick__argv_push(a, "--multiple") && pick__argv_push(a, "--separate-output");
+  // kdialog has no multi-folder chooser; folders requests get a single folder.
+  ok = ok && pick__argv_push(a, is_dir ? "--getexistingdirectory"
+                              : kind == PICK_REQ_SAVE ? "--getsavefilename" : "--getopenfilename");
+
+  const char* dir  = (opts && opts->default_path && *opts->default_path) ? opts->default_path : ".";
+  const char* name = (kind == PICK_REQ_SAVE && opts && opts->default_name) ? opts->default_name : NULL;
+  if (name) {
+    size_t cap = strlen(dir) + 1 + strlen(name) + 1;
+    char* start = (char*)PICK_MALLOC(cap);
+    if (!start) return false;
+    snprintf(start, cap, "%s/%s", dir, name);
+    ok = ok && pick__argv_push(a, start);
+    PICK_FREE(start);
+  } else {
+    ok = ok && pick__argv_push(a, dir);
+  }
+
+  if (!is_dir && opts && opts->filters && opts->filter_count > 0) {
+    // "Images (*.png *.jpg)|Documents (*.pdf)"
+    char spec[2048];
+    size_t used = 0;
+    spec[0] = 0;
+    for (int i = 0; i < opts->filter_count && used < sizeof(spec); i++) {
+      const PickFilter* f = &opts->filters[i];
+      used += (size_t)snprintf(spec + used, sizeof(spec) - used, "%s%s (", i ? "|" : "", (f->name && *f->name) ? f->name : "Files");
+      for (int j = 0; j < f->extension_count && used < sizeof(spec); j++) {
+        if (f->extensions[j] && *f->extensions[j]) used += (size_t)snprintf(spec + used, sizeof(spec) - used, "%s*.%s", j ? " " : "", f->extensions[j]);
+      }
+      if (used < sizeof(spec)) used += (size_t)snprintf(spec + used, sizeof(spec) - used, ")");
+    }
+    ok = ok && pick__argv_push(a, spec);
+  }
+  return ok;
+}
+
+static PickRequest pick__proc_file_chooser(pick__req_kind_t kind, const PickFileOptions* opts,
+                                           PickFileCallback single_cb, PickMultiFileCallback multi_cb, void* ud) {
+  pick__proc_req_t* req = (pick__proc_req_t*)PICK_CALLOC(1, sizeof(pick__proc_req_t));
+  if (!req) { if (single_cb) single_cb(NULL, ud); if (multi_cb) multi_cb(NULL, 0, ud); return PICK_REQUEST_NONE; }
+  *req = (pick__proc_req_t){ .kind = kind, .single_cb = single_cb, .multi_cb = multi_cb, .user = ud, .fd = -1, .pidfd = -1,
+                             .id = pick__next_request(), .deadline_ms = pick__deadline_ms(opts ? opts->timeout_ms : 0) };
+
+  pick__argv_t argv = {0};
+  bool ok = pick__proc_tool() &&
+            (pick__proc_is_kdialog() ? pick__proc_kdialog_args(&argv, kind, opts)
+                                     : pick__proc_zenity_args(&argv, kind, opts)) &&
+            pick__proc_spawn(req, &argv);
+  pick__argv_free(&argv);
+
+  if (!ok) {
+    pick__proc_deliver(req, NULL, 0);
+    pick__proc_free_req(req);
+    return PICK_REQUEST_NONE;
+  }
+  return req->id;
+}
+
+static bool pick__proc_message_args(pick__argv_t* a, const PickMessageOptions* opts) {
+  PickButtonType btns = opts ? opts->buttons : PICK_BUTTON_OK;
+  PickMessageStyle style = opts ? opts->style : PICK_STYLE_INFO;
+  const char* title = (opts && opts->title) ? opts->title : "Message";
+  const char* message = (opts && opts->message) ? opts->message : "";
+
+  char* text = NULL;
+  if (opts && opts->detail && *opts->detail) {
+    size_t cap = strlen(message) + 2 + strlen(opts->detail) + 1;
+    text = (char*)PICK_MALLOC(cap);
+    if (!text) return false;
+    snprintf(text, cap, "%s\n\n%s", message, opts->detail);
+    message = text;
+  }
+
+  bool ok = pick__argv_push(a, pick__g_tool);
+  if (pick__proc_is_kdialog()) {
+    const char* mode = "--msgbox";
+    switch (btns) {
+      case PICK_BUTTON_OK:
+        mode = style == PICK_STYLE_ERROR ? "--error" : style == PICK_STYLE_WARNING ? "--sorry" : "--msgbox";
+        break;
+      case PICK_BUTTON_OK_CANCEL:
+      case PICK_BUTTON_YES_NO:
+        mode = style == PICK_STYLE_WARNING || style == PICK_STYLE_ERROR ? "--warningyesno" : "--yesno";
+        break;
+      case PICK_BUTTON_YES_NO_CANCEL:
+        mode = style == PICK_STYLE_WARNING || style == PICK_STYLE_ERROR ? "--warningyesnocancel" : "--yesnocancel";
+        break;
+    }
+    ok = ok && pick__argv_push(a, "--title") && pick__argv_push(a, title) &&
+         pick__argv_push(a, mode) && pick__argv_push(a, message);
+    if (btns == PICK_BUTTON_OK_CANCEL) {
+      ok = ok && pick__argv_push(a, "--yes-label") && pick__argv_push(a, "OK") &&
+           pick__argv_push(a, "--no-label") && pick__argv_push(a, "Cancel");
+    }
+  } else {
+    const char* mode = btns != PICK_BUTTON_OK ? "--question"
+                     : style == PICK_STYLE_ERROR ? "--error"
+                     : style == PICK_STYLE_WARNING ? "--warning" : "--info";
+    ok = ok && pick__argv_push(a, mode) && pick__argv_pushf(a, "--title=%s", title) &&
+         pick__argv_pushf(a, "--text=%s", message);
+    switch (btns) {
+      case PICK_BUTTON_OK: break;
+      case PICK_BUTTON_OK_CANCEL:
+        ok = ok && pick__argv_push(a, "--ok-label=OK") && pick__argv_push(a, "--cancel-label=Cancel");
+        break;
+      case PICK_BUTTON_YES_NO:
+        ok = ok && pick__argv_push(a, "--ok-label=Yes") && pick__argv_push(a, "--cancel-label=No");
+        break;
+      case PICK_BUTTON_YES_NO_CANCEL:
+        ok = ok && pick__argv_push(a, "--ok-label=Yes") && pick__argv_push(a, "--cancel-label=No") &&
+             pick__argv_push(a, "--extra-button=Cancel");
+        break;
+    }
+    if (btns != PICK_BUTTON_OK && style == PICK_STYLE_WARNING) ok = ok && pick__argv_push(a, "--icon-name=dialog-warning");
+    if (btns != PICK_BUTTON_OK && style == PICK_STYLE_ERROR)   ok = ok && pick__argv_push(a, "--icon-name=dialog-error");
+  }
+
+  PICK_FREE(text);
+  return ok;
+}
+
+PickRequest pick__file_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__proc_file_chooser(PICK_REQ_OPEN_SINGLE, options, cb, NULL, ud);
+}
+
+PickRequest pick__files_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  return pick__proc_file_chooser(PICK_REQ_OPEN_MULTI, options, NULL, cb, ud);
+}
+
+PickRequest pick__folder_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__proc_file_chooser(PICK_REQ_OPEN_DIR_SINGLE, options, cb, NULL, ud);
+}
+
+PickRequest pick__folders_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  return pick__proc_file_chooser(PICK_REQ_OPEN_DIR_MULTI, options, NULL, cb, ud);
+}
+
+PickRequest pick__save_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__proc_file_chooser(PICK_REQ_SAVE, options, cb, NULL, ud);
+}
+
+PickRequest pick__message_impl(const PickMessageOptions *opts, PickMessageCallback cb, void *ud) {
+  pick__proc_req_t* req = (pick__proc_req_t*)PICK_CALLOC(1, sizeof(pick__proc_req_t));
+  if (!req) { if (cb) cb(PICK_RESULT_CLOSED, ud); return PICK_REQUEST_NONE; }
+  *req = (pick__proc_req_t){ .kind = PICK_REQ_MESSAGE, .msg_cb = cb, .user = ud, .fd = -1, .pidfd = -1,
+                             .button_type = opts ? opts->buttons : PICK_BUTTON_OK,
+                             .id = pick__next_request(), .deadline_ms = pick__deadline_ms(opts ? opts->timeout_ms : 0) };
+
+  pick__argv_t argv = {0};
+  bool ok = pick__proc_tool() && pick__proc_message_args(&argv, opts) && pick__proc_spawn(req, &argv);
+  pick__argv_free(&argv);
+
+  if (!ok) {
+    pick__proc_deliver(req, NULL, 0);
+    pick__proc_free_req(req);
+    return PICK_REQUEST_NONE;
+  }
+  return req->id;
+}
+
+// Kills the helper and reports the request as cancelled. The entry stays
+// listed, with its callbacks cleared, until its pidfd reports the exit.
+static void pick__proc_cancel(pick__proc_req_t* req) {
+  kill(req->pid, SIGTERM);
+  req->id = PICK_REQUEST_NONE;
+  req->deadline_ms = 0;
+  pick__proc_deliver(req, NULL, 0);
+  req->single_cb = NULL;
+  req->multi_cb = NULL;
+  req->msg_cb = NULL;
+}
+
+bool pick__cancel_impl(PickRequest request) {
+  for (pick__proc_req_t* r = pick__g_proc_reqs; r; r = r->next) {
+    if (r->id == request) { pick__proc_cancel(r); return true; }
+  }
+  return false;
+}
+
+void pick_poll(void) {
+  if (pick__g_epoll < 0) return;
+
+  double now = pick__now_ms();
+  for (pick__proc_req_t* r = pick__g_proc_reqs; r; r = r->next) {
+    if (r->deadline_ms > 0 && now >= r->deadline_ms) pick__proc_cancel(r);
+  }
+
+  struct epoll_event events[32];
+  int n;
+  while ((n = epoll_wait(pick__g_epoll, events, 32, 0)) > 0) {
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.ptr == &pick__g_proc_timer) {
+        uint64_t expirations;
+        ssize_t got = read(pick__g_proc_timer, &expirations, sizeof(expirations));
+        (void)got;
+        continue;
+      }
+      // Stdout and the pidfd share the entry; service whichever is ready.
+      pick__proc_req_t* req = (pick__proc_req_t*)events[i].data.ptr;
+      if (req->fd >= 0 && pick__proc_read(req)) {
+        epoll_ctl(pick__g_epoll, EPOLL_CTL_DEL, req->fd, NULL);
+        close(req->fd);
+        req->fd = -1;
+      }
+      if (req->pidfd >= 0) pick__proc_reap(req);
+    }
+    if (n < 32) break;
+  }
+
+  // A request finishes once its child has exited and stdout is drained.
+  // Without a pidfd the exit is polled for here, and the timer retries it.
+  pick__proc_req_t** it = &pick__g_proc_reqs;
+  while (*it) {
+    pick__proc_req_t* req = *it;
+    if (req->fd < 0) pick__proc_reap(req);
+    if (req->fd >= 0 || !req->exited) { it = &req->next; continue; }
+
+    *it = req->next;
+    pick__proc_finish(req, req->exit_code);
+    pick__proc_free_req(req);
+  }
+  pick__proc_arm_timer();
+}
+
+int pick_poll_fd(void) {
+  return pick__proc_epoll() ? pick__g_epoll : -1;
+}
+
+#endif
+
+#if defined(PICK_PLATFORM_LINUX) && !defined(PICK_LINUX_GTK) && !defined(PICK_LINUX_SUBPROCESS)
+
+#include <dbus/dbus.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define PICK_PORTAL_BUS_NAME    "org.freedesktop.portal.Desktop"
+#define PICK_PORTAL_OBJECT_PATH "/org/freedesktop/portal/desktop"
+#define PICK_PORTAL_FILE_CHOOSER "org.freedesktop.portal.FileChooser"
+#define PICK_PORTAL_REQUEST     "org.freedesktop.portal.Request"
+#define PICK_NOTIFY_BUS_NAME    "org.freedesktop.Notifications"
+#define PICK_NOTIFY_OBJECT_PATH "/org/freedesktop/Notifications"
+
+typedef enum {
+  PICK_REQ_NONE = 0,
+  PICK_REQ_OPEN_SINGLE,
+  PICK_REQ_OPEN_MULTI,
+  PICK_REQ_OPEN_DIR_SINGLE,
+  PICK_REQ_OPEN_DIR_MULTI,
+  PICK_REQ_SAVE,
+  PICK_REQ_MESSAGE
+} pick__req_kind_t;
+
+typedef struct pick__portal_req_t {
+  struct pick__portal_req_t* next;
+  PickRequest           id;         ///< PICK_REQUEST_NONE once cancelled
+  pick__req_kind_t      kind;
+  PickFileCallback      single_cb;
+  PickMultiFileCallback multi_cb;
+  PickMessageCallback   msg_cb;
+  void*                 user;
+  PickButtonType        button_type;
+  char*                 handle;     ///< Request object path (file chooser)
+  dbus_uint32_t         notify_id;  ///< Notification id (message), 0 until the reply arrives
+  bool                  replied;    ///< Method reply seen; a cancelled request is freed only after it
+  bool                  answered;   ///< Response seen before the method reply; on_reply frees it
+  double                deadline_ms;///< pick_poll() cancels the request after this, 0 = never
+} pick__portal_req_t;
+
+static DBusConnection*     pick__g_bus;
+static pick__portal_req_t* pick__g_portal_reqs;
+static unsigned            pick__g_portal_token;
+static int                 pick__g_portal_epoll = -1;  ///< Bus socket plus the timer; what pick_poll_fd() returns
+static int                 pick__g_portal_timer = -1;  ///< timerfd for the earliest deadline
+
+static DBusHandlerResult pick__portal_filter(DBusConnection* bus, DBusMessage* msg, void* unused);
+
+// The bus socket alone cannot wake a caller blocked on pick_poll_fd() when a
+// deadline passes, so it shares an epoll instance with a timerfd. Without
+// epoll, pick_poll_fd() falls back to the bare socket.
+static void pick__portal_epoll_add_bus(void) {
+  if (pick__g_portal_epoll < 0) {
+    pick__g_portal_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (pick__g_portal_epoll < 0) { fprintf(stderr, "pick: epoll_create1 failed: %s\n", strerror(errno)); return; }
+    pick__g_portal_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN };
+    if (pick__g_portal_timer < 0 || epoll_ctl(pick__g_portal_epoll, EPOLL_CTL_ADD, pick__g_portal_timer, &ev) != 0) {
+      // Deadlines then only fire from a pick_poll() the application makes anyway.
+      fprintf(stderr, "pick: timerfd unavailable: %s\n", strerror(errno));
+      if (pick__g_portal_timer >= 0) close(pick__g_portal_timer);
+      pick__g_portal_timer = -1;
+    }
+  }
+  int fd = -1;
+  struct epoll_event ev = { .events = EPOLLIN };
+  if (dbus_connection_get_unix_fd(pick__g_bus, &fd) && epoll_ctl(pick__g_portal_epoll, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    fprintf(stderr, "pick: epoll_ctl failed: %s\n", strerror(errno));
+  }
+}
+
+// Arms the timer for the earliest pending deadline, or disarms it.
+static void pick__portal_arm_timer(void) {
+  double due = 0;
+  for (pick__portal_req_t* r = pick__g_portal_reqs; r; r = r->next) {
+    if (r->deadline_ms > 0 && (!due || r->deadline_ms < due)) due = r->deadline_ms;
+  }
+  pick__timerfd_arm(pick__g_portal_timer, due);
+}
+
+static DBusConnection* pick__portal_bus(void) {
+  if (pick__g_bus) return pick__g_bus;
+
+  DBusError err;
+  dbus_error_init(&err);
+  DBusConnection* bus = dbus_bus_get_private(DBUS_BUS_SESSION, &err);
+  if (!bus) {
+    fprintf(stderr, "pick: session bus unavailable: %s\n", err.message ? err.message : "unknown error");
+    dbus_error_free(&err);
+    return NULL;
+  }
+  dbus_connection_set_exit_on_disconnect(bus, FALSE);
+
+  // One filter and two broad match rules serve every request; passing a NULL
+  // error makes dbus_bus_add_match() fire-and-forget instead of a round trip.
+  dbus_bus_add_match(bus, "type='signal',interface='" PICK_PORTAL_REQUEST "',member='Response'", NULL);
+  dbus_bus_add_match(bus, "type='signal',interface='" PICK_NOTIFY_BUS_NAME "'", NULL);
+  dbus_connection_add_filter(bus, pick__portal_filter, NULL, NULL);
+
+  pick__g_bus = bus;
+  pick__portal_epoll_add_bus();
+  return bus;
+}
+
+static void pick__portal_link(pick__portal_req_t* req) {
+  req->next = pick__g_portal_reqs;
+  pick__g_portal_reqs = req;
+}
+
+static void pick__portal_unlink(pick__portal_req_t* req) {
+  for (pick__portal_req_t** it = &pick__g_portal_reqs; *it; it = &(*it)->next) {
+    if (*it == req) { *it = req->next; req->next = NULL; return; }
+  }
+}
+
+static pick__portal_req_t* pick__portal_find_handle(const char* path) {
+  if (!path) return NULL;
+  for (pick__portal_req_t* r = pick__g_portal_reqs; r; r = r->next) {
+    if (r->handle && strcmp(r->handle, path) == 0) return r;
+  }
+  return NULL;
+}
+
+static pick__portal_req_t* pick__portal_find_notification(dbus_uint32_t id) {
+  for (pick__portal_req_t* r = pick__g_portal_reqs; r; r = r->next) {
+    if (r->kind == PICK_REQ_MESSAGE && r->notify_id == id) return r;
+  }
+  return NULL;
+}
+
+static void pick__portal_free_req(pick__portal_req_t* req) {
+  if (!req) return;
+  PICK_FREE(req->handle);
+  PICK_FREE(req);
+}
+
+static void pick__portal_deliver(pick__portal_req_t* req, char** paths, int count) {
+  switch (req->kind) {
+    case PICK_REQ_OPEN_SINGLE:
+    case PICK_REQ_OPEN_DIR_SINGLE:
+    case PICK_REQ_SAVE:
+      if (req->single_cb) req->single_cb(count > 0 ? paths[0] : NULL, req->user);
+      break;
+    case PICK_REQ_OPEN_MULTI:
+    case PICK_REQ_OPEN_DIR_MULTI:
+      if (req->multi_cb) req->multi_cb(count > 0 ? (const char**)paths : NULL, count, req->user);
+      break;
+    case PICK_REQ_MESSAGE:
+      if (req->msg_cb) req->msg_cb(PICK_RESULT_CLOSED, req->user);
+      break;
+    default: break;
+  }
+}
+
+static void pick__portal_deliver_msg(pick__portal_req_t* req, const char* action) {
+  if (!req->msg_cb) return;
+  PickButtonResult result = PICK_RESULT_CLOSED;
+  if (action) {
+    if      (strcmp(action, "ok") == 0)     result = PICK_RESULT_OK;
+    else if (strcmp(action, "cancel") == 0) result = PICK_RESULT_CANCEL;
+    else if (strcmp(action, "yes") == 0)    result = PICK_RESULT_YES;
+    else if (strcmp(action, "no") == 0)     result = PICK_RESULT_NO;
+    else if (strcmp(action, "default") == 0)
+      result = (req->button_type == PICK_BUTTON_YES_NO || req->button_type == PICK_BUTTON_YES_NO_CANCEL)
+               ? PICK_RESULT_YES : PICK_RESULT_OK;
+  }
+  req->msg_cb(result, req->user);
+}
+
+// Fails every pending request, e.g. after the session bus went away.
+static void pick__portal_fail_all(void) {
+  while (pick__g_portal_reqs) {
+    pick__portal_req_t* req = pick__g_portal_reqs;
+    pick__portal_unlink(req);
+    pick__portal_deliver(req, NULL, 0);
+    pick__portal_free_req(req);
+  }
+}
+
+// Fire-and-forget: Request.Close (file chooser) or CloseNotification (message).
+static void pick__portal_close(pick__portal_req_t* req) {
+  DBusMessage* msg = NULL;
+  if (req->kind != PICK_REQ_MESSAGE && req->handle) {
+    msg = dbus_message_new_method_call(PICK_PORTAL_BUS_NAME, req->handle, PICK_PORTAL_REQUEST, "Close");
+  } else if (req->kind == PICK_REQ_MESSAGE && req->notify_id) {
+    msg = dbus_message_new_method_call(PICK_NOTIFY_BUS_NAME, PICK_NOTIFY_OBJECT_PATH,
+                                       PICK_NOTIFY_BUS_NAME, "CloseNotification");
+    if (msg) dbus_message_append_args(msg, DBUS_TYPE_UINT32, &req->notify_id, DBUS_TYPE_INVALID);
+  }
+  if (!msg) return;
+  dbus_message_set_no_reply(msg, TRUE);
+  dbus_connection_send(pick__g_bus, msg, NULL);
+  dbus_connection_flush(pick__g_bus);
+  dbus_message_unref(msg);
+}
+
+// Dismisses the dialog and reports it as cancelled. Until the method reply
+// arrives the entry stays listed, with its callbacks cleared, because the
+// pending call still points at it. The callback runs last, from a copy.
+static void pick__portal_cancel(pick__portal_req_t* req) {
+  pick__portal_close(req);
+  pick__portal_req_t done = *req;
+  req->id = PICK_REQUEST_NONE;
+  req->deadline_ms = 0;
+  req->single_cb = NULL;
+  req->multi_cb = NULL;
+  req->msg_cb = NULL;
+  if (req->replied) {
+    pick__portal_unlink(req);
+    pick__portal_free_req(req);
+  }
+  if (done.kind == PICK_REQ_MESSAGE) pick__portal_deliver_msg(&done, NULL);
+  else pick__portal_deliver(&done, NULL, 0);
+}
+
+static int pick__hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Returns the path part of a file:// URI (still percent-encoded), or NULL.
+static const char* pick__portal_uri_path(const char* uri) {
+  if (!uri || strncmp(uri, "file://", 7) != 0) return NULL;
+  const char* p = uri + 7;
+  if (*p != '/') p = strchr(p, '/');
+  return p;
+}
+
+// Percent-decodes `p` into `out`, which needs strlen(p) + 1 bytes; returns the bytes written.
+static size_t pick__portal_decode_into(const char* p, char* out) {
+  size_t len = strlen(p);
+  size_t n = 0;
+  for (size_t i = 0; i < len; i++) {
+    int hi, lo;
+    if (p[i] == '%' && i + 2 < len &&
+        (hi = pick__hex_value(p[i + 1])) >= 0 && (lo = pick__hex_value(p[i + 2])) >= 0) {
+      out[n++] = (char)(hi * 16 + lo);
+      i += 2;
+    } else {
+      out[n++] = p[i];
+    }
+  }
+  out[n++] = 0;
+  return n;
+}
+
+// Parses the (u response, a{sv} results) body of a Request::Response signal.
+// The uris are walked twice: once to size a single pick_free_multiple() block
+// (encoded lengths bound the decoded ones), then to decode straight into it.
+static int pick__portal_read_response(DBusMessage* msg, char*** out_paths) {
+  *out_paths = NULL;
+  DBusMessageIter it;
+  if (!dbus_message_iter_init(msg, &it) || dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_UINT32) return 0;
+  dbus_uint32_t response = 1;
+  dbus_message_iter_get_basic(&it, &response);
+  if (response != 0 || !dbus_message_iter_next(&it) || dbus_message_iter_get_arg_type(&it) != DBUS_TYPE_ARRAY) return 0;
+
+  DBusMessageIter dict;
+  dbus_message_iter_recurse(&it, &dict);
+  for (; dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY; dbus_message_iter_next(&dict)) {
+    DBusMessageIter entry, variant, uris;
+    const char* key = NULL;
+    dbus_message_iter_recurse(&dict, &entry);
+    dbus_message_iter_get_basic(&entry, &key);
+    if (!key || strcmp(key, "uris") != 0) continue;
+    dbus_message_iter_next(&entry);
+    dbus_message_iter_recurse(&entry, &variant);
+    if (dbus_message_iter_get_arg_type(&variant) != DBUS_TYPE_ARRAY) return 0;
+
+    int total = 0;
+    size_t bytes = 0;
+    dbus_message_iter_recurse(&variant, &uris);
+    for (; dbus_message_iter_get_arg_type(&uris) == DBUS_TYPE_STRING; dbus_message_iter_next(&uris)) {
+      const char* uri = NULL;
+      dbus_message_iter_get_basic(&uris, &uri);
+      const char* p = pick__portal_uri_path(uri);
+      if (p) { bytes += strlen(p) + 1; total++; }
+    }
+    if (!total) return 0;
+
+    char** paths = (char**)PICK_MALLOC(sizeof(char*) * (size_t)total + bytes);
+    if (!paths) return 0;
+    char* cursor = (char*)(paths + total);
+
+    int count = 0;
+    dbus_message_iter_recurse(&variant, &uris);
+    for (; dbus_message_iter_get_arg_type(&uris) == DBUS_TYPE_STRING && count < total; dbus_message_iter_next(&uris)) {
+      const char* uri = NULL;
+      dbus_message_iter_get_basic(&uris, &uri);
+      const char* p = pick__portal_uri_path(uri);
+      if (!p) continue;
+      paths[count++] = cursor;
+      cursor += pick__portal_decode_into(p, cursor);
+    }
+    *out_paths = paths;
+    return count;
+  }
+  return 0;
+}
+
+static DBusHandlerResult pick__portal_filter(DBusConnection* bus, DBusMessage* msg, void* unused) {
+  (void)bus; (void)unused;
+
+  if (dbus_message_is_signal(msg, PICK_PORTAL_REQUEST, "Response")) {
+    pick__portal_req_t* req = pick__portal_find_handle(dbus_message_get_path(msg));
+    if (!req || req->answered) return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    // Retire the entry before the callback runs, which may cancel its own
+    // handle or poll again; the result is delivered from a copy.
+    pick__portal_req_t done = *req;
+    if (req->replied) {
+      pick__portal_unlink(req);
+      pick__portal_free_req(req);
+    } else {
+      // The handle_token path lets the Response beat the method reply; the
+      // pending call still points at the entry, so on_reply frees it.
+      req->answered = true;
+      req->id = PICK_REQUEST_NONE;
+      req->deadline_ms = 0;
+      req->single_cb = NULL;
+      req->multi_cb = NULL;
+      req->msg_cb = NULL;
+    }
+
+    char** paths = NULL;
+    int count = pick__portal_read_response(msg, &paths);
+    pick__portal_deliver(&done, paths, count);
+    pick_free_multiple(paths, count);
+    return DBUS_HANDLER_RESULT_HANDLED;
+  }
+
+  if (dbus_message_is_signal(msg, PICK_NOTIFY_BUS_NAME, "ActionInvoked") ||
+      dbus_message_is_signal(msg, PICK_NOTIFY_BUS_NAME, "NotificationClosed")) {
+    bool invoked = dbus_message_is_signal(msg, PICK_NOTIFY_BUS_NAME, "ActionInvoked");
+    dbus_uint32_t id = 0;
+    const char* action = NULL;
+    dbus_uint32_t reason = 0;
+    bool ok = invoked
+      ? dbus_message_get_args(msg, NULL, DBUS_TYPE_UINT32, &id, DBUS_TYPE_STRING, &action, DBUS_TYPE_INVALID)
+      : dbus_message_get_args(msg, NULL, DBUS_TYPE_UINT32, &id, DBUS_TYPE_UINT32, &reason, DBUS_TYPE_INVALID);
+    pick__portal_req_t* req = (ok && id) ? pick__portal_find_notification(id) : NULL;
+    if (!req) return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    pick__portal_unlink(req);
+
+    pick__portal_deliver_msg(req, invoked ? action : NULL);
+    // Most servers dismiss on action themselves; make sure the bubble goes away.
+    if (invoked) pick__portal_close(req);
+    pick__portal_free_req(req);
+    return DBUS_HANDLER_RESULT_HANDLED;
+  }
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+// Method replies only carry the request handle (file chooser) or notification
+// id (message); the actual result arrives later as a signal.
+static void pick__portal_on_reply(DBusPendingCall* pending, void* data) {
+  pick__portal_req_t* req = (pick__portal_req_t*)data;
+  DBusMessage* reply = dbus_pending_call_steal_reply(pending);
+  req->replied = true;
+
+  if (req->answered) {
+    pick__portal_unlink(req);
+    pick__portal_free_req(req);
+    if (reply) dbus_message_unref(reply);
+    return;
+  }
+
+  bool ok = reply && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_METHOD_RETURN;
+  if (ok && req->kind == PICK_REQ_MESSAGE) {
+    dbus_uint32_t id = 0;
+    ok = dbus_message_get_args(reply, NULL, DBUS_TYPE_UINT32, &id, DBUS_TYPE_INVALID) && id;
+    if (ok) req->notify_id = id;
+  } else if (ok) {
+    const char* path = NULL;
+    ok = dbus_message_get_args(reply, NULL, DBUS_TYPE_OBJECT_PATH, &path, DBUS_TYPE_INVALID);
+    // Portals older than 0.9 ignore handle_token and pick their own path.
+    if (ok && (!req->handle || strcmp(req->handle, path) != 0)) {
+      char* copy = pick__strdup(path);
+      if (copy) { PICK_FREE(req->handle); req->handle = copy; }
+    }
+  }
+
+  if (ok && req->id == PICK_REQUEST_NONE) {
+    // Cancelled while the call was in flight; close what the reply just revealed.
+    pick__portal_close(req);
+    pick__portal_unlink(req);
+    pick__portal_free_req(req);
+  } else if (!ok) {
+    if (reply && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR) {
+      const char* text = NULL;
+      dbus_message_get_args(reply, NULL, DBUS_TYPE_STRING, &text, DBUS_TYPE_INVALID);
+      fprintf(stderr, "pick: %s: %s\n", dbus_message_get_error_name(reply), text ? text : "");
+    }
+    pick__portal_unlink(req);
+    if (req->kind == PICK_REQ_MESSAGE) pick__portal_deliver_msg(req, NULL);
+    else pick__portal_deliver(req, NULL, 0);
+    pick__portal_free_req(req);
+  }
+
+  if (reply) dbus_message_unref(reply);
+}
+
+static bool pick__portal_send(DBusMessage* msg, pick__portal_req_t* req) {
+  DBusPendingCall* pending = NULL;
+  if (!dbus_connection_send_with_reply(pick__g_bus, msg, &pending, DBUS_TIMEOUT_INFINITE) || !pending) return false;
+  pick__portal_link(req);
+  dbus_pending_call_set_notify(pending, pick__portal_on_reply, req, NULL);
+  dbus_pending_call_unref(pending);
+  dbus_connection_flush(pick__g_bus);
+  if (req->deadline_ms > 0) pick__portal_arm_timer();
+  return true;
+}
+
+// The portal derives the request path from our unique name and handle_token,
+// so the path is known before the call and no Response can be missed.
+static char* pick__portal_request_path(const char* token) {
+  const char* unique = dbus_bus_get_unique_name(pick__g_bus);
+  if (!unique) return NULL;
+  if (*unique == ':') unique++;
+
+  size_t cap = sizeof(PICK_PORTAL_OBJECT_PATH "/request/") + strlen(unique) + 1 + strlen(token);
+  char* path = (char*)PICK_MALLOC(cap);
+  if (!path) return NULL;
+
+  size_t used = (size_t)snprintf(path, cap, PICK_PORTAL_OBJECT_PATH "/request/");
+  for (const char* p = unique; *p; p++) path[used++] = (*p == '.') ? '_' : *p;
+  snprintf(path + used, cap - used, "/%s", token);
+  return path;
+}
+
+static void pick__portal_dict_begin(DBusMessageIter* dict, const char* key, const char* sig,
+                                    DBusMessageIter* entry, DBusMessageIter* variant) {
+  dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, entry);
+  dbus_message_iter_append_basic(entry, DBUS_TYPE_STRING, &key);
+  dbus_message_iter_open_container(entry, DBUS_TYPE_VARIANT, sig, variant);
+}
+
+static void pick__portal_dict_end(DBusMessageIter* dict, DBusMessageIter* entry, DBusMessageIter* variant) {
+  dbus_message_iter_close_container(entry, variant);
+  dbus_message_iter_close_container(dict, entry);
+}
+
+static void pick__portal_dict_string(DBusMessageIter* dict, const char* key, const char* value) {
+  DBusMessageIter entry, variant;
+  pick__portal_dict_begin(dict, key, DBUS_TYPE_STRING_AS_STRING, &entry, &variant);
+  dbus_message_iter_append_basic(&variant, DBUS_TYPE_STRING, &value);
+  pick__portal_dict_end(dict, &entry, &variant);
+}
+
+static void pick__portal_dict_bool(DBusMessageIter* dict, const char* key, bool value) {
+  DBusMessageIter entry, variant;
+  dbus_bool_t v = value ? TRUE : FALSE;
+  pick__portal_dict_begin(dict, key, DBUS_TYPE_BOOLEAN_AS_STRING, &entry, &variant);
+  dbus_message_iter_append_basic(&variant, DBUS_TYPE_BOOLEAN, &v);
+  pick__portal_dict_end(dict, &entry, &variant);
+}
+
+static void pick__portal_dict_byte(DBusMessageIter* dict, const char* key, unsigned char value) {
+  DBusMessageIter entry, variant;
+  pick__portal_dict_begin(dict, key, DBUS_TYPE_BYTE_AS_STRING, &entry, &variant);
+  dbus_message_iter_append_basic(&variant, DBUS_TYPE_BYTE, &value);
+  pick__portal_dict_end(dict, &entry, &variant);
+}
+
+// Paths travel as NUL-terminated byte arrays ("ay"), not strings.
+static void pick__portal_dict_path(DBusMessageIter* dict, const char* key, const char* path) {
+  DBusMessageIter entry, variant, bytes;
+  const unsigned char* data = (const unsigned char*)path;
+  int len = (int)strlen(path) + 1;
+  pick__portal_dict_begin(dict, key, "ay", &entry, &variant);
+  dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, DBUS_TYPE_BYTE_AS_STRING, &bytes);
+  dbus_message_iter_append_fixed_array(&bytes, DBUS_TYPE_BYTE, &data, len);
+  dbus_message_iter_close_container(&variant, &bytes);
+  pick__portal_dict_end(dict, &entry, &variant);
+}
+
+// filters: a(sa(us)), one (name, [(0, "*.ext"), ...]) tuple per PickFilter.
+static void pick__portal_dict_filters(DBusMessageIter* dict, const PickFileOptions* opts) {
+  DBusMessageIter entry, variant, list;
+  pick__portal_dict_begin(dict, "filters", "a(sa(us))", &entry, &variant);
+  dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, "(sa(us))", &list);
+
+  for (int i = 0; i < opts->filter_count; i++) {
+    const PickFilter* f = &opts->filters[i];
+    DBusMessageIter filter, globs;
+    const char* name = (f->name && *f->name) ? f->name : "Files";
+    dbus_message_iter_open_container(&list, DBUS_TYPE_STRUCT, NULL, &filter);
+    dbus_message_iter_append_basic(&filter, DBUS_TYPE_STRING, &name);
+    dbus_message_iter_open_container(&filter, DBUS_TYPE_ARRAY, "(us)", &globs);
+    for (int j = 0; j < f->extension_count; j++) {
+      const char* ext = f->extensions[j];
+      if (!ext || !*ext) continue;
+      char pattern[128];
+      snprintf(pattern, sizeof(pattern), "*.%s", ext);
+      const char* glob = pattern;
+      dbus_uint32_t kind = 0;
+      DBusMessageIter pair;
+      dbus_message_iter_open_container(&globs, DBUS_TYPE_STRUCT, NULL, &pair);
+      dbus_message_iter_append_basic(&pair, DBUS_TYPE_UINT32, &kind);
+      dbus_message_iter_append_basic(&pair, DBUS_TYPE_STRING, &glob);
+      dbus_message_iter_close_container(&globs, &pair);
+    }
+    dbus_message_iter_close_container(&filter, &globs);
+    dbus_message_iter_close_container(&list, &filter);
+  }
+
+  dbus_message_iter_close_container(&variant, &list);
+  pick__portal_dict_end(dict, &entry, &variant);
+}
+
+static DBusMessage* pick__portal_file_chooser_call(pick__req_kind_t kind, const PickFileOptions* opts,
+                                                  const char* token) {
+  bool is_dir = kind == PICK_REQ_OPEN_DIR_SINGLE || kind == PICK_REQ_OPEN_DIR_MULTI;
+  DBusMessage* msg = dbus_message_new_method_call(PICK_PORTAL_BUS_NAME, PICK_PORTAL_OBJECT_PATH,
+                                                  PICK_PORTAL_FILE_CHOOSER,
+                                                  kind == PICK_REQ_SAVE ? "SaveFile" : "OpenFile");
+  if (!msg) return NULL;
+
+  const char* parent = (opts && opts->parent_handle) ? (const char*)opts->parent_handle : "";
+  const char* title  = (opts && opts->title) ? opts->title
+                     : kind == PICK_REQ_SAVE ? "Save File"
+                     : is_dir ? "Open Folder" : "Open File";
+
+  DBusMessageIter args, dict;
+  dbus_message_iter_init_append(msg, &args);
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_STRING, &parent);
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_STRING, &title);
+  dbus_message_iter_open_container(&args, DBUS_TYPE_ARRAY, "{sv}", &dict);
+
+  pick__portal_dict_string(&dict, "handle_token", token);
+  pick__portal_dict_bool(&dict, "modal", opts && opts->parent_handle);
+  if (kind == PICK_REQ_SAVE) {
+    if (opts && opts->default_name) pick__portal_dict_string(&dict, "current_name", opts->default_name);
+  } else {
+    pick__portal_dict_bool(&dict, "multiple", kind == PICK_REQ_OPEN_MULTI || kind == PICK_REQ_OPEN_DIR_MULTI);
+    pick__portal_dict_bool(&dict, "directory", is_dir);
+  }
+  if (opts && opts->default_path && *opts->default_path) {
+    pick__portal_dict_path(&dict, "current_folder", opts->default_path);
+  }
+  if (!is_dir && opts && opts->filters && opts->filter_count > 0) {
+    pick__portal_dict_filters(&dict, opts);
+  }
+
+  dbus_message_iter_close_container(&args, &dict);
+  return msg;
+}
+
+static PickRequest pick__portal_file_chooser(pick__req_kind_t kind, const PickFileOptions* opts,
+                                             PickFileCallback single_cb, PickMultiFileCallback multi_cb, void* ud) {
+  pick__portal_req_t* req = (pick__portal_req_t*)PICK_CALLOC(1, sizeof(pick__portal_req_t));
+  if (!req) { if (single_cb) single_cb(NULL, ud); if (multi_cb) multi_cb(NULL, 0, ud); return PICK_REQUEST_NONE; }
+  *req = (pick__portal_req_t){ .kind = kind, .single_cb = single_cb, .multi_cb = multi_cb, .user = ud,
+                               .id = pick__next_request(), .deadline_ms = pick__deadline_ms(opts ? opts->timeout_ms : 0) };
+
+  char token[32];
+  snprintf(token, sizeof(token), "pick%u", ++pick__g_portal_token);
+
+  DBusMessage* msg = NULL;
+  bool sent = false;
+  if (pick__portal_bus()) {
+    req->handle = pick__portal_request_path(token);
+    msg = pick__portal_file_chooser_call(kind, opts, token);
+    sent = msg && pick__portal_send(msg, req);
+  }
+  if (msg) dbus_message_unref(msg);
+
+  if (!sent) {
+    pick__portal_deliver(req, NULL, 0);
+    pick__portal_free_req(req);
+    return PICK_REQUEST_NONE;
+  }
+  return req->id;
+}
+
+static const char* pick__portal_style_icon(PickMessageStyle s) {
+  switch (s) {
+    case PICK_STYLE_WARNING: return "dialog-warning";
+    case PICK_STYLE_ERROR:   return "dialog-error";
+    case PICK_STYLE_QUESTION:return "dialog-question";
+    case PICK_STYLE_INFO:
+    default:                 return "dialog-information";
+  }
+}
+
+// Notify(app_name s, replaces_id u, app_icon s, summary s, body s, actions as,
+//        hints a{sv}, expire_timeout i) -> id u
+static DBusMessage* pick__portal_notify_call(const PickMessageOptions* opts) {
+  DBusMessage* msg = dbus_message_new_method_call(PICK_NOTIFY_BUS_NAME, PICK_NOTIFY_OBJECT_PATH,
+                                                  PICK_NOTIFY_BUS_NAME, "Notify");
+  if (!msg) return NULL;
+
+  PickButtonType btns = opts ? opts->buttons : PICK_BUTTON_OK;
+  PickMessageStyle style = opts ? opts->style : PICK_STYLE_INFO;
+
+  const char* app_name = "";
+  dbus_uint32_t replaces = 0;
+  const char* icon = (opts && opts->icon_type == PICK_ICON_CUSTOM && opts->icon_path && *opts->icon_path)
+                     ? opts->icon_path : pick__portal_style_icon(style);
+  const char* summary = (opts && opts->title) ? opts->title : "Message";
+
+  char* body_buf = NULL;
+  const char* body = (opts && opts->message) ? opts->message : "";
+  if (opts && opts->detail && *opts->detail) {
+    size_t cap = strlen(body) + 2 + strlen(opts->detail) + 1;
+    body_buf = (char*)PICK_MALLOC(cap);
+    if (body_buf) { snprintf(body_buf, cap, "%s\n\n%s", body, opts->detail); body = body_buf; }
+  }
+
+  static const char* const ok[]            = { "ok", "OK" };
+  static const char* const ok_cancel[]     = { "ok", "OK", "cancel", "Cancel" };
+  static const char* const yes_no[]        = { "yes", "Yes", "no", "No" };
+  static const char* const yes_no_cancel[] = { "yes", "Yes", "no", "No", "cancel", "Cancel" };
+  const char* const* actions = ok;
+  int action_count = 2;
+  switch (btns) {
+    case PICK_BUTTON_OK:            actions = ok;            action_count = 2; break;
+    case PICK_BUTTON_OK_CANCEL:     actions = ok_cancel;     action_count = 4; break;
+    case PICK_BUTTON_YES_NO:        actions = yes_no;        action_count = 4; break;
+    case PICK_BUTTON_YES_NO_CANCEL: actions = yes_no_cancel; action_count = 6; break;
+  }
+
+  DBusMessageIter args, list, hints;
+  dbus_message_iter_init_append(msg, &args);
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_STRING, &app_name);
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_UINT32, &replaces);
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_STRING, &icon);
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_STRING, &summary);
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_STRING, &body);
+
+  dbus_message_iter_open_container(&args, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING_AS_STRING, &list);
+  for (int i = 0; i < action_count; i++) dbus_message_iter_append_basic(&list, DBUS_TYPE_STRING, &actions[i]);
+  dbus_message_iter_close_container(&args, &list);
+
+  dbus_message_iter_open_container(&args, DBUS_TYPE_ARRAY, "{sv}", &hints);
+  pick__portal_dict_byte(&hints, "urgency", style == PICK_STYLE_ERROR ? 2 : 1);
+  pick__portal_dict_bool(&hints, "resident", true);
+  dbus_message_iter_close_container(&args, &hints);
+
+  dbus_int32_t expire = 0;
+  dbus_message_iter_append_basic(&args, DBUS_TYPE_INT32, &expire);
+
+  PICK_FREE(body_buf);
+  return msg;
+}
+
+PickRequest pick__file_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__portal_file_chooser(PICK_REQ_OPEN_SINGLE, options, cb, NULL, ud);
+}
+
+PickRequest pick__files_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  return pick__portal_file_chooser(PICK_REQ_OPEN_MULTI, options, NULL, cb, ud);
+}
+
+PickRequest pick__folder_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__portal_file_chooser(PICK_REQ_OPEN_DIR_SINGLE, options, cb, NULL, ud);
+}
+
+PickRequest pick__folders_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  return pick__portal_file_chooser(PICK_REQ_OPEN_DIR_MULTI, options, NULL, cb, ud);
+}
+
+PickRequest pick__save_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  return pick__portal_file_chooser(PICK_REQ_SAVE, options, cb, NULL, ud);
+}
+
+// Every notification is tracked, even without a callback, so that
+// pick_cancel() can close it.
+PickRequest pick__message_impl(const PickMessageOptions *opts, PickMessageCallback cb, void *ud) {
+  if (!pick__portal_bus()) { if (cb) cb(PICK_RESULT_CLOSED, ud); return PICK_REQUEST_NONE; }
+
+  DBusMessage* msg = pick__portal_notify_call(opts);
+  if (!msg) { if (cb) cb(PICK_RESULT_CLOSED, ud); return PICK_REQUEST_NONE; }
+
+  pick__portal_req_t* req = (pick__portal_req_t*)PICK_CALLOC(1, sizeof(pick__portal_req_t));
+  if (req) {
+    *req = (pick__portal_req_t){ .kind = PICK_REQ_MESSAGE, .msg_cb = cb, .user = ud,
+                                 .button_type = opts ? opts->buttons : PICK_BUTTON_OK,
+                                 .id = pick__next_request(), .deadline_ms = pick__deadline_ms(opts ? opts->timeout_ms : 0) };
+  }
+  PickRequest id = req ? req->id : PICK_REQUEST_NONE;
+  if (!req || !pick__portal_send(msg, req)) {
+    PICK_FREE(req);
+    if (cb) cb(PICK_RESULT_CLOSED, ud);
+    id = PICK_REQUEST_NONE;
+  }
+  dbus_message_unref(msg);
+  return id;
+}
+
+bool pick__cancel_impl(PickRequest request) {
+  for (pick__portal_req_t* r = pick__g_portal_reqs; r; r = r->next) {
+    if (r->id == request) { pick__portal_cancel(r); return true; }
+  }
+  return false;
+}
+
+void pick_poll(void) {
+  if (!pick__g_bus) return;
+  if (pick__g_portal_timer >= 0) {
+    uint64_t expirations;
+    ssize_t got = read(pick__g_portal_timer, &expirations, sizeof(expirations));
+    (void)got;
+  }
+  dbus_connection_read_write(pick__g_bus, 0);
+  while (dbus_connection_dispatch(pick__g_bus) == DBUS_DISPATCH_DATA_REMAINS) {}
+
+  // Restart after every expiry: the callback may have cancelled other requests.
+  double now = pick__now_ms();
+  for (pick__portal_req_t* r = pick__g_portal_reqs; r;) {
+    if (r->deadline_ms > 0 && now >= r->deadline_ms) { pick__portal_cancel(r); r = pick__g_portal_reqs; continue; }
+    r = r->next;
+  }
+
+  if (!dbus_connection_get_is_connected(pick__g_bus)) {
+    DBusConnection* bus = pick__g_bus;
+    int fd = -1;
+    if (pick__g_portal_epoll >= 0 && dbus_connection_get_unix_fd(bus, &fd)) {
+      epoll_ctl(pick__g_portal_epoll, EPOLL_CTL_DEL, fd, NULL);
+    }
+    pick__g_bus = NULL;
+    pick__portal_fail_all();
+    dbus_connection_close(bus);
+    dbus_connection_unref(bus);
+  }
+  pick__portal_arm_timer();
+}
+
+int pick_poll_fd(void) {
+  int fd = -1;
+  if (!pick__portal_bus()) return -1;
+  if (pick__g_portal_epoll >= 0) return pick__g_portal_epoll;
+  dbus_connection_get_unix_fd(pick__g_bus, &fd);
+  return fd;
+}
+
+#endif
+
+#if defined(PICK_PLATFORM_EMSCRIPTEN) || defined(PICK_PLATFORM_HEADLESS)
+
+// Request table and result delivery shared by the web and headless backends.
+// Results always re-enter C through pick__deliver_*, so the headless backend
+// exercises the same bookkeeping the browser glue does.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef PICK_PLATFORM_EMSCRIPTEN
+#include <emscripten/emscripten.h>
+#endif
+
+#ifndef EMSCRIPTEN_KEEPALIVE
+#define EMSCRIPTEN_KEEPALIVE
+#endif
+
+#ifndef PICK_EM_MAX_REQUESTS
+#define PICK_EM_MAX_REQUESTS 64
+#endif
+
+typedef enum {
+  PICK_REQ_NONE = 0,
+  PICK_REQ_OPEN_SINGLE,
+  PICK_REQ_OPEN_MULTI,
+  PICK_REQ_OPEN_DIR_SINGLE,
+  PICK_REQ_OPEN_DIR_MULTI,
+  PICK_REQ_SAVE,
+  PICK_REQ_MESSAGE,
+  PICK_REQ_EXPORT,
+  PICK_REQ_RESYNC
+} pick__req_kind_t;
+
+typedef struct {
+  pick__req_kind_t       kind;
+  PickFileCallback      single_cb;
+  PickMultiFileCallback multi_cb;
+  PickMessageCallback   msg_cb;
+  PickResultCallback    result_cb;
+  PickProgressCallback  progress_cb;
+  PickResyncCallback    resync_cb;
+  void*                 user;
+  PickButtonType        button_type;
+} pick__em_req_t;
+
+// Requests live in a growable slab threaded with a free list. A request id
+// packs the slot index (plus one, so 0 stays invalid) with the slot's
+// generation, which is bumped on every release; a late delivery for a
+// recycled slot therefore fails the generation check instead of reaching the
+// newer request.
+#define PICK__REQ_INDEX_BITS 20
+#define PICK__REQ_INDEX_MASK ((1u << PICK__REQ_INDEX_BITS) - 1)
+#define PICK__REQ_GEN_MASK   0x7FFu
+#define PICK__REQ_MAX        ((int)PICK__REQ_INDEX_MASK)
+#define PICK__REQ_SLOT_USED  (-2)
+
+typedef struct {
+  pick__em_req_t req;
+  unsigned       gen;
+  int            next_free;  ///< Next free slot, -1 at the end, PICK__REQ_SLOT_USED while live
+} pick__req_slot_t;
+
+static pick__req_slot_t* pick__g_reqs;
+static int pick__g_req_cap;
+static int pick__g_req_free = -1;
+static int pick__g_req_live;
+
+static bool pick__grow_reqs(void) {
+  int cap = pick__g_req_cap ? pick__g_req_cap * 2 : PICK_EM_MAX_REQUESTS;
+  if (cap > PICK__REQ_MAX) cap = PICK__REQ_MAX;
+  if (cap <= pick__g_req_cap) return false;
+
+  pick__req_slot_t* slots = (pick__req_slot_t*)PICK_REALLOC(pick__g_reqs, sizeof(pick__req_slot_t) * (size_t)cap);
+  if (!slots) return false;
+  for (int i = cap - 1; i >= pick__g_req_cap; i--) {
+    slots[i] = (pick__req_slot_t){ .next_free = pick__g_req_free };
+    pick__g_req_free = i;
+  }
+  pick__g_reqs = slots;
+  pick__g_req_cap = cap;
+  return true;
+}
+
+static int pick__alloc_req(void) {
+  if (pick__g_req_free < 0 && !pick__grow_reqs()) return 0;
+  int idx = pick__g_req_free;
+  pick__req_slot_t* slot = &pick__g_reqs[idx];
+  pick__g_req_free = slot->next_free;
+  slot->next_free = PICK__REQ_SLOT_USED;
+  slot->req = (pick__em_req_t){0};
+  pick__g_req_live++;
+  return (int)(((slot->gen & PICK__REQ_GEN_MASK) << PICK__REQ_INDEX_BITS) | (unsigned)(idx + 1));
+}
+
+/// Returns the live request for `id`, or NULL if it was never issued or is stale.
+static pick__em_req_t* pick__req(int id) {
+  if (id <= 0) return NULL;
+  int idx = (int)((unsigned)id & PICK__REQ_INDEX_MASK) - 1;
+  unsigned gen = ((unsigned)id >> PICK__REQ_INDEX_BITS) & PICK__REQ_GEN_MASK;
+  if (idx < 0 || idx >= pick__g_req_cap) return NULL;
+  pick__req_slot_t* slot = &pick__g_reqs[idx];
+  if (slot->next_free != PICK__REQ_SLOT_USED || (slot->gen & PICK__REQ_GEN_MASK) != gen) return NULL;
+  return &slot->req;
+}
+
+static void pick__clear_req(int id) {
+  if (!pick__req(id)) return;
+  int idx = (int)((unsigned)id & PICK__REQ_INDEX_MASK) - 1;
+  pick__req_slot_t* slot = &pick__g_reqs[idx];
+  slot->req = (pick__em_req_t){0};
+  slot->gen++;
+  slot->next_free = pick__g_req_free;
+  pick__g_req_free = idx;
+  pick__g_req_live--;
+}
+
+// Stops whatever the backend still runs for a request (dialog, import, timer)
+// before pick_cancel() reports it as cancelled.
+static void pick__cancel_work(int id);
 
 static void pick__build_accept_string(const PickFileOptions* opts, char* out, size_t cap) {
   if (!out || cap == 0) return;
   out[0] = 0;
   if (!opts || !opts->filters || opts->filter_count <= 0) return;
 
-  size_t used = 0;
-  for (int i = 0; i < opts->filter_count; i++) {
-    const PickFilter* f = &opts->filters[i];
-    for (int j = 0; j < f->extension_count; j++) {
-      const char* ext = f->extensions[j];
-      if (!ext || !*ext) continue;
-      char piece[128];
-      int n = snprintf(piece, sizeof(piece), ".%s", ext);
-      if (n <= 0) continue;
-      if (used > 0 && used + 1 < cap) { out[used++] = ','; out[used] = 0; }
-      if (used + (size_t)n + 1 >= cap) return;
-      memcpy(out + used, piece, (size_t)n);
-      used += (size_t)n;
-      out[used] = 0;
+  size_t used = 0;
+  for (int i = 0; i < opts->filter_count; i++) {
+    const PickFilter* f = &opts->filters[i];
+    for (int j = 0; j < f->extension_count; j++) {
+      const char* ext = f->extensions[j];
+      if (!ext || !*ext) continue;
+      char piece[128];
+      int n = snprintf(piece, sizeof(piece), ".%s", ext);
+      if (n <= 0) continue;
+      if (used > 0 && used + 1 < cap) { out[used++] = ','; out[used] = 0; }
+      if (used + (size_t)n + 1 >= cap) return;
+      memcpy(out + used, piece, (size_t)n);
+      used += (size_t)n;
+      out[used] = 0;
+    }
+  }
+}
+
+// Multi-path results cross from the glue as one pick__result_alloc() block:
+//
+//   u32 count | u32 0 | count pointer slots of 8 bytes |
+//   per path: u32 byte length, the UTF-8 bytes, a NUL
+//
+// Integers are little-endian. pick__deliver_multi_buf() points the slots at
+// the strings in place, so C never splits or copies a path and names may
+// contain any byte but NUL.
+#define PICK__RESULT_HEADER 8
+#define PICK__RESULT_SLOT   8
+
+static uint32_t pick__result_u32(const unsigned char* p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void pick__result_put_u32(unsigned char* p, uint32_t v) {
+  p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); p[2] = (unsigned char)(v >> 16); p[3] = (unsigned char)(v >> 24);
+}
+
+// Validates a result block and fills its pointer slots. Returns the path
+// table, or NULL (count 0) when the block is empty or malformed.
+static char** pick__result_index(unsigned char* buf, size_t size, int* out_count) {
+  *out_count = 0;
+  if (!buf || size < PICK__RESULT_HEADER) return NULL;
+  uint32_t count = pick__result_u32(buf);
+  if (count == 0 || count > (size - PICK__RESULT_HEADER) / PICK__RESULT_SLOT) return NULL;
+
+  char** table = (char**)(void*)(buf + PICK__RESULT_HEADER);
+  size_t off = PICK__RESULT_HEADER + (size_t)count * PICK__RESULT_SLOT;
+  for (uint32_t i = 0; i < count; i++) {
+    if (size - off < 5) return NULL;
+    size_t len = pick__result_u32(buf + off);
+    off += 4;
+    if (len >= size - off || buf[off + len] != 0) return NULL;
+    table[i] = (char*)buf + off;
+    off += len + 1;
+  }
+  *out_count = (int)count;
+  return table;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Allocates a result block for the glue; pick__deliver_multi_buf() frees it.
+EMSCRIPTEN_KEEPALIVE
+void* pick__result_alloc(int size) {
+  return size > 0 ? PICK_MALLOC((size_t)size) : NULL;
+}
+
+/// Lets long-running glue (imports, exports) notice that its request was cancelled.
+EMSCRIPTEN_KEEPALIVE
+int pick__req_alive(int id) {
+  return pick__req(id) != NULL;
+}
+
+/// Reports import progress; returns 0 once the request is gone, including when
+/// the callback just aborted it, so the glue stops copying.
+EMSCRIPTEN_KEEPALIVE
+int pick__deliver_progress(int id, int files_done, int files_total, double bytes_done, double bytes_total) {
+  pick__em_req_t* req = pick__req(id);
+  if (!req) return 0;
+  if (!req->progress_cb) return 1;
+  bool keep = req->progress_cb(files_done, files_total, (unsigned long long)bytes_done,
+                               (unsigned long long)bytes_total, req->user);
+  if (!keep) pick_cancel(id);
+  return pick__req(id) != NULL;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void pick__deliver_single(int id, const char* path) {
+  pick__em_req_t* live = pick__req(id);
+  if (!live) return;
+  pick__em_req_t req = *live;
+  pick__clear_req(id);
+
+  switch (req.kind) {
+    case PICK_REQ_OPEN_SINGLE:
+    case PICK_REQ_OPEN_DIR_SINGLE:
+    case PICK_REQ_SAVE:
+      if (req.single_cb) req.single_cb(path, req.user);
+      break;
+    case PICK_REQ_OPEN_MULTI:
+    case PICK_REQ_OPEN_DIR_MULTI:
+      if (req.multi_cb) req.multi_cb(NULL, 0, req.user);
+      break;
+    case PICK_REQ_MESSAGE:
+      if (req.msg_cb) req.msg_cb(PICK_RESULT_OK, req.user);
+      break;
+    case PICK_REQ_RESYNC:
+      if (req.resync_cb) req.resync_cb(false, NULL, NULL, 0, req.user);
+      break;
+    default: break;
+  }
+}
+
+// A resync's records start with '+', '~' or '-' for added, modified and removed.
+static void pick__deliver_changes(pick__em_req_t* req, char** paths, int count) {
+  PickChangeKind* kinds = count > 0 ? (PickChangeKind*)PICK_MALLOC(sizeof(PickChangeKind) * (size_t)count) : NULL;
+  if (count > 0 && !kinds) { req->resync_cb(false, NULL, NULL, 0, req->user); return; }
+  for (int i = 0; i < count; i++) {
+    char c = paths[i][0];
+    kinds[i] = c == '+' ? PICK_CHANGE_ADDED : c == '-' ? PICK_CHANGE_REMOVED : PICK_CHANGE_MODIFIED;
+    if (c) paths[i]++;
+  }
+  req->resync_cb(true, count > 0 ? (const char**)paths : NULL, kinds, count, req->user);
+  PICK_FREE(kinds);
+}
+
+/// Takes ownership of `buf`, a result block from pick__result_alloc().
+EMSCRIPTEN_KEEPALIVE
+void pick__deliver_multi_buf(int id, unsigned char* buf, int size) {
+  pick__em_req_t* live = pick__req(id);
+  if (!live) { PICK_FREE(buf); return; }
+  pick__em_req_t req = *live;
+  pick__clear_req(id);
+
+  int count = 0;
+  char** paths = pick__result_index(buf, size > 0 ? (size_t)size : 0, &count);
+  if (req.kind == PICK_REQ_RESYNC) { if (req.resync_cb) pick__deliver_changes(&req, paths, count); }
+  else if (req.multi_cb) req.multi_cb(count > 0 ? (const char**)paths : NULL, count, req.user);
+  else if (req.single_cb) req.single_cb(count > 0 ? paths[0] : NULL, req.user);
+  PICK_FREE(buf);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void pick__deliver_msg(int id, int button_idx) {
+  pick__em_req_t* live = pick__req(id);
+  if (!live) return;
+  pick__em_req_t req = *live;
+  pick__clear_req(id);
+
+  if (req.kind == PICK_REQ_MESSAGE) {
+    if (req.msg_cb) {
+      PickButtonResult result = PICK_RESULT_CLOSED;
+      
+      switch (req.button_type) {
+        case PICK_BUTTON_OK:
+          result = (button_idx == 0) ? PICK_RESULT_OK : PICK_RESULT_CLOSED;
+          break;
+          
+        case PICK_BUTTON_OK_CANCEL:
+          if (button_idx == 0) result = PICK_RESULT_CANCEL;
+          else if (button_idx == 1) result = PICK_RESULT_OK;
+          break;
+          
+        case PICK_BUTTON_YES_NO:
+          if (button_idx == 0) result = PICK_RESULT_NO;
+          else if (button_idx == 1) result = PICK_RESULT_YES;
+          break;
+          
+        case PICK_BUTTON_YES_NO_CANCEL:
+          if (button_idx == 0) result = PICK_RESULT_CANCEL;
+          else if (button_idx == 1) result = PICK_RESULT_NO;
+          else if (button_idx == 2) result = PICK_RESULT_YES;
+          break;
+          
+        default:
+          result = PICK_RESULT_CLOSED;
+          break;
+      }
+      
+      req.msg_cb(result, req.user);
+    }
+    return;
+  }
+  if (req.kind == PICK_REQ_EXPORT) {
+    if (req.result_cb) req.result_cb(button_idx == 0, req.user);
+    return;
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+bool pick__cancel_impl(PickRequest request) {
+  pick__em_req_t* req = pick__req(request);
+  if (!req) return false;
+  pick__req_kind_t kind = req->kind;
+  pick__cancel_work(request);
+  if (kind == PICK_REQ_MESSAGE || kind == PICK_REQ_EXPORT) pick__deliver_msg(request, -1);
+  else pick__deliver_single(request, NULL);
+  return true;
+}
+
+#endif
+
+#ifdef PICK_PLATFORM_HEADLESS
+
+#include <ctype.h>
+
+typedef enum {
+  PICK_HEADLESS_CANCEL,
+  PICK_HEADLESS_PATHS,
+  PICK_HEADLESS_BUTTON
+} pick__headless_kind_t;
+
+/// A scripted answer waiting for a request, or a result waiting for its due time.
+typedef struct {
+  pick__headless_kind_t kind;
+  unsigned char*        result;  ///< Result block (PICK_HEADLESS_PATHS), see pick__result_index()
+  size_t                result_size;
+  PickButtonResult      button;
+  unsigned              delay_ms;
+  int                   req_id;
+  double                due_ms;
+  unsigned              seq;     ///< Order of queueing into pick__g_results
+} pick__headless_item_t;
+
+typedef struct {
+  pick__headless_item_t* items;
+  int                    head;
+  int                    count;
+  int                    cap;
+} pick__headless_queue_t;
+
+static pick__headless_queue_t pick__g_script;
+static pick__headless_queue_t pick__g_results;
+static unsigned               pick__g_result_seq;
+
+static bool pick__headless_push(pick__headless_queue_t* q, pick__headless_item_t item) {
+  if (q->count == q->cap) {
+    int cap = q->cap ? q->cap * 2 : 64;
+    pick__headless_item_t* items = (pick__headless_item_t*)PICK_MALLOC(sizeof(pick__headless_item_t) * (size_t)cap);
+    if (!items) return false;
+    for (int i = 0; i < q->count; i++) items[i] = q->items[(q->head + i) % q->cap];
+    PICK_FREE(q->items);
+    q->items = items;
+    q->head = 0;
+    q->cap = cap;
+  }
+  q->items[(q->head + q->count) % q->cap] = item;
+  q->count++;
+  return true;
+}
+
+static bool pick__headless_pop(pick__headless_queue_t* q, pick__headless_item_t* out) {
+  if (!q->count) return false;
+  *out = q->items[q->head];
+  q->head = (q->head + 1) % q->cap;
+  q->count--;
+  return true;
+}
+
+static void pick__headless_clear(pick__headless_queue_t* q) {
+  pick__headless_item_t item;
+  while (pick__headless_pop(q, &item)) PICK_FREE(item.result);
+}
+
+// ".png,.jpg" accept list from pick__build_accept_string(), matched case-insensitively.
+static bool pick__headless_accepts(const char* accept, const char* path, size_t len) {
+  if (!accept || !*accept) return true;
+  const char* dot = NULL;
+  for (size_t i = len; i > 0; i--) {
+    if (path[i - 1] == '/') break;
+    if (path[i - 1] == '.') { dot = path + i - 1; break; }
+  }
+  if (!dot) return false;
+  size_t ext_len = (size_t)(path + len - dot);
+
+  for (const char* p = accept; *p;) {
+    const char* end = strchr(p, ',');
+    size_t n = end ? (size_t)(end - p) : strlen(p);
+    if (n == ext_len) {
+      size_t k = 0;
+      while (k < n && tolower((unsigned char)p[k]) == tolower((unsigned char)dot[k])) k++;
+      if (k == n) return true;
+    }
+    p += n;
+    if (*p == ',') p++;
+  }
+  return false;
+}
+
+// Encodes paths the way the web glue does; NULL and empty entries are skipped.
+static unsigned char* pick__headless_build_result(const char* const* paths, int count, size_t* out_size) {
+  *out_size = 0;
+  uint32_t kept = 0;
+  size_t size = PICK__RESULT_HEADER;
+  for (int i = 0; paths && i < count; i++) {
+    if (paths[i] && *paths[i]) { size += 4 + strlen(paths[i]) + 1; kept++; }
+  }
+  if (!kept) return NULL;
+  size += (size_t)kept * PICK__RESULT_SLOT;
+
+  unsigned char* buf = (unsigned char*)pick__result_alloc((int)size);
+  if (!buf) return NULL;
+  pick__result_put_u32(buf, kept);
+  pick__result_put_u32(buf + 4, 0);
+  memset(buf + PICK__RESULT_HEADER, 0, (size_t)kept * PICK__RESULT_SLOT);
+  size_t off = PICK__RESULT_HEADER + (size_t)kept * PICK__RESULT_SLOT;
+  for (int i = 0; i < count; i++) {
+    if (!paths[i] || !*paths[i]) continue;
+    size_t len = strlen(paths[i]);
+    pick__result_put_u32(buf + off, (uint32_t)len);
+    memcpy(buf + off + 4, paths[i], len + 1);
+    off += 4 + len + 1;
+  }
+  *out_size = size;
+  return buf;
+}
+
+// Drops paths rejected by the request's filters by re-encoding the survivors.
+static void pick__headless_filter(pick__headless_item_t* item, const char* accept) {
+  int count = 0;
+  char** paths = pick__result_index(item->result, item->result_size, &count);
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    if (pick__headless_accepts(accept, paths[i], strlen(paths[i]))) paths[kept++] = paths[i];
+  }
+  if (kept == count && count > 0) return;
+
+  size_t size = 0;
+  unsigned char* filtered = kept ? pick__headless_build_result((const char* const*)paths, kept, &size) : NULL;
+  PICK_FREE(item->result);
+  item->result = filtered;
+  item->result_size = size;
+}
+
+// Index of the web dialog button that pick__deliver_msg() maps back to `result`.
+static int pick__headless_button_index(PickButtonType buttons, PickButtonResult result) {
+  switch (buttons) {
+    case PICK_BUTTON_OK:
+      return result == PICK_RESULT_OK ? 0 : -1;
+    case PICK_BUTTON_OK_CANCEL:
+      return result == PICK_RESULT_CANCEL ? 0 : result == PICK_RESULT_OK ? 1 : -1;
+    case PICK_BUTTON_YES_NO:
+      return result == PICK_RESULT_NO ? 0 : result == PICK_RESULT_YES ? 1 : -1;
+    case PICK_BUTTON_YES_NO_CANCEL:
+      return result == PICK_RESULT_CANCEL ? 0 : result == PICK_RESULT_NO ? 1 : result == PICK_RESULT_YES ? 2 : -1;
+  }
+  return -1;
+}
+
+// Pairs a new request with the next scripted answer and schedules delivery.
+// An answer scripted to arrive after the request's timeout becomes a cancel
+// at the timeout instead.
+static PickRequest pick__headless_request(int id, const PickFileOptions* opts, bool is_message, unsigned timeout_ms) {
+  pick__headless_item_t item;
+  if (!pick__headless_pop(&pick__g_script, &item)) item = (pick__headless_item_t){ .kind = PICK_HEADLESS_CANCEL };
+
+  if (is_message && item.kind == PICK_HEADLESS_PATHS) { PICK_FREE(item.result); item.result = NULL; item.kind = PICK_HEADLESS_CANCEL; }
+  if (!is_message && item.kind == PICK_HEADLESS_BUTTON) item.kind = PICK_HEADLESS_CANCEL;
+
+  pick__req_kind_t kind = pick__req(id)->kind;
+  if (item.kind == PICK_HEADLESS_PATHS && (kind == PICK_REQ_OPEN_SINGLE || kind == PICK_REQ_OPEN_MULTI)) {
+    char accept[512];
+    pick__build_accept_string(opts, accept, sizeof(accept));
+    pick__headless_filter(&item, accept);
+    if (!item.result) item.kind = PICK_HEADLESS_CANCEL;
+  }
+
+  if (timeout_ms && item.delay_ms > timeout_ms) {
+    PICK_FREE(item.result);
+    item = (pick__headless_item_t){ .kind = PICK_HEADLESS_CANCEL, .delay_ms = timeout_ms };
+  }
+
+  item.req_id = id;
+  item.due_ms = item.delay_ms ? pick__now_ms() + item.delay_ms : 0;
+  item.seq = ++pick__g_result_seq;
+  if (!pick__headless_push(&pick__g_results, item)) {
+    PICK_FREE(item.result);
+    if (is_message) pick__deliver_msg(id, -1);
+    else pick__deliver_single(id, NULL);
+    return PICK_REQUEST_NONE;
+  }
+  return id;
+}
+
+static void pick__cancel_work(int id) {
+  pick__headless_queue_t* q = &pick__g_results;
+  int kept = 0;
+  for (int i = 0; i < q->count; i++) {
+    pick__headless_item_t item = q->items[(q->head + i) % q->cap];
+    if (item.req_id == id) { PICK_FREE(item.result); continue; }
+    q->items[(q->head + kept++) % q->cap] = item;
+  }
+  q->count = kept;
+}
+
+static void pick__headless_deliver(pick__headless_item_t* item) {
+  pick__em_req_t* req = pick__req(item->req_id);
+  if (!req) { PICK_FREE(item->result); return; }
+  switch (item->kind) {
+    case PICK_HEADLESS_PATHS:
+      if (req->kind == PICK_REQ_OPEN_MULTI || req->kind == PICK_REQ_OPEN_DIR_MULTI) {
+        pick__deliver_multi_buf(item->req_id, item->result, (int)item->result_size);
+        item->result = NULL;
+      } else {
+        int count = 0;
+        char** paths = pick__result_index(item->result, item->result_size, &count);
+        pick__deliver_single(item->req_id, count > 0 ? paths[0] : NULL);
+      }
+      break;
+    case PICK_HEADLESS_BUTTON:
+      pick__deliver_msg(item->req_id, pick__headless_button_index(req->button_type, item->button));
+      break;
+    case PICK_HEADLESS_CANCEL:
+    default:
+      if (req->kind == PICK_REQ_MESSAGE) pick__deliver_msg(item->req_id, -1);
+      else pick__deliver_single(item->req_id, NULL);
+      break;
+  }
+  PICK_FREE(item->result);
+}
+
+void pick_headless_push_paths(const char *const *paths, int count, unsigned delay_ms) {
+  size_t size = 0;
+  unsigned char* result = pick__headless_build_result(paths, count, &size);
+  if (!result) { pick_headless_push_cancel(delay_ms); return; }
+
+  pick__headless_item_t item = { .kind = PICK_HEADLESS_PATHS, .result = result, .result_size = size, .delay_ms = delay_ms };
+  if (!pick__headless_push(&pick__g_script, item)) PICK_FREE(result);
+}
+
+void pick_headless_push_cancel(unsigned delay_ms) {
+  pick__headless_push(&pick__g_script, (pick__headless_item_t){ .kind = PICK_HEADLESS_CANCEL, .delay_ms = delay_ms });
+}
+
+void pick_headless_push_button(PickButtonResult result, unsigned delay_ms) {
+  pick__headless_push(&pick__g_script, (pick__headless_item_t){ .kind = PICK_HEADLESS_BUTTON, .button = result, .delay_ms = delay_ms });
+}
+
+void pick_headless_reset(void) {
+  pick__headless_item_t item;
+  while (pick__headless_pop(&pick__g_results, &item)) {
+    pick__clear_req(item.req_id);
+    PICK_FREE(item.result);
+  }
+  pick__headless_clear(&pick__g_script);
+}
+
+int pick_headless_pending(void) {
+  return pick__g_results.count;
+}
+
+void pick_poll(void) {
+  // Only results queued before this call are delivered, so callbacks that
+  // issue new requests are answered on the next poll, like a real dialog.
+  // The snapshot is by sequence number: cancels in a callback compact the
+  // queue, so newer results can move into the first `n` slots. Popping `n`
+  // times still visits every older result, since new ones and re-queued
+  // ones only ever go to the back.
+  unsigned last = pick__g_result_seq;
+  int n = pick__g_results.count;
+  double now = 0;
+  for (int i = 0; i < n; i++) {
+    pick__headless_item_t item;
+    if (!pick__headless_pop(&pick__g_results, &item)) break;
+    bool later = (int)(item.seq - last) > 0;
+    if (!later && item.due_ms > 0) {
+      if (now == 0) now = pick__now_ms();
+      later = item.due_ms > now;
+    }
+    if (later) { pick__headless_push(&pick__g_results, item); continue; }
+    pick__headless_deliver(&item);
+  }
+}
+
+int pick_poll_fd(void) {
+  return -1;
+}
+
+PickRequest pick__file_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_SINGLE, .single_cb = cb, .user = ud };
+  return pick__headless_request(id, options, false, options ? options->timeout_ms : 0);
+}
+
+PickRequest pick__files_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, 0, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_MULTI, .multi_cb = cb, .user = ud };
+  return pick__headless_request(id, options, false, options ? options->timeout_ms : 0);
+}
+
+PickRequest pick__folder_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_DIR_SINGLE, .single_cb = cb, .user = ud };
+  return pick__headless_request(id, options, false, options ? options->timeout_ms : 0);
+}
+
+PickRequest pick__folders_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, 0, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_DIR_MULTI, .multi_cb = cb, .user = ud };
+  return pick__headless_request(id, options, false, options ? options->timeout_ms : 0);
+}
+
+PickRequest pick__save_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_SAVE, .single_cb = cb, .user = ud };
+  return pick__headless_request(id, options, false, options ? options->timeout_ms : 0);
+}
+
+PickRequest pick__message_impl(const PickMessageOptions *opts, PickMessageCallback cb, void *ud) {
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(PICK_RESULT_CLOSED, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){
+    .kind = PICK_REQ_MESSAGE,
+    .msg_cb = cb,
+    .user = ud,
+    .button_type = opts ? opts->buttons : PICK_BUTTON_OK
+  };
+  return pick__headless_request(id, NULL, true, opts ? opts->timeout_ms : 0);
+}
+
+#endif
+
+#ifdef PICK_PLATFORM_EMSCRIPTEN
+
+#include <emscripten/emscripten.h>
+#include <stdint.h>
+
+#ifndef PICK_EM_BASE_PICKED
+#define PICK_EM_BASE_PICKED "/picked"
+#endif
+
+#ifndef PICK_EM_BASE_SAVED
+#define PICK_EM_BASE_SAVED "/saved"
+#endif
+
+#ifndef PICK_EM_IMPORT_CHUNK
+#define PICK_EM_IMPORT_CHUNK (4 * 1024 * 1024)
+#endif
+
+#ifndef PICK_EM_IMPORT_CONCURRENCY
+#define PICK_EM_IMPORT_CONCURRENCY 8
+#endif
+
+#ifndef PICK_EM_WALK_CONCURRENCY
+#define PICK_EM_WALK_CONCURRENCY 16
+#endif
+
+#ifndef PICK_EM_PROGRESS_HZ
+#define PICK_EM_PROGRESS_HZ 10
+#endif
+
+#ifndef PICK_EM_MAX_IMPORT_BYTES
+#define PICK_EM_MAX_IMPORT_BYTES 0
+#endif
+
+#ifndef PICK_EM_IMPORT_CACHE_BYTES
+#define PICK_EM_IMPORT_CACHE_BYTES 0
+#endif
+
+#ifndef PICK_EM_IMPORT_CACHE_HASH
+#define PICK_EM_IMPORT_CACHE_HASH 0
+#endif
+
+#ifndef PICK_EM_IMPORT_DEDUP
+#define PICK_EM_IMPORT_DEDUP 0
+#endif
+
+#ifndef PICK_EM_LAZY_IMPORT
+#define PICK_EM_LAZY_IMPORT 0
+#endif
+
+#ifndef PICK_EM_IMPORT_WORKER
+#ifdef __EMSCRIPTEN_PTHREADS__
+#define PICK_EM_IMPORT_WORKER 1
+#else
+#define PICK_EM_IMPORT_WORKER 0
+#endif
+#endif
+
+#ifndef PICK_EM_STORAGE_MAX_BYTES
+#define PICK_EM_STORAGE_MAX_BYTES 0
+#endif
+
+#ifndef PICK_EM_STORAGE_MAX_AGE
+#define PICK_EM_STORAGE_MAX_AGE 0
+#endif
+
+static const char* pick__icon_token(PickIconType t) {
+  switch (t) {
+    case PICK_ICON_DEFAULT:   return "default";
+    case PICK_ICON_CUSTOM:    return "custom";
+    case PICK_ICON_APP:       return "app";
+    case PICK_ICON_TRASH:     return "trash";
+    case PICK_ICON_FOLDER:    return "folder";
+    case PICK_ICON_DOCUMENT:  return "document";
+    case PICK_ICON_LOCKED:    return "locked";
+    case PICK_ICON_UNLOCKED:  return "unlocked";
+    case PICK_ICON_NETWORK:   return "network";
+    case PICK_ICON_USER:      return "user";
+    case PICK_ICON_CAUTION:   return "caution";
+    case PICK_ICON_ERROR:     return "error";
+    case PICK_ICON_STOP:      return "stop";
+    case PICK_ICON_INVALID:   return "invalid";
+    default:                  return "default";
+  }
+}
+
+// EM_JS bodies are also plain JS functions that other bodies call by name.
+// Those called only that way, and which return a Promise, object or function
+// rather than a number, are declared void: their value means nothing to C,
+// and they must not be called from C. Their comments describe the JS value.
+EM_JS(void, pick__js_init_buckets, (const char* picked_c, int import_chunk, int import_lazy, int import_concurrency, int walk_concurrency,
+                                   int progress_hz, double max_import_bytes, double cache_bytes, int cache_hash, int dedup,
+                                   double storage_bytes, double storage_age, int import_worker), {
+  if (typeof FS === "undefined") return;
+  var picked = UTF8ToString(picked_c);
+  Module.__pickImport = { base: picked, chunk: import_chunk > 0 ? import_chunk : 4194304,
+                          lazy: import_lazy ? 1 : 0, concurrency: import_concurrency > 0 ? import_concurrency : 1,
+                          walkConcurrency: walk_concurrency > 0 ? walk_concurrency : 1,
+                          progressHz: progress_hz > 0 ? progress_hz : 1, maxBytes: max_import_bytes > 0 ? max_import_bytes : 0 };
+  if (max_import_bytes > 0 && !Module.__pickSpill) Module.__pickSpill = pick__js_open_spill_dir();
+  if (cache_bytes > 0 && !Module.__pickCache) Module.__pickCache = pick__js_open_import_cache(cache_bytes, cache_hash);
+  if (dedup && !Module.__pickDedup) Module.__pickDedup = pick__js_open_dedup();
+  if (import_worker && !Module.__pickWorker) Module.__pickWorker = pick__js_open_import_worker();
+  if ((storage_bytes > 0 || storage_age > 0) && !Module.__pickStore) Module.__pickStore = pick__js_open_store(storage_bytes, storage_age);
+  try { if (!FS.analyzePath(picked).exists) FS.mkdir(picked); } catch (e) { console.error("pick: " + picked + " mkdir", e); }
+  try { if (!FS.analyzePath("/saved").exists)  FS.mkdir("/saved");  } catch (e) { console.error("pick: /saved mkdir", e); }
+});
+
+// Spilled imports go to OPFS under pick-spill/<tab>. Each tab holds a Web Lock
+// named after its directory for as long as it lives, so directories whose
+// lock is free belong to closed tabs and are removed. Resolves to the tab's
+// directory handle, or null when OPFS cannot be written from here.
+EM_JS(void, pick__js_open_spill_dir, (), {
+  return (async function() {
+    try {
+      if (typeof navigator === "undefined" || !navigator.storage || !navigator.storage.getDirectory) return null;
+      if (typeof FileSystemFileHandle === "undefined" || !FileSystemFileHandle.prototype.createWritable) return null;
+      var root = await (await navigator.storage.getDirectory()).getDirectoryHandle("pick-spill", { create: true });
+      var name = Date.now().toString(36) + "-" + Math.random().toString(36).slice(2, 10);
+      var locks = navigator.locks;
+      if (locks) {
+        await new Promise(function(held) {
+          locks.request("pick-spill/" + name, function() { held(); return new Promise(function(){}); });
+        });
+        for await (var old of root.keys()) {
+          if (old === name) continue;
+          locks.request("pick-spill/" + old, { ifAvailable: true }, function(lock) {
+            return lock ? root.removeEntry(old, { recursive: true }).catch(function(){}) : null;
+          });
+        }
+      }
+      return await root.getDirectoryHandle(name, { create: true });
+    } catch (e) {
+      console.error("pick: OPFS spill unavailable", e);
+      return null;
+    }
+  })();
+});
+
+// The import cache: entry files e<id> in OPFS pick-cache/, plus index.json
+// mapping each key to { id, size, used }. In memory the entries sit in a Map
+// in least-recently-used order, so eviction takes them from the front.
+// Resolves to the cache object the import glue uses, or null when OPFS
+// cannot be written from here.
+EM_JS(void, pick__js_open_import_cache, (double cap, int hash), {
+  return (async function() {
+    try {
+      if (typeof navigator === "undefined" || !navigator.storage || !navigator.storage.getDirectory) return null;
+      if (typeof FileSystemFileHandle === "undefined" || !FileSystemFileHandle.prototype.createWritable) return null;
+      var dir = await (await navigator.storage.getDirectory()).getDirectoryHandle("pick-cache", { create: true });
+      var index = { next: 1, entries: {} };
+      try { index = JSON.parse(await (await (await dir.getFileHandle("index.json")).getFile()).text()); } catch (e) {}
+      var entries = new Map(Object.keys(index.entries).map(function(k) { return [k, index.entries[k]]; })
+                              .sort(function(a, b) { return a[1].used - b[1].used; }));
+      var total = 0, pinned = {}, known = { "index.json": 1 };
+      entries.forEach(function(e) { total += e.size; known["e" + e.id] = 1; });
+      for await (var name of dir.keys()) {
+        if (!known[name]) dir.removeEntry(name).catch(function(){});
+      }
+
+      // Saves queue up, each after `after` (entries still being committed).
+      var saving = Promise.resolve();
+      function save(after) {
+        saving = saving.then(function() { return after; }).then(async function() {
+          var w = await (await dir.getFileHandle("index.json", { create: true })).createWritable();
+          var out = {};
+          entries.forEach(function(e, k) { out[k] = e; });
+          await w.write(JSON.stringify({ next: index.next, entries: out }));
+          await w.close();
+        }).catch(function(e) { console.error("pick: saving the import cache index failed", e); });
+        return saving;
+      }
+      function drop(key) {
+        var e = entries.get(key);
+        entries.delete(key);
+        total -= e.size;
+        dir.removeEntry("e" + e.id).catch(function(){});
+      }
+      async function fingerprint(file) {
+        var win = 65536, mid = Math.max(0, Math.floor(file.size / 2) - win / 2);
+        var parts = [file.slice(0, win), file.slice(mid, mid + win), file.slice(Math.max(0, file.size - win))];
+        var bytes = new Uint8Array(await new Blob(parts).arrayBuffer());
+        var digest = new Uint8Array(await crypto.subtle.digest("SHA-256", bytes));
+        return Array.prototype.map.call(digest, function(b) { return (b + 256).toString(16).slice(1); }).join("");
+      }
+
+      var cache = {
+        hits: 0, misses: 0, hitBytes: 0, evictions: 0,
+        get bytes() { return total; },
+        get entries() { return entries.size; },
+        // Resolves to { key, file, hit }: the cached copy on a hit, else `file`.
+        // A hit stays pinned until the import unpins it.
+        lookup: async function(file, rel) {
+          var key = JSON.stringify([rel || file.name, file.size, file.lastModified || 0, hash ? await fingerprint(file) : ""]);
+          var e = entries.get(key);
+          if (e) {
+            try {
+              var copy = await (await dir.getFileHandle("e" + e.id)).getFile();
+              if (copy.size === file.size) {
+                e.used = Date.now();
+                entries.delete(key);
+                entries.set(key, e);
+                cache.pin(key);
+                cache.hits++;
+                cache.hitBytes += file.size;
+                return { key: key, file: copy, hit: true };
+              }
+            } catch (err) {}
+            drop(key);
+          }
+          cache.misses++;
+          return { key: key, file: file, hit: false };
+        },
+        // A writable for a new entry, committed on close(); null if it cannot fit.
+        store: async function(key, size) {
+          if (size > cap) return null;
+          for (var it = entries.keys(), k; total + size > cap;) {
+            do k = it.next(); while (!k.done && pinned[k.value]);
+            if (k.done) return null;
+            drop(k.value);
+            cache.evictions++;
+          }
+          var id = index.next++, handle = await dir.getFileHandle("e" + id, { create: true });
+          var w = await handle.createWritable();
+          total += size;  // reserved until close() or abort()
+          return {
+            write: function(data) { return w.write(data); },
+            close: async function() {
+              await w.close();
+              entries.set(key, { id: id, size: size, used: Date.now() });  // saved when the import ends
+            },
+            abort: async function() {
+              total -= size;
+              try { await w.abort(); } catch (e) {}
+              try { await dir.removeEntry("e" + id); } catch (e) {}
+            },
+            file: function() { return handle.getFile(); }
+          };
+        },
+        // Pinned entries (being imported, or backing lazy nodes) are not evicted by this tab.
+        pin: function(key) { pinned[key] = (pinned[key] || 0) + 1; },
+        unpin: function(key) { if (pinned[key] && !--pinned[key]) delete pinned[key]; },
+        save: save
+      };
+      Module.__pickCacheReady = cache;
+      return cache;
+    } catch (e) {
+      console.error("pick: import cache unavailable", e);
+      return null;
+    }
+  })();
+});
+
+EM_JS(double, pick__js_cache_stat, (int which), {
+  var c = (typeof Module !== "undefined") && Module.__pickCacheReady;
+  if (!c) return -1;
+  return [c.hits, c.misses, c.hitBytes, c.evictions, c.bytes, c.entries][which] || 0;
+});
+
+// Returns xxHash32(bytes, seed) over a Uint8Array. Nothing outside this body is
+// used, so the import worker runs a copy of it made from its source text.
+EM_JS(void, pick__js_xxh32, (), {
+  var P1 = 2654435761, P2 = 2246822519, P3 = 3266489917, P4 = 668265263, P5 = 374761393;
+  function rotl(x, r) { return (x << r) | (x >>> (32 - r)); }
+  function round(v, dv, at) { return Math.imul(rotl((v + Math.imul(dv.getUint32(at, true), P2)) | 0, 13), P1); }
+  function xxh32(b, seed) {
+    var n = b.length, i = 0, h, dv = new DataView(b.buffer, b.byteOffset, n);
+    if (n >= 16) {
+      var v1 = (seed + P1 + P2) | 0, v2 = (seed + P2) | 0, v3 = seed | 0, v4 = (seed - P1) | 0;
+      for (; i <= n - 16; i += 16) {
+        v1 = round(v1, dv, i); v2 = round(v2, dv, i + 4); v3 = round(v3, dv, i + 8); v4 = round(v4, dv, i + 12);
+      }
+      h = (rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18)) | 0;
+    } else {
+      h = (seed + P5) | 0;
+    }
+    h = (h + n) | 0;
+    for (; i <= n - 4; i += 4) h = Math.imul(rotl((h + Math.imul(dv.getUint32(i, true), P3)) | 0, 17), P4);
+    for (; i < n; i++) h = Math.imul(rotl((h + Math.imul(b[i], P5)) | 0, 11), P1);
+    h = Math.imul(h ^ (h >>> 15), P2);
+    h = Math.imul(h ^ (h >>> 13), P3);
+    return (h ^ (h >>> 16)) >>> 0;
+  }
+  return xxh32;
+});
+
+// Import deduplication: heap-imported files grouped by size, each with the
+// xxHash32 of its bytes, hashed `chunk` bytes at a time with every slice's hash
+// seeding the next, so equal files give equal hashes. The hash of a file that
+// had no same-size peer when imported is computed on first need. A file is
+// linked only once its bytes compare equal; linked nodes share `contents` and
+// copy it before their first write or resize.
+EM_JS(void, pick__js_open_dedup, (), {
+  var xxh32 = pick__js_xxh32();
+  function digest(bytes, size, chunk) {
+    for (var h = 0, pos = 0; pos < size; pos += chunk) h = dedup.hash(bytes.subarray(pos, Math.min(size, pos + chunk)), h);
+    return h;
+  }
+  function same(a, b, n) {
+    if (a === b) return true;
+    var i = 0;
+    if (a.byteOffset % 4 === 0 && b.byteOffset % 4 === 0) {
+      var wa = new Int32Array(a.buffer, a.byteOffset, n >> 2), wb = new Int32Array(b.buffer, b.byteOffset, n >> 2);
+      for (; i < wa.length; i++) if (wa[i] !== wb[i]) return false;
+      i <<= 2;
+    }
+    for (; i < n; i++) if (a[i] !== b[i]) return false;
+    return true;
+  }
+
+  var bySize = new Map(), shares = new WeakMap();
+  var weak = typeof WeakRef !== "undefined" ? function(x) { return new WeakRef(x); } : function(x) { return { deref: function() { return x; } }; };
+  // Stops counting `node` as one of the nodes sharing its contents.
+  function unshare(node) {
+    if (node.pickDedup) node.pickDedup.hash = null;
+    var n = node.contents && shares.get(node.contents);
+    if (!n || n < 2) return false;
+    shares.set(node.contents, n - 1);
+    dedup.linked--;
+    dedup.saved -= node.usedBytes;
+    return true;
+  }
+  // Gives `node` its own copy of shared contents before MEMFS changes them in place.
+  function detach(node) {
+    if (unshare(node)) node.contents = node.contents.slice(0, node.usedBytes);
+  }
+  function track(node) {
+    if (node.pickTracked) return;
+    node.pickTracked = true;
+    var ops = Object.assign({}, node.stream_ops), nops = Object.assign({}, node.node_ops);
+    ["write", "msync"].forEach(function(name) {
+      var op = ops[name];
+      if (op) ops[name] = function(stream) { detach(stream.node); return op.apply(this, arguments); };
+    });
+    var setattr = nops.setattr;
+    if (setattr) nops.setattr = function(n, attr) { if (attr.size !== undefined) detach(n); return setattr.apply(this, arguments); };
+    node.stream_ops = ops;
+    node.node_ops = nops;
+  }
+
+  var dedup = {
+    linked: 0, saved: 0, hashed: 0,
+    // Whether a file of `size` bytes has a candidate to match, so is worth hashing.
+    has: function(size) { return bySize.has(size); },
+    hash: function(part, h) { dedup.hashed += part.length; return xxh32(part, h); },
+    // A node being deleted: uncount it and stop offering it as a match.
+    release: function(node) {
+      unshare(node);
+      if (node.pickDedup) node.pickDedup.ref = { deref: function() { return null; } };
+    },
+    // Registers a fully imported node, or links it to an identical one and
+    // returns true. `h` is its hash, or null if it was not hashed on the way in.
+    add: function(node, h, chunk) {
+      var size = node.usedBytes, list = bySize.get(size);
+      if (!size || !node.contents) return false;
+      if (!list) bySize.set(size, list = []);
+      for (var i = list.length - 1; i >= 0; i--) {
+        var e = list[i], other = e.ref.deref();
+        if (!other || other.usedBytes !== size || !other.contents) { list.splice(i, 1); continue; }
+        if (h == null) h = digest(node.contents, size, chunk);
+        if (e.hash == null) e.hash = digest(other.contents, size, chunk);
+        if (e.hash !== h || !same(other.contents, node.contents, size)) continue;
+        track(node);
+        shares.set(other.contents, (shares.get(other.contents) || 1) + 1);
+        node.contents = other.contents;
+        dedup.linked++;
+        dedup.saved += size;
+        return true;
+      }
+      track(node);
+      node.pickDedup = { ref: weak(node), hash: h };
+      list.push(node.pickDedup);
+      return false;
+    }
+  };
+  return dedup;
+});
+
+EM_JS(double, pick__js_dedup_stat, (int which), {
+  var d = (typeof Module !== "undefined") && Module.__pickDedup;
+  if (!d) return -1;
+  return [d.linked, d.saved, d.hashed][which] || 0;
+});
+
+// The import worker of PICK_EM_IMPORT_WORKER: reads slices of picked Files and
+// hashes them off the main thread, transferring the bytes back. Files are
+// structured-cloned into it, which passes the handle, not the bytes. read()
+// resolves to { buf, hash }, `hash` continuing `seed` or null without one;
+// once the worker fails, reads run on the main thread instead. Null if no
+// worker can be started here, such as under a CSP without blob: workers.
+// Only reads and hashes move: the FS.write of each slice stays on the main thread.
+EM_JS(void, pick__js_open_import_worker, (), {
+  if (typeof Worker === "undefined" || typeof Blob === "undefined" || typeof URL === "undefined") return null;
+  function main(xxh32) {
+    self.onmessage = function(ev) {
+      var m = ev.data;
+      m.file.slice(m.start, m.end).arrayBuffer().then(function(buf) {
+        var hash = m.seed === null ? null : xxh32(new Uint8Array(buf), m.seed);
+        self.postMessage({ id: m.id, buf: buf, hash: hash }, [buf]);
+      }).catch(function(e) { self.postMessage({ id: m.id, error: String(e) }); });
+    };
+  }
+  var worker, xxh32 = pick__js_xxh32(), pending = new Map(), next = 1;
+  try {
+    var src = "(" + main.toString() + ")((" + pick__js_xxh32.toString() + ")());";
+    worker = new Worker(URL.createObjectURL(new Blob([src], { type: "text/javascript" })));
+  } catch (e) {
+    console.error("pick: import worker unavailable", e);
+    return null;
+  }
+  worker.onmessage = function(ev) {
+    var m = ev.data, p = pending.get(m.id);
+    if (!p) return;
+    pending.delete(m.id);
+    if (m.error !== undefined) p.reject(new Error(m.error)); else p.resolve(m);
+  };
+  worker.onerror = function(e) {
+    console.error("pick: import worker failed", e);
+    worker = null;
+    pending.forEach(function(p) { p.retry(); });
+    pending.clear();
+  };
+  function local(file, start, end, seed) {
+    return file.slice(start, end).arrayBuffer().then(function(buf) {
+      return { buf: buf, hash: seed === null ? null : xxh32(new Uint8Array(buf), seed) };
+    });
+  }
+  return {
+    read: function(file, start, end, seed) {
+      if (seed === undefined) seed = null;
+      if (!worker) return local(file, start, end, seed);
+      return new Promise(function(resolve, reject) {
+        var id = next++;
+        pending.set(id, { resolve: resolve, reject: reject, retry: function() { local(file, start, end, seed).then(resolve, reject); } });
+        worker.postMessage({ id: id, file: file, start: start, end: end, seed: seed });
+      });
     }
+  };
+});
+
+// The eviction policy of PICK_EM_STORAGE_MAX_BYTES and PICK_EM_STORAGE_MAX_AGE.
+// Files imported or saved are kept in a Map in least recently used order; an
+// FS.open() of one moves it to the back, and files with a stream open are
+// never evicted. Bytes are heap bytes: lazy and OPFS-backed nodes count 0.
+// The caps are applied when files arrive, never to the files just arrived,
+// and every few seconds for the age cap. Evicted imports go through
+// pick__js_release(); evicted saves are unlinked.
+EM_JS(void, pick__js_open_store, (double max_bytes, double max_age), {
+  var files = new Map();
+  var store = { bytes: 0, files: 0, evictions: 0, evictedBytes: 0 };
+  function heap(node) { return node.pickStorage > 2 ? 0 : (node.usedBytes || 0); }
+  function touch(e) {
+    files.delete(e.path);
+    files.set(e.path, e);
+    e.used = Date.now();
   }
-}
+  function track(node) {
+    var ops = Object.assign({}, node.stream_ops), open = ops.open, close = ops.close;
+    ops.open = function(stream) {
+      var e = stream.node.pickStore;
+      if (e) { e.opens++; touch(e); }
+      if (open) return open.apply(this, arguments);
+    };
+    ops.close = function(stream) {
+      var e = stream.node.pickStore;
+      if (e && e.opens > 0) e.opens--;
+      if (close) return close.apply(this, arguments);
+    };
+    node.stream_ops = ops;
+  }
+  function evict(e) {
+    store.evictions++;
+    store.evictedBytes += heap(e.node);
+    var base = (Module.__pickImport && Module.__pickImport.base) || "/picked";
+    if (e.path.slice(0, base.length + 1) === base + "/") { pick__js_release(e.path); return; }
+    try { FS.unlink(e.path); } catch (x) {}
+    try { for (var d = e.path.slice(0, e.path.lastIndexOf("/")); d.length > "/saved".length; d = d.slice(0, d.lastIndexOf("/"))) FS.rmdir(d); } catch (x) {}
+  }
+  // Recounts the live files, evicting past the caps when `apply` is set.
+  store.enforce = function(apply) {
+    var live = [], total = 0, cutoff = max_age > 0 ? Date.now() - max_age * 1000 : -Infinity;
+    files.forEach(function(e, p) {
+      var node = null;
+      try { node = FS.lookupPath(p).node; } catch (x) {}
+      if (node !== e.node) { files.delete(p); return; }
+      live.push(e);
+      total += heap(node);
+    });
+    var count = live.length;
+    for (var i = 0; apply && i < live.length; i++) {
+      var e = live[i];
+      if (e.opens > 0 || e.fresh) continue;
+      if (e.used >= cutoff && !(max_bytes > 0 && total > max_bytes)) continue;
+      files.delete(e.path);
+      total -= heap(e.node);
+      count--;
+      evict(e);
+    }
+    store.bytes = total;
+    store.files = count;
+  };
+  // Starts tracking delivered `paths`, then applies the caps to older files.
+  store.add = function(paths) {
+    var fresh = [];
+    paths.forEach(function(p) {
+      var node;
+      try { node = FS.lookupPath(p).node; } catch (x) { return; }
+      var e = files.get(p);
+      if (!e || e.node !== node) {
+        e = { path: p, node: node, used: 0, opens: 0, fresh: false };
+        if (!node.pickStore) track(node);
+        node.pickStore = e;
+      }
+      e.fresh = true;
+      touch(e);
+      fresh.push(e);
+    });
+    store.enforce(max_bytes > 0 || max_age > 0);
+    fresh.forEach(function(e) { e.fresh = false; });
+  };
+  if (max_age > 0) setInterval(function() { store.enforce(true); }, Math.min(60000, Math.max(1000, max_age * 250)));
+  return store;
+});
 
-static const char* pick__icon_token(PickIconType t) {
-  switch (t) {
-    case PICK_ICON_DEFAULT:   return "default";
-    case PICK_ICON_CUSTOM:    return "custom";
-    case PICK_ICON_APP:       return "app";
-    case PICK_ICON_TRASH:     return "trash";
-    case PICK_ICON_FOLDER:    return "folder";
-    case PICK_ICON_DOCUMENT:  return "document";
-    case PICK_ICON_LOCKED:    return "locked";
-    case PICK_ICON_UNLOCKED:  return "unlocked";
-    case PICK_ICON_NETWORK:   return "network";
-    case PICK_ICON_USER:      return "user";
-    case PICK_ICON_CAUTION:   return "caution";
-    case PICK_ICON_ERROR:     return "error";
-    case PICK_ICON_STOP:      return "stop";
-    case PICK_ICON_INVALID:   return "invalid";
-    default:                  return "default";
+EM_JS(double, pick__js_storage_stat, (int which), {
+  var st = (typeof Module !== "undefined") && Module.__pickStore;
+  if (!st) return -1;
+  if (which === 0) st.enforce(false);
+  return [st.bytes, st.files, st.evictions, st.evictedBytes][which] || 0;
+});
+
+// Deletes an imported file, or a folder of them, and gives back what the
+// nodes held: heap copies become garbage, shared dedup storage is
+// uncounted, and OPFS-backed nodes drop their cache pin or spill file.
+// Emptied folders are removed up to the import directory. Returns the
+// number of files deleted; paths outside the import directory are refused.
+EM_JS(int, pick__js_release, (const char* path_c), {
+  if (typeof FS === "undefined") return 0;
+  var base = (Module.__pickImport && Module.__pickImport.base) || "/picked";
+  var path = (typeof path_c === "number") ? UTF8ToString(path_c) : path_c, n = 0;
+  while (path.length > 1 && path[path.length - 1] === "/") path = path.slice(0, -1);
+  if (path.slice(0, base.length + 1) !== base + "/" || path.split("/").indexOf("..") >= 0) return 0;
+  function drop(p) {
+    var node;
+    try { node = FS.lookupPath(p).node; } catch (e) { return; }
+    if (FS.isDir(node.mode)) {
+      FS.readdir(p).forEach(function(name) { if (name !== "." && name !== "..") drop(p + "/" + name); });
+      try { FS.rmdir(p); } catch (e) {}
+      return;
+    }
+    if (Module.__pickDedup) Module.__pickDedup.release(node);
+    // A resync must bring back a file of a picked folder that is gone from MEMFS.
+    for (var id in Module.__pickFolders || {}) {
+      var st = Module.__pickFolders[id];
+      if (p.slice(0, st.base.length + 1) === st.base + "/") st.files.delete(p.slice(st.base.length + 1));
+    }
+    if (node.pickRelease) { try { node.pickRelease(); } catch (e) { console.error("pick: releasing " + p, e); } }
+    try { FS.unlink(p); n++; } catch (e) {}
   }
-}
+  drop(path);
+  try { for (var d = path.slice(0, path.lastIndexOf("/")); d.length > base.length; d = d.slice(0, d.lastIndexOf("/"))) FS.rmdir(d); } catch (e) {}
+  return n;
+});
 
-EM_JS(void, pick__js_init_buckets, (), {
-  if (typeof FS === "undefined") return;
-  try { if (!FS.analyzePath("/picked").exists) FS.mkdir("/picked"); } catch (e) { console.error("pick: /picked mkdir", e); }
-  try { if (!FS.analyzePath("/saved").exists)  FS.mkdir("/saved");  } catch (e) { console.error("pick: /saved mkdir", e); }
+EM_JS(int, pick__js_release_request, (int req_id), {
+  var base = (Module.__pickImport && Module.__pickImport.base) || "/picked";
+  if (Module.__pickFolders) delete Module.__pickFolders[req_id];
+  return pick__js_release(base + "/" + req_id);
+});
+
+EM_JS(int, pick__js_path_storage, (const char* path_c), {
+  if (typeof FS === "undefined") return 0;
+  try { return FS.lookupPath(UTF8ToString(path_c)).node.pickStorage || 0; } catch (e) { return 0; }
 });
 
 EM_JS(void, pick__call_deliver_single, (int id, const char* c_path), {
@@ -1475,17 +5227,71 @@ EM_JS(void, pick__call_deliver_single, (int id, const char* c_path), {
   function S(x){ return (typeof x === "number") ? (x ? UTF8ToString(x) : null) : (x || null); }
   c("pick__deliver_single","void",["number","string"],[id, S(c_path)]);
 });
-EM_JS(void, pick__call_deliver_multi_lines, (int id, const char* c_joined), {
+// Called from the glue with a JS array of paths. Each path is UTF-8 encoded
+// once into its record of a pick__result_alloc() block (layout above
+// pick__result_index), instead of joining, encoding and re-splitting in C.
+EM_JS(void, pick__call_deliver_multi, (int id, const char* c_paths), {
   var c = (Module && Module.ccall) ? Module.ccall : (typeof ccall !== "undefined" ? ccall : null);
   if (!c) { console.error("pick: ccall missing"); return; }
-  function S(x){ return (typeof x === "number") ? (x ? UTF8ToString(x) : "") : (x || ""); }
-  c("pick__deliver_multi_lines","void",["number","string"],[id, S(c_joined)]);
+  var paths = Array.isArray(c_paths) ? c_paths : [];
+  var n = paths.length;
+  if (!n) { c("pick__deliver_multi_buf","void",["number","number","number"],[id, 0, 0]); return; }
+
+  // Encode the records into scratch first (exactly sized for ASCII names,
+  // grown on demand), then copy them into the heap in one go.
+  var enc = new TextEncoder();
+  var cap = 16;
+  for (var i = 0; i < n; i++) cap += 5 + paths[i].length;
+  var scratch = new Uint8Array(cap), used = 0;
+  for (var j = 0; j < n; j++) {
+    var path = String(paths[j]), r;
+    for (;;) {
+      r = enc.encodeInto(path, scratch.subarray(used + 4, scratch.length - 1));
+      if (r.read === path.length) break;
+      var grown = new Uint8Array(scratch.length * 2 + path.length * 3);
+      grown.set(scratch.subarray(0, used));
+      scratch = grown;
+    }
+    var len = r.written;
+    scratch[used] = len & 255; scratch[used + 1] = (len >> 8) & 255;
+    scratch[used + 2] = (len >> 16) & 255; scratch[used + 3] = (len >>> 24) & 255;
+    used += 4 + len;
+    scratch[used++] = 0;
+  }
+
+  var size = 8 + n * 8 + used;
+  var ptr = c("pick__result_alloc","number",["number"],[size]);
+  if (!ptr) { c("pick__deliver_multi_buf","void",["number","number","number"],[id, 0, 0]); return; }
+  // Read HEAPU8 only after the allocation, which may have grown memory.
+  var heap = HEAPU8;
+  heap[ptr] = n & 255; heap[ptr + 1] = (n >> 8) & 255; heap[ptr + 2] = (n >> 16) & 255; heap[ptr + 3] = (n >>> 24) & 255;
+  heap.fill(0, ptr + 4, ptr + 8 + n * 8);
+  heap.set(scratch.subarray(0, used), ptr + 8 + n * 8);
+  c("pick__deliver_multi_buf","void",["number","number","number"],[id, ptr, size]);
 });
 EM_JS(void, pick__call_deliver_msg, (int id, int button_idx), {
   var c = (Module && Module.ccall) ? Module.ccall : (typeof ccall !== "undefined" ? ccall : null);
   if (!c) { console.error("pick: ccall missing"); return; }
   c("pick__deliver_msg","void",["number","number"],[id, button_idx]);
 });
+EM_JS(int, pick__call_progress, (int id, int files_done, int files_total, double bytes_done, double bytes_total), {
+  var c = (Module && Module.ccall) ? Module.ccall : (typeof ccall !== "undefined" ? ccall : null);
+  if (!c) return 1;
+  return c("pick__deliver_progress","number",["number","number","number","number","number"],
+           [id, files_done, files_total, bytes_done, bytes_total]);
+});
+EM_JS(int, pick__call_req_alive, (int id), {
+  var c = (Module && Module.ccall) ? Module.ccall : (typeof ccall !== "undefined" ? ccall : null);
+  if (!c) return 1;
+  return c("pick__req_alive","number",["number"],[id]);
+});
+
+EM_JS(void, pick__js_cancel, (int req_id), {
+  try {
+    var overlay = document.querySelector('[data-pick="overlay"][data-req-id="' + req_id + '"]');
+    if (overlay) overlay.remove();
+  } catch (e) { console.error("pick__js_cancel failed", e); }
+});
 
 EM_JS(void, pick__js_create_dialog, (int req_id, const char* role_label_c, const char* title_c,
                                     const char* message_c, const char* kind_c,
@@ -1594,50 +5400,448 @@ EM_JS(void, pick__js_bind_message_handlers, (int req_id, int button_count), {
   } catch (e) { console.error("pick__js_bind_message_handlers failed", e); }
 });
 
-EM_JS(void, pick__js_import_files_to_memfs, (const char* base_c, int req_id, int is_multi), {
-  (async function(){
+// Lazy import: a read-only node whose reads pull `chunk`-byte windows of the
+// picked File (or its OPFS copy) on demand. Reads are synchronous, so a worker
+// uses FileReaderSync and the main thread a synchronous XHR over a blob: URL.
+// Called from the glue with a JS File; `storage` is its PickStorage value.
+EM_JS(void, pick__js_create_lazy_file, (const char* path_c, int file_js, int chunk, int storage), {
+  var file = file_js;
+  function readSync(start, end) {
+    var blob = file.slice(start, end);
+    if (typeof FileReaderSync !== "undefined") return new Uint8Array(new FileReaderSync().readAsArrayBuffer(blob));
+    var url = URL.createObjectURL(blob);
+    try {
+      var xhr = new XMLHttpRequest();
+      xhr.open("GET", url, false);
+      xhr.overrideMimeType("text/plain; charset=x-user-defined");
+      xhr.send(null);
+      var text = xhr.responseText, bytes = new Uint8Array(text.length);
+      for (var i = 0; i < text.length; i++) bytes[i] = text.charCodeAt(i) & 255;
+      return bytes;
+    } finally {
+      URL.revokeObjectURL(url);
+    }
+  }
+
+  var path = (typeof path_c === "number") ? UTF8ToString(path_c) : path_c;
+  try { FS.unlink(path); } catch (e) {}
+  var node = FS.create(path, 292 /* 0444 */);
+  node.usedBytes = file.size;
+  node.pickStorage = storage;
+  var cached = null;
+  var ops = Object.assign({}, node.stream_ops);
+  ops.read = function(stream, buffer, offset, length, position) {
+    if (position >= file.size) return 0;
+    var n = Math.min(length, file.size - position), done = 0;
+    while (done < n) {
+      var at = position + done;
+      if (!cached || at < cached.start || at >= cached.start + cached.bytes.length) {
+        var start = at - at % chunk;
+        cached = { start: start, bytes: readSync(start, Math.min(file.size, start + chunk)) };
+        if (!cached.bytes.length) break;
+      }
+      var from = at - cached.start, take = Math.min(n - done, cached.bytes.length - from);
+      buffer.set(cached.bytes.subarray(from, from + take), offset + done);
+      done += take;
+    }
+    return done;
+  };
+  ops.write = function() { throw new FS.ErrnoError(2); };  // EACCES: picked files are read-only
+  node.stream_ops = ops;
+});
+
+// Files are copied in `chunk`-byte slices into a MEMFS node sized up front.
+// The first slices of up to `concurrency` files are read at once, but writes
+// and the delivered order follow the selection, so an import holds at most
+// `concurrency` slices beyond the files. Progress crosses into C at most
+// `progress_hz` times a second, plus at the start and the end. Once the
+// copies would pass `max_bytes`, further files are streamed into OPFS and
+// served from there. With the import cache open, hits are read from their
+// cached copy and misses are written through to it. With deduplication on,
+// heap copies are hashed as they stream in if another file has their size,
+// and a copy identical to a file already in MEMFS shares its storage. With
+// the import worker running, heap copies are read and hashed there, leaving
+// the main thread only the copy into MEMFS. With `lazy` only the nodes are
+// created and the paths are delivered at once.
+// The dialog's selection is imported and delivered to the request, and a
+// picked folder's handle is kept for pick_folder_resync(). A resync passes
+// its own `chosen_js` array instead; nothing is delivered then. Either way
+// the promise returned resolves to the paths, or null.
+EM_JS(void, pick__js_import_files_to_memfs, (const char* base_c, int req_id, int is_multi, int chunk, int lazy, int concurrency, int progress_hz,
+                                           double max_bytes, int chosen_js), {
+  var own = Array.isArray(chosen_js);
+  var chosen = own ? chosen_js : (Module.__pickChosen || []);
+  var folder = own ? null : Module.__pickChosenDir;
+  if (!own && Module.__pickFolders) delete Module.__pickFolders[req_id];
+  return (async function(){
+    function fail() { if (!own) pick__call_deliver_single(req_id, 0); return null; }
     try {
       function S(x){ return (typeof x === "number") ? (x ? UTF8ToString(x) : "") : (x || ""); }
-      if (typeof FS === "undefined") { pick__call_deliver_single(req_id, 0); return; }
+      if (typeof FS === "undefined") return fail();
       var base = S(base_c) || "/picked";
-      try { if (!FS.analyzePath(base).exists) FS.mkdir(base); } catch (e) {}
+      // A recycled request id may find an earlier request's files still there.
+      if (!own) pick__js_release(base);
+      for (var b = base.indexOf("/", 1); ; b = base.indexOf("/", b + 1)) {
+        var up = b < 0 ? base : base.slice(0, b);
+        try { if (!FS.analyzePath(up).exists) FS.mkdir(up); } catch (e) {}
+        if (b < 0) break;
+      }
+
+      if (!chosen.length) return fail();
+
+      // The directory skeleton, made before any file: each folder is looked up
+      // once at most, and not at all inside a folder this import just created
+      // (the whole tree, unless a resync adds to an existing one).
+      var dirs = new Map([[base, !own]]);
+      for (var q = 0; q < chosen.length; q++) {
+        var segs = chosen[q].rel.split("/"), at = base;
+        for (var k = 0; k < segs.length - 1; k++) {
+          if (!segs[k]) continue;
+          var parent = at;
+          at = at + "/" + segs[k];
+          if (dirs.has(at)) continue;
+          var made = false;
+          try {
+            if (dirs.get(parent) || !FS.analyzePath(at).exists) { FS.mkdir(at); made = true; }
+          } catch (e) {}
+          dirs.set(at, made);
+        }
+      }
+
+      var cache = lazy ? null : await Module.__pickCache;
+      var dedup = lazy ? null : Module.__pickDedup;
+      var worker = lazy ? null : Module.__pickWorker;
+      var sizes = new Map();
+      for (var z = 0; dedup && z < chosen.length; z++) sizes.set(chosen[z].file.size, (sizes.get(chosen[z].file.size) || 0) + 1);
+      // Whether a heap copy of `f` is worth hashing for deduplication.
+      function wanted(f) { return !!(dedup && f.size && (sizes.get(f.size) > 1 || dedup.has(f.size))); }
+      // Bytes start..end of `f` as { buf, hash }: through the import worker
+      // when there is one, which also hashes them when given a `seed`.
+      function read(f, start, end, seed) {
+        if (worker) return worker.read(f, start, end, seed);
+        return f.slice(start, end).arrayBuffer().then(function(buf) { return { buf: buf, hash: null }; });
+      }
+      var srcs = [];
+      for (var c = 0; c < chosen.length; c++) {
+        srcs[c] = cache ? await cache.lookup(chosen[c].file, chosen[c].rel) : { file: chosen[c].file, hit: false };
+      }
+
+      var ahead = [], next = 0;
+      function prefetch(upto) {
+        for (; next < chosen.length && next < upto; next++) {
+          var pf = srcs[next].file;
+          ahead[next] = read(pf, 0, Math.min(pf.size, chunk), wanted(pf) ? 0 : null);
+          ahead[next].catch(function(){});  // rethrown when awaited in order
+        }
+      }
+
+      var filesDone = 0, bytesDone = 0, bytesTotal = 0, lastReport = -Infinity;
+      for (var t = 0; t < chosen.length; t++) bytesTotal += chosen[t].file.size;
+      var interval = 1000 / Math.max(1, progress_hz);
+      // False once the request is gone; a cancel from the callback counts.
+      function report(force) {
+        var now = Date.now();
+        if (!force && now - lastReport < interval) return true;
+        lastReport = now;
+        return pick__call_progress(req_id, filesDone, chosen.length, bytesDone, bytesTotal) !== 0;
+      }
+      if (!lazy && !report(true)) return null;
+
+      // Streams `f` into a writable (an OPFS file or a cache entry), counting
+      // progress. False if the write failed or the request went away.
+      async function pump(f, first, w, what) {
+        try {
+          for (var pos = 0; pos < f.size;) {
+            var end = Math.min(f.size, pos + chunk);
+            await w.write(pos ? await f.slice(pos, end).arrayBuffer() : (await first).buf);
+            bytesDone += end - pos;
+            pos = end;
+            if (!pick__call_req_alive(req_id) || (pos < f.size && !report(false))) throw null;
+          }
+          await w.close();
+          return true;
+        } catch (e) {
+          if (e) console.error("pick: writing " + what + " failed", e);
+          try { await w.abort(); } catch (_) {}
+          return false;
+        }
+      }
 
-      var chosen = (Module.__pickChosen || []);
-      if (!chosen.length) { pick__call_deliver_single(req_id, 0); return; }
+      var spilled = [], closing = [], heapBytes = 0;
+      // What deleting a node served from OPFS gives back: its cache pin or its spill file.
+      function releaser(key, spillName) {
+        if (key) return function() { cache.unpin(key); };
+        return function() { Module.__pickSpill.then(function(d) { if (d) d.removeEntry(spillName).catch(function(){}); }); };
+      }
+      // Streams one file into the tab's OPFS directory and returns the copy,
+      // or null if OPFS is unavailable, the write failed or the request went away.
+      async function spill(f, name, first) {
+        var dir = await Module.__pickSpill;
+        if (!dir) return null;
+        var handle = await dir.getFileHandle(name, { create: true });
+        if (!await pump(f, first, await handle.createWritable(), "the OPFS spill of " + name)) {
+          try { await dir.removeEntry(name); } catch (_) {}
+          return null;
+        }
+        spilled.push(name);
+        return await handle.getFile();
+      }
 
       var out = [];
       for (var j = 0; j < chosen.length; j++) {
-        var f = chosen[j].file;
+        if (!pick__call_req_alive(req_id)) break;
+        var f = srcs[j].file;
         var rel = chosen[j].rel;
-        var parts = rel.split("/").filter(Boolean);
-        var dir = base;
-        for (var k = 0; k < Math.max(0, parts.length - 1); k++) {
-          dir = dir + "/" + parts[k];
-          try { if (!FS.analyzePath(dir).exists) FS.mkdir(dir); } catch (e) {}
-        }
         var full = base + "/" + rel;
-        var ab = await f.arrayBuffer();
-        FS.writeFile(full, new Uint8Array(ab));
+        if (lazy) {
+          pick__js_create_lazy_file(full, f, chunk, 3);
+          out.push(full);
+          continue;
+        }
+        prefetch(j + Math.max(1, concurrency));
+        var first = ahead[j];
+        ahead[j] = null;
+        var entry = (cache && !srcs[j].hit) ? await cache.store(srcs[j].key, f.size) : null;
+        if (max_bytes > 0 && heapBytes + f.size > max_bytes) {
+          // Past the heap budget: serve the file from OPFS, preferably from
+          // its cache entry, so it is written there only once.
+          var before = bytesDone, copy = null;
+          if (srcs[j].hit) copy = f;
+          else if (entry && await pump(f, first, entry, "the import cache")) copy = await entry.file();
+          else if (!entry) copy = await spill(f, req_id + "-" + j, first);
+          if (!pick__call_req_alive(req_id)) break;
+          if (copy && entry) cache.pin(srcs[j].key);
+          else if (srcs[j].hit) srcs[j].lazy = true;
+          pick__js_create_lazy_file(full, copy || chosen[j].file, chunk, copy ? 4 : 3);
+          if (copy) FS.lookupPath(full).node.pickRelease = releaser((entry || srcs[j].hit) ? srcs[j].key : null, req_id + "-" + j);
+          out.push(full);
+          bytesDone = before + f.size;
+          filesDone++;
+          if (!report(filesDone === chosen.length)) break;
+          continue;
+        }
+        heapBytes += f.size;
+        var stream = FS.open(full, "w");
+        stream.node.pickStorage = 2;
+        var hash = wanted(f) ? 0 : null;
         out.push(full);
+        try {
+          if (f.size) FS.ftruncate(stream.fd, f.size);
+          for (var pos = 0; pos < f.size;) {
+            var end = Math.min(f.size, pos + chunk);
+            var got = await (pos ? read(f, pos, end, hash) : first);
+            var part = new Uint8Array(got.buf);
+            if (!pick__call_req_alive(req_id)) break;
+            FS.write(stream, part, 0, part.length, pos);
+            if (hash !== null && got.hash !== null) { hash = got.hash; dedup.hashed += part.length; }
+            else if (hash !== null) hash = dedup.hash(part, hash);
+            if (entry) {
+              try { await entry.write(part); }
+              catch (e) { console.error("pick: writing the import cache failed", e); await entry.abort(); entry = null; }
+            }
+            bytesDone += part.length;
+            pos = end;
+            if (pos < f.size && !report(false)) break;
+          }
+        } finally {
+          FS.close(stream);
+          if (entry && !(pos >= f.size)) { await entry.abort(); entry = null; }
+        }
+        // Committing an entry renames its swap file; let that overlap the next file.
+        if (entry) closing.push(entry.close().catch(entry.abort));
+        if (dedup && pos >= f.size && dedup.add(stream.node, hash, chunk)) heapBytes -= f.size;
+        filesDone++;
+        if (!report(filesDone === chosen.length)) break;
       }
 
+      if (!pick__call_req_alive(req_id)) {
+        // Cancelled mid-import: the callback already ran, so drop the partial
+        // copy, giving back cache pins and dedup links like pick_release().
+        for (var u = 0; u < out.length; u++) pick__js_release(out[u]);
+        if (spilled.length) {
+          var dir = await Module.__pickSpill;
+          for (var v = 0; v < spilled.length; v++) { try { await dir.removeEntry(spilled[v]); } catch (e) {} }
+        }
+        if (cache) cache.save(Promise.all(closing));
+        return null;
+      }
+      if (cache) cache.save(Promise.all(closing));
+      if (Module.__pickStore) Module.__pickStore.add(out);
+      if (own) return out;
+
+      if (folder) {
+        var files = new Map();
+        for (var r = 0; r < chosen.length; r++) files.set(chosen[r].rel, { size: chosen[r].file.size, modified: chosen[r].file.lastModified });
+        (Module.__pickFolders = Module.__pickFolders || {})[req_id] = { dir: folder.handle, filter: folder.filter, base: base, files: files };
+      }
       if (is_multi) {
-        pick__call_deliver_multi_lines(req_id, out.join("\n"));
+        pick__call_deliver_multi(req_id, out);
       } else {
         pick__call_deliver_single(req_id, out.length ? out[0] : 0);
       }
+      return out;
     } catch (e) {
       console.error("pick__js_import_files_to_memfs failed", e);
-      pick__call_deliver_single(req_id, 0);
+      return fail();
     } finally {
-      Module.__pickChosen = [];
+      if (!own) { Module.__pickChosen = []; Module.__pickChosenDir = null; }
+      for (var h = 0; cache && h < srcs.length; h++) if (srcs[h] && srcs[h].hit && !srcs[h].lazy) cache.unpin(srcs[h].key);
+    }
+  })();
+});
+
+// Folder-pick filtering: `accept` is the ".png,.jpg" list built from the
+// PickFilters, `exclude` newline-separated glob patterns. Returns null when
+// both are empty, else { file(rel), dir(rel), path(rel) }: whether to keep a
+// file or descend into a folder, given its path relative to the picked
+// folder, and path() for a file whose folders were not checked on the way.
+EM_JS(void, pick__js_path_filter, (const char* accept_c, const char* exclude_c), {
+  function S(x){ return (typeof x === "number") ? (x ? UTF8ToString(x) : "") : (x || ""); }
+  var exts = S(accept_c).split(",").map(function(e) { return e.trim().toLowerCase(); }).filter(Boolean);
+  var special = ".+^$(){}|[]\\";
+  var globs = S(exclude_c).split("\n").map(function(p) { return p.trim(); }).filter(Boolean).map(function(p) {
+    while (p[0] === "/") p = p.slice(1);
+    var body = p;
+    while (body.length && body[body.length - 1] === "/") body = body.slice(0, -1);
+    var re = "";
+    for (var i = 0; i < p.length; i++) {
+      var c = p[i];
+      if (c === "*" && p[i + 1] === "*") {
+        i++;
+        if (p[i + 1] === "/") { i++; re += "(?:.*/)?"; } else re += ".*";
+      } else if (c === "*") re += "[^/]*";
+      else if (c === "?") re += "[^/]";
+      else re += (special.indexOf(c) >= 0 ? "\\" : "") + c;
+    }
+    return new RegExp("^" + (body.indexOf("/") < 0 ? "(?:.*/)?" : "") + re + "$");
+  });
+  if (!exts.length && !globs.length) return null;
+  function excluded(rel) { for (var i = 0; i < globs.length; i++) if (globs[i].test(rel)) return true; return false; }
+  var filter = {
+    // A folder is skipped if a pattern matches it, or everything under it ("dir/**", "dir/").
+    dir: function(rel) { return !excluded(rel) && !excluded(rel + "/"); },
+    file: function(rel) {
+      if (excluded(rel)) return false;
+      if (!exts.length) return true;
+      var name = rel.slice(rel.lastIndexOf("/") + 1).toLowerCase();
+      for (var i = 0; i < exts.length; i++) if (name.length > exts[i].length && name.slice(-exts[i].length) === exts[i]) return true;
+      return false;
+    },
+    path: function(rel) {
+      for (var at = rel.indexOf("/"); at > 0; at = rel.indexOf("/", at + 1)) if (!filter.dir(rel.slice(0, at))) return false;
+      return filter.file(rel);
+    }
+  };
+  return filter;
+});
+
+// Lists the files under a FileSystemDirectoryHandle as { file, rel }, rel
+// relative to the handle, breadth first. Up to PICK_EM_WALK_CONCURRENCY
+// directory listings and getFile() calls run at once; each file gets its
+// place in the result when its entry is seen, so the order does not depend
+// on which call finishes first. `on_found`, when given, is called with each
+// file as its getFile() resolves. `filter` (see pick__js_path_filter) drops
+// files and whole folders before they are looked up or listed. Resolves to
+// null if the request goes away first.
+EM_JS(void, pick__js_walk_dir, (int dir_js, int req_id, int on_found, int filter), {
+  var limit = (Module.__pickImport && Module.__pickImport.walkConcurrency) || 16;
+  return new Promise(function(resolve, reject) {
+    var queue = [{ dir: dir_js, rel: "" }], head = 0, active = 0, out = [], done = false;
+    function finish(value, err) {
+      if (done) return;
+      done = true;
+      if (err) reject(err); else resolve(value);
+    }
+    function pump() {
+      if (done) return;
+      if (!pick__call_req_alive(req_id)) { finish(null); return; }
+      while (active < limit && head < queue.length) { var task = queue[head]; queue[head++] = null; run(task); }
+      if (!active && head >= queue.length) finish(out.filter(Boolean));
+    }
+    async function run(task) {
+      active++;
+      try {
+        if (task.dir) {
+          for await (const [name, handle] of task.dir.entries()) {
+            if (done) return;
+            var rel = task.rel ? (task.rel + "/" + name) : name;
+            if (handle.kind === "file") {
+              if (!filter || filter.file(rel)) queue.push({ handle: handle, rel: rel, slot: out.push(null) - 1 });
+            } else if (handle.kind === "directory") {
+              if (!filter || filter.dir(rel)) queue.push({ dir: handle, rel: rel });
+            }
+            pump();
+          }
+        } else {
+          var item = { file: await task.handle.getFile(), rel: task.rel };
+          out[task.slot] = item;
+          if (on_found && !done) on_found(item);
+        }
+      } catch (e) {
+        finish(null, e);
+      } finally {
+        active--;
+        pump();
+      }
+    }
+    pump();
+  });
+});
+
+// Walks a folder kept by its import again and copies only the files whose
+// size or last-modified time differ from what the import (or the previous
+// resync) saw, then deletes the files that are gone. The changes are
+// delivered as paths prefixed with '+', '~' or '-'. Returns 0 at once if
+// `folder_id` kept no folder.
+EM_JS(int, pick__js_folder_resync, (int req_id, int folder_id), {
+  var st = Module.__pickFolders && Module.__pickFolders[folder_id];
+  if (typeof FS === "undefined" || !st) return 0;
+  (async function() {
+    try {
+      var found = await pick__js_walk_dir(st.dir, req_id, 0, st.filter);
+      if (!found) return;
+      var changed = [], kinds = [], seen = new Set();
+      for (var i = 0; i < found.length; i++) {
+        var f = found[i].file, prev = st.files.get(found[i].rel);
+        seen.add(found[i].rel);
+        if (prev && prev.size === f.size && prev.modified === f.lastModified) continue;
+        // A lazy or spilled node is read-only; replace it rather than write into it.
+        if (prev) { try { FS.unlink(st.base + "/" + found[i].rel); } catch (e) {} }
+        changed.push(found[i]);
+        kinds.push(prev ? "~" : "+");
+      }
+      var out = [];
+      if (changed.length) {
+        var cfg = Module.__pickImport || {};
+        out = await pick__js_import_files_to_memfs(st.base, req_id, 1, cfg.chunk || 4194304, cfg.lazy || 0, cfg.concurrency || 1,
+                                                   cfg.progressHz || 10, cfg.maxBytes || 0, changed);
+        if (!out) { if (pick__call_req_alive(req_id)) pick__call_deliver_single(req_id, 0); return; }
+      }
+      if (!pick__call_req_alive(req_id)) return;
+
+      var list = out.map(function(p, k) { return kinds[k] + p; });
+      st.files.forEach(function(_, rel) {
+        if (seen.has(rel)) return;
+        st.files.delete(rel);
+        var path = st.base + "/" + rel;
+        try { FS.unlink(path); } catch (e) {}
+        list.push("-" + path);
+        // Drop directories the removal emptied; rmdir stops at the first that is not.
+        try { for (var d = path.slice(0, path.lastIndexOf("/")); d.length > st.base.length; d = d.slice(0, d.lastIndexOf("/"))) FS.rmdir(d); } catch (e) {}
+      });
+      for (var c = 0; c < changed.length; c++) st.files.set(changed[c].rel, { size: changed[c].file.size, modified: changed[c].file.lastModified });
+      pick__call_deliver_multi(req_id, list);
+    } catch (e) {
+      console.error("pick: folder resync failed", e);
+      pick__call_deliver_single(req_id, 0);
     }
   })();
+  return 1;
 });
 
 EM_JS(void, pick__js_open, (int req_id, const char* title_c,
                            int allow_dirs, int allow_files, int allow_multiple,
-                           const char* accept_c,
+                           const char* accept_c, const char* exclude_c,
                            int with_icon, const char* icon_token_c, const char* custom_url_c),
 {
   (async function() {
@@ -1645,6 +5849,7 @@ EM_JS(void, pick__js_open, (int req_id, const char* title_c,
       function S(x){ return (typeof x === "number") ? (x ? UTF8ToString(x) : "") : (x || ""); }
       var title  = S(title_c);
       var accept = S(accept_c);
+      var filter = allow_dirs ? pick__js_path_filter(accept, S(exclude_c)) : null;
       var icon   = S(icon_token_c) || (allow_dirs ? "folder" : "document");
       var custom = S(custom_url_c);
 
@@ -1684,21 +5889,54 @@ EM_JS(void, pick__js_open, (int req_id, const char* title_c,
       var cancel = actions.querySelector('[data-action="cancel"]');
 
       Module.__pickChosen = [];
+      Module.__pickChosenDir = null;
+
+      function itemList() {
+        var ul = list.querySelector('[data-pick="file-items"]');
+        if (!ul) {
+          ul = document.createElement("ul");
+          ul.setAttribute("data-pick", "file-items");
+          list.appendChild(ul);
+        }
+        return ul;
+      }
+
+      function appendItems(ul, items) {
+        var frag = document.createDocumentFragment();
+        for (var i = 0; i < items.length; i++) {
+          var li = document.createElement("li");
+          li.setAttribute("data-pick", "file-item");
+          li.textContent = items[i].rel;
+          frag.appendChild(li);
+        }
+        ul.appendChild(frag);
+      }
 
       function renderList() {
         list.replaceChildren();
         var chosen = Module.__pickChosen || [];
         if (!chosen.length) { summary.textContent = "No selection"; return; }
         summary.textContent = String(chosen.length) + " selected";
-        var ul = document.createElement("ul");
-        ul.setAttribute("data-pick", "file-items");
-        for (var i = 0; i < chosen.length; i++) {
-          var li = document.createElement("li");
-          li.setAttribute("data-pick", "file-item");
-          li.textContent = chosen[i].rel;
-          ul.appendChild(li);
+        appendItems(itemList(), chosen);
+      }
+
+      // Shows a folder's files as the walk finds them, at most once a frame.
+      // Returns the walk's on_found and a stop() to call before renderList().
+      function streamList() {
+        var pending = [], shown = (Module.__pickChosen || []).length, scheduled = false, stopped = false;
+        var later = (typeof requestAnimationFrame === "function") ? requestAnimationFrame : function(f) { return setTimeout(f, 16); };
+        function flush() {
+          scheduled = false;
+          if (stopped || !pending.length) return;
+          appendItems(itemList(), pending);
+          shown += pending.length;
+          pending = [];
+          summary.textContent = String(shown) + " found…";
         }
-        list.appendChild(ul);
+        return {
+          found: function(item) { pending.push(item); if (!scheduled) { scheduled = true; later(flush); } },
+          stop: function() { stopped = true; }
+        };
       }
 
       function extTypesFromAccept(str) {
@@ -1712,21 +5950,15 @@ EM_JS(void, pick__js_open, (int req_id, const char* title_c,
         try {
           if (allow_dirs) {
             const dir = await window.showDirectoryPicker({ mode: "read" });
-            async function* walk(rootHandle, prefix) {
-              for await (const [name, handle] of rootHandle.entries()) {
-                const rel = prefix ? (prefix + "/" + name) : name;
-                if (handle.kind === "file") {
-                  const file = await handle.getFile();
-                  file._rel = rel;
-                  yield file;
-                } else if (handle.kind === "directory") {
-                  yield* walk(handle, rel);
-                }
-              }
-            }
-            for await (const f of walk(dir, "")) {
-              Module.__pickChosen.push({ file: f, rel: f._rel || f.name });
-            }
+            const stream = streamList();
+            ok.disabled = true;
+            let found;
+            try { found = await pick__js_walk_dir(dir, req_id, stream.found, filter); }
+            finally { stream.stop(); ok.disabled = false; }
+            if (!found) return;
+            for (const item of found) Module.__pickChosen.push(item);
+            // Only a selection that is exactly this folder can be resynced.
+            Module.__pickChosenDir = Module.__pickChosen.length === found.length ? { handle: dir, filter: filter } : null;
           } else {
             const picked = await window.showOpenFilePicker({
               multiple: !!allow_multiple,
@@ -1744,6 +5976,7 @@ EM_JS(void, pick__js_open, (int req_id, const char* title_c,
           } else {
             console.error("pick: FSA browse failed", err);
           }
+          renderList();
         }
       }
 
@@ -1762,8 +5995,11 @@ EM_JS(void, pick__js_open, (int req_id, const char* title_c,
           for (var i = 0; i < files.length; i++) {
             var f = files[i];
             var rel = (f.webkitRelativePath && f.webkitRelativePath.length) ? f.webkitRelativePath : f.name;
+            // webkitRelativePath starts with the picked folder's own name.
+            if (filter && !filter.path(rel.slice(rel.indexOf("/") + 1))) continue;
             Module.__pickChosen.push({ file: f, rel: rel });
           }
+          Module.__pickChosenDir = null;
           renderList();
           setTimeout(function(){ try{ input.remove(); }catch(_){} }, 0);
         }, { once: true });
@@ -1780,6 +6016,7 @@ EM_JS(void, pick__js_open, (int req_id, const char* title_c,
 
       cancel.addEventListener("click", function(){
         Module.__pickChosen = [];
+        Module.__pickChosenDir = null;
         overlay.remove();
         pick__call_deliver_single(req_id, 0);
       }, { once: true });
@@ -1787,7 +6024,10 @@ EM_JS(void, pick__js_open, (int req_id, const char* title_c,
       ok.addEventListener("click", function(){
         overlay.remove();
         var is_multi = !!allow_multiple;
-        pick__js_import_files_to_memfs("/picked", req_id, is_multi ? 1 : 0);
+        var cfg = Module.__pickImport || {};
+        pick__js_import_files_to_memfs((cfg.base || "/picked") + "/" + req_id, req_id, is_multi ? 1 : 0,
+                                       cfg.chunk || 4194304, cfg.lazy || 0, cfg.concurrency || 1,
+                                       cfg.progressHz || 10, cfg.maxBytes || 0, 0);
       }, { once: true });
 
       browse.focus();
@@ -1849,6 +6089,8 @@ EM_JS(void, pick__js_save, (int req_id, const char* title_c, const char* suggest
       if (typeof FS !== "undefined") {
         try { if (!FS.analyzePath(base).exists) FS.mkdir(base); } catch (e) {}
         try { if (!FS.analyzePath(full).exists) FS.writeFile(full, new Uint8Array()); } catch (e) {}
+        try { FS.lookupPath(full).node.pickStorage = 2; } catch (e) {}
+        if (Module.__pickStore) Module.__pickStore.add([full]);
       }
       finalize(full);
     }, { once: true });
@@ -1859,11 +6101,13 @@ EM_JS(void, pick__js_save, (int req_id, const char* title_c, const char* suggest
   } catch (e) { console.error("pick__js_save failed", e); pick__call_deliver_single(req_id, 0); }
 });
 
-EM_JS(void, pick__js_export, (int req_id, const char* src_c, const char* suggested_c), {
+// Exports the MEMFS file `src_c`, or with `data` set, the `len` bytes there
+// in the wasm heap. The source goes out in `chunk`-byte pieces either way.
+EM_JS(void, pick__js_export, (int req_id, const char* src_c, const void* data, double len, const char* suggested_c), {
   (async function(){
     try {
       function S(x){ return (typeof x === "number") ? (x ? UTF8ToString(x) : "") : (x || ""); }
-      if (typeof FS === "undefined") { pick__call_deliver_msg(req_id, 1); return; }
+      if (!data && typeof FS === "undefined") { pick__call_deliver_msg(req_id, 1); return; }
 
       var src = S(src_c);
       var suggested = S(suggested_c);
@@ -1871,13 +6115,49 @@ EM_JS(void, pick__js_export, (int req_id, const char* src_c, const char* suggest
         var slash = src.lastIndexOf("/");
         suggested = (slash >= 0) ? src.slice(slash+1) : "download.bin";
       }
-      var data = FS.readFile(src, { encoding: "binary" });
+      var chunk = (Module.__pickImport && Module.__pickImport.chunk) || 4194304;
+      // Hands the source to `sink` one chunk at a time, so the export holds
+      // one chunk beyond it however large it is. False if the request went
+      // away first.
+      async function stream(sink) {
+        if (data) {
+          for (var at = 0; at < size;) {
+            // Views are taken afresh: the heap may grow (and move) between chunks.
+            // APIs taking bytes refuse shared memory, so -pthread heaps are copied.
+            var view = HEAPU8.subarray(data + at, data + Math.min(size, at + chunk));
+            if (typeof SharedArrayBuffer !== "undefined" && view.buffer instanceof SharedArrayBuffer) view = view.slice();
+            at += view.length;
+            await sink(view);
+            if (!pick__call_req_alive(req_id)) return false;
+          }
+          return true;
+        }
+        var st = FS.open(src, "r");
+        try {
+          for (var pos = 0; pos < size;) {
+            var buf = new Uint8Array(Math.min(chunk, size - pos));
+            var n = FS.read(st, buf, 0, buf.length, pos);
+            if (!n) break;
+            await sink(n < buf.length ? buf.subarray(0, n) : buf);
+            pos += n;
+            if (!pick__call_req_alive(req_id)) return false;
+          }
+          return true;
+        } finally {
+          FS.close(st);
+        }
+      }
+      var size = data ? len : FS.stat(src).size;  // a missing file fails here, before any dialog
 
       if (typeof window !== "undefined" && typeof window.showSaveFilePicker === "function") {
         try {
           var handle = await window.showSaveFilePicker({ suggestedName: suggested });
+          if (!pick__call_req_alive(req_id)) return;
           var writable = await handle.createWritable();
-          await writable.write(new Blob([data], { type: "application/octet-stream" }));
+          var done = false;
+          try { done = await stream(function(part) { return writable.write(part); }); }
+          finally { if (!done) await writable.abort(); }
+          if (!done) return;
           await writable.close();
           pick__call_deliver_msg(req_id, 0);
         } catch (err) {
@@ -1889,7 +6169,12 @@ EM_JS(void, pick__js_export, (int req_id, const char* src_c, const char* suggest
           }
         }
       } else {
-        var blob = new Blob([data], { type: "application/octet-stream" });
+        // Each slice becomes a Blob of its own as it is read, so the browser
+        // holds the bytes and the heap never has more than one slice copied.
+        var parts = [];
+        if (!await stream(function(part) { parts.push(new Blob([part])); })) return;
+        var blob = new Blob(parts, { type: "application/octet-stream" });
+        parts = null;
         var url  = URL.createObjectURL(blob);
         var a = document.createElement("a");
         a.href = url; a.download = suggested;
@@ -1921,124 +6206,77 @@ EM_JS(char*, pick__js_custom_icon_url, (const char* path_c), {
   } catch (e) { console.error("pick__js_custom_icon_url failed", e); return 0; }
 });
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-EMSCRIPTEN_KEEPALIVE
-void pick__deliver_single(int id, const char* path) {
-  if (id <= 0 || id >= PICK_EM_MAX_REQUESTS) return;
-  pick__em_req_t req = pick__g_reqs[id];
-  pick__clear_req(id);
+static void pick__cancel_work(int id) {
+  pick__js_cancel(id);
+}
 
-  switch (req.kind) {
-    case PICK_REQ_OPEN_SINGLE:
-    case PICK_REQ_OPEN_DIR_SINGLE:
-    case PICK_REQ_SAVE:
-      if (req.single_cb) req.single_cb(path, req.user);
-      break;
-    case PICK_REQ_OPEN_MULTI:
-    case PICK_REQ_OPEN_DIR_MULTI:
-      if (req.multi_cb) req.multi_cb(NULL, 0, req.user);
-      break;
-    case PICK_REQ_MESSAGE:
-      if (req.msg_cb) req.msg_cb(PICK_RESULT_OK, req.user);
-      break;
-    default: break;
-  }
+static void pick__em_on_timeout(void* arg) {
+  pick_cancel((PickRequest)(intptr_t)arg);
 }
 
-EMSCRIPTEN_KEEPALIVE
-void pick__deliver_multi_lines(int id, const char* lines) {
-  if (id <= 0 || id >= PICK_EM_MAX_REQUESTS) return;
-  pick__em_req_t req = pick__g_reqs[id];
-  pick__clear_req(id);
+// Creates the import/save directories and hands the import settings to the glue.
+static void pick__em_init(void) {
+  pick__js_init_buckets(PICK_EM_BASE_PICKED, PICK_EM_IMPORT_CHUNK, PICK_EM_LAZY_IMPORT, PICK_EM_IMPORT_CONCURRENCY, PICK_EM_WALK_CONCURRENCY,
+                        PICK_EM_PROGRESS_HZ, (double)PICK_EM_MAX_IMPORT_BYTES,
+                        (double)PICK_EM_IMPORT_CACHE_BYTES, PICK_EM_IMPORT_CACHE_HASH, PICK_EM_IMPORT_DEDUP,
+                        (double)PICK_EM_STORAGE_MAX_BYTES, (double)PICK_EM_STORAGE_MAX_AGE, PICK_EM_IMPORT_WORKER);
+}
 
-  if (!lines || !*lines) {
-    if (req.multi_cb) req.multi_cb(NULL, 0, req.user);
-    else if (req.single_cb) req.single_cb(NULL, req.user);
-    return;
-  }
+PickStorage pick_path_storage(const char *path) {
+  return path ? (PickStorage)pick__js_path_storage(path) : PICK_STORAGE_NONE;
+}
 
-  if ((req.kind == PICK_REQ_OPEN_DIR_SINGLE || req.kind == PICK_REQ_OPEN_SINGLE) && req.single_cb) {
-    const char* nl = strchr(lines, '\n');
-    size_t len = nl ? (size_t)(nl - lines) : strlen(lines);
-    char* first = (char*)malloc(len + 1);
-    if (first) { memcpy(first, lines, len); first[len] = 0; }
-    req.single_cb(first, req.user);
-    if (first) free(first);
-    return;
+void pick_release(const char *const *paths, int count) {
+  for (int i = 0; paths && i < count; i++) {
+    if (paths[i]) pick__js_release(paths[i]);
   }
+}
 
-  if (!req.multi_cb) { if (req.single_cb) req.single_cb(NULL, req.user); return; }
+bool pick_release_request(PickRequest request) {
+  return request != PICK_REQUEST_NONE && pick__js_release_request(request) > 0;
+}
 
-  int count = 1; for (const char* p = lines; *p; p++) if (*p == '\n') count++;
-  char** arr = (char**)calloc((size_t)count, sizeof(char*));
-  if (!arr) { req.multi_cb(NULL, 0, req.user); return; }
+bool pick_em_cache_stats(PickCacheStats *out) {
+  if (!out || pick__js_cache_stat(0) < 0) return false;
+  unsigned long long* fields[] = { &out->hits, &out->misses, &out->hit_bytes, &out->evictions, &out->bytes, &out->entries };
+  for (int i = 0; i < 6; i++) *fields[i] = (unsigned long long)pick__js_cache_stat(i);
+  return true;
+}
 
-  int idx = 0; const char* start = lines;
-  for (const char* p = lines;; p++) {
-    if (*p == '\n' || *p == '\0') {
-      size_t L = (size_t)(p - start);
-      char* s = (char*)malloc(L + 1);
-      if (s) { memcpy(s, start, L); s[L] = 0; arr[idx++] = s; }
-      if (*p == '\0') break; start = p + 1;
-    }
-  }
-  req.multi_cb((const char**)arr, idx, req.user);
-  for (int i = 0; i < idx; i++) free(arr[i]);
-  free(arr);
+bool pick_em_dedup_stats(PickDedupStats *out) {
+  if (!out || pick__js_dedup_stat(0) < 0) return false;
+  unsigned long long* fields[] = { &out->linked_files, &out->saved_bytes, &out->hashed_bytes };
+  for (int i = 0; i < 3; i++) *fields[i] = (unsigned long long)pick__js_dedup_stat(i);
+  return true;
 }
 
-EMSCRIPTEN_KEEPALIVE
-void pick__deliver_msg(int id, int button_idx) {
-  if (id <= 0 || id >= PICK_EM_MAX_REQUESTS) return;
-  pick__em_req_t req = pick__g_reqs[id];
-  pick__clear_req(id);
+bool pick_em_storage_stats(PickStorageStats *out) {
+  if (!out || pick__js_storage_stat(0) < 0) return false;
+  unsigned long long* fields[] = { &out->bytes, &out->files, &out->evictions, &out->evicted_bytes };
+  for (int i = 0; i < 4; i++) *fields[i] = (unsigned long long)pick__js_storage_stat(i);
+  return true;
+}
 
-  if (req.kind == PICK_REQ_MESSAGE) {
-    if (req.msg_cb) {
-      PickButtonResult result = PICK_RESULT_CLOSED;
-      
-      switch (req.button_type) {
-        case PICK_BUTTON_OK:
-          result = (button_idx == 0) ? PICK_RESULT_OK : PICK_RESULT_CLOSED;
-          break;
-          
-        case PICK_BUTTON_OK_CANCEL:
-          if (button_idx == 0) result = PICK_RESULT_CANCEL;
-          else if (button_idx == 1) result = PICK_RESULT_OK;
-          break;
-          
-        case PICK_BUTTON_YES_NO:
-          if (button_idx == 0) result = PICK_RESULT_NO;
-          else if (button_idx == 1) result = PICK_RESULT_YES;
-          break;
-          
-        case PICK_BUTTON_YES_NO_CANCEL:
-          if (button_idx == 0) result = PICK_RESULT_CANCEL;
-          else if (button_idx == 1) result = PICK_RESULT_NO;
-          else if (button_idx == 2) result = PICK_RESULT_YES;
-          break;
-          
-        default:
-          result = PICK_RESULT_CLOSED;
-          break;
-      }
-      
-      req.msg_cb(result, req.user);
-    }
-    return;
-  }
-  if (req.kind == PICK_REQ_EXPORT) {
-    if (req.result_cb) req.result_cb(button_idx == 0, req.user);
-    return;
+// Joins the exclude patterns with '\n' for the glue. Patterns that do not fit
+// whole are dropped, as are empty ones and any containing a newline.
+static void pick__build_exclude_string(const PickFileOptions* opts, char* out, size_t cap) {
+  size_t used = 0;
+  out[0] = 0;
+  for (int i = 0; opts && opts->exclude && i < opts->exclude_count; i++) {
+    const char* p = opts->exclude[i];
+    if (!p || !*p || strchr(p, '\n')) continue;
+    size_t n = strlen(p);
+    if (used + (used > 0) + n + 1 > cap) continue;
+    if (used > 0) out[used++] = '\n';
+    memcpy(out + used, p, n + 1);
+    used += n;
   }
 }
 
-#ifdef __cplusplus
+// A timer outliving its request is harmless: the stale id fails pick__req().
+static void pick__em_arm_timeout(int id, unsigned timeout_ms) {
+  if (timeout_ms) emscripten_async_call(pick__em_on_timeout, (void*)(intptr_t)id, (int)timeout_ms);
 }
-#endif
 
 static const char* pick__message_style_token(PickMessageStyle s) {
   switch (s) {
@@ -2050,75 +6288,126 @@ static const char* pick__message_style_token(PickMessageStyle s) {
   }
 }
 
-void pick__file_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
-  pick__js_init_buckets();
-  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return; }
-  pick__g_reqs[id] = (pick__em_req_t){ .kind = PICK_REQ_OPEN_SINGLE, .single_cb = cb, .user = ud };
+PickRequest pick__file_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  pick__em_init();
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_SINGLE, .single_cb = cb, .user = ud,
+                                     .progress_cb = options ? options->progress : NULL };
 
   char accept[512]; pick__build_accept_string(options, accept, sizeof(accept));
   const char* title = (options && options->title) ? options->title : "";
 
   pick__js_open(id, title, 0, 1, (options && options->allow_multiple) ? 1 : 0,
-               accept, 1, "document", "");
+               accept, "", 1, "document", "");
+  pick__em_arm_timeout(id, options ? options->timeout_ms : 0);
+  return id;
 }
 
-void pick__files_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
-  pick__js_init_buckets();
-  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, 0, ud); return; }
-  pick__g_reqs[id] = (pick__em_req_t){ .kind = PICK_REQ_OPEN_MULTI, .multi_cb = cb, .user = ud };
+PickRequest pick__files_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  pick__em_init();
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, 0, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_MULTI, .multi_cb = cb, .user = ud,
+                                     .progress_cb = options ? options->progress : NULL };
 
   char accept[512]; pick__build_accept_string(options, accept, sizeof(accept));
   const char* title = (options && options->title) ? options->title : "";
 
-  pick__js_open(id, title, 0, 1, 1, accept, 1, "document", "");
+  pick__js_open(id, title, 0, 1, 1, accept, "", 1, "document", "");
+  pick__em_arm_timeout(id, options ? options->timeout_ms : 0);
+  return id;
 }
 
-void pick__folder_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
-  pick__js_init_buckets();
-  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return; }
-  pick__g_reqs[id] = (pick__em_req_t){ .kind = PICK_REQ_OPEN_DIR_SINGLE, .single_cb = cb, .user = ud };
+PickRequest pick__folder_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  pick__em_init();
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_DIR_SINGLE, .single_cb = cb, .user = ud,
+                                     .progress_cb = options ? options->progress : NULL };
 
+  char accept[512]; pick__build_accept_string(options, accept, sizeof(accept));
+  char exclude[1024]; pick__build_exclude_string(options, exclude, sizeof(exclude));
   const char* title = (options && options->title) ? options->title : "";
 
-  pick__js_open(id, title, 1, 0, 0, "", 1, "folder", "");
+  pick__js_open(id, title, 1, 0, 0, accept, exclude, 1, "folder", "");
+  pick__em_arm_timeout(id, options ? options->timeout_ms : 0);
+  return id;
 }
 
-void pick__folders_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
-  pick__js_init_buckets();
-  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, 0, ud); return; }
-  pick__g_reqs[id] = (pick__em_req_t){ .kind = PICK_REQ_OPEN_DIR_MULTI, .multi_cb = cb, .user = ud };
+PickRequest pick__folders_impl(const PickFileOptions *options, PickMultiFileCallback cb, void *ud) {
+  pick__em_init();
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, 0, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_OPEN_DIR_MULTI, .multi_cb = cb, .user = ud,
+                                     .progress_cb = options ? options->progress : NULL };
 
+  char accept[512]; pick__build_accept_string(options, accept, sizeof(accept));
+  char exclude[1024]; pick__build_exclude_string(options, exclude, sizeof(exclude));
   const char* title = (options && options->title) ? options->title : "";
 
-  pick__js_open(id, title, 1, 0, 1, "", 1, "folder", "");
+  pick__js_open(id, title, 1, 0, 1, accept, exclude, 1, "folder", "");
+  pick__em_arm_timeout(id, options ? options->timeout_ms : 0);
+  return id;
 }
 
-void pick__save_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
-  pick__js_init_buckets();
-  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return; }
-  pick__g_reqs[id] = (pick__em_req_t){ .kind = PICK_REQ_SAVE, .single_cb = cb, .user = ud };
+PickRequest pick__save_impl(const PickFileOptions *options, PickFileCallback cb, void *ud) {
+  pick__em_init();
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(NULL, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_SAVE, .single_cb = cb, .user = ud };
 
   const char* title     = (options && options->title)        ? options->title        : "";
   const char* suggested = (options && options->default_name) ? options->default_name : "untitled";
 
   pick__js_save(id, title, suggested, 1, "document", "");
+  pick__em_arm_timeout(id, options ? options->timeout_ms : 0);
+  return id;
 }
 
-void pick_export_file(const char* src_path, const PickFileOptions* options,
-                      PickResultCallback done, void* user) {
-  pick__js_init_buckets();
-  int id = pick__alloc_req(); if (!id) { if (done) done(false, user); return; }
-  pick__g_reqs[id] = (pick__em_req_t){ .kind = PICK_REQ_EXPORT, .result_cb = done, .user = user };
+PickRequest pick_export_file(const char* src_path, const PickFileOptions* options,
+                             PickResultCallback done, void* user) {
+  pick__em_init();
+  int id = pick__alloc_req(); if (!id) { if (done) done(false, user); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_EXPORT, .result_cb = done, .user = user };
 
   const char* suggested = (options && options->default_name) ? options->default_name : "";
-  pick__js_export(id, src_path ? src_path : "", suggested);
+  pick__js_export(id, src_path ? src_path : "", NULL, 0, suggested);
+  pick__em_arm_timeout(id, options ? options->timeout_ms : 0);
+  return id;
+}
+
+PickRequest pick_export_buffer(const void* data, size_t len, const PickFileOptions* options,
+                               PickResultCallback done, void* user) {
+  pick__em_init();
+  if (!data && len) { if (done) done(false, user); return PICK_REQUEST_NONE; }
+  int id = pick__alloc_req(); if (!id) { if (done) done(false, user); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_EXPORT, .result_cb = done, .user = user };
+
+  // An empty buffer still needs a non-null pointer to be told apart from a file export.
+  static const unsigned char empty = 0;
+  const char* suggested = (options && options->default_name) ? options->default_name : "download.bin";
+  pick__js_export(id, "", data ? data : &empty, (double)len, suggested);
+  pick__em_arm_timeout(id, options ? options->timeout_ms : 0);
+  return id;
+}
+
+PickRequest pick_folder_resync(PickRequest folder, const PickFileOptions *options,
+                               PickResyncCallback cb, void *ud) {
+  pick__em_init();
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(false, NULL, NULL, 0, ud); return PICK_REQUEST_NONE; }
+  *pick__req(id) = (pick__em_req_t){ .kind = PICK_REQ_RESYNC, .resync_cb = cb, .user = ud,
+                                     .progress_cb = options ? options->progress : NULL };
+
+  if (!pick__js_folder_resync(id, folder)) {
+    pick__clear_req(id);
+    if (cb) cb(false, NULL, NULL, 0, ud);
+    return PICK_REQUEST_NONE;
+  }
+  pick__em_arm_timeout(id, options ? options->timeout_ms : 0);
+  return id;
 }
 
-void pick__message_impl(const PickMessageOptions *opts, PickMessageCallback cb, void *ud) {
-  int id = pick__alloc_req(); if (!id) { if (cb) cb(PICK_RESULT_CLOSED, ud); return; }
+PickRequest pick__message_impl(const PickMessageOptions *opts, PickMessageCallback cb, void *ud) {
+  int id = pick__alloc_req(); if (!id) { if (cb) cb(PICK_RESULT_CLOSED, ud); return PICK_REQUEST_NONE; }
   
   PickButtonType btns = opts ? opts->buttons : PICK_BUTTON_OK;
-  pick__g_reqs[id] = (pick__em_req_t){ 
+  *pick__req(id) = (pick__em_req_t){ 
     .kind = PICK_REQ_MESSAGE, 
     .msg_cb = cb, 
     .user = ud,
@@ -2162,8 +6451,10 @@ void pick__message_impl(const PickMessageOptions *opts, PickMessageCallback cb,
   int button_count = (btns == PICK_BUTTON_OK) ? 1 : 
                      (btns == PICK_BUTTON_OK_CANCEL || btns == PICK_BUTTON_YES_NO) ? 2 : 3;
   pick__js_bind_message_handlers(id, button_count);
+  pick__em_arm_timeout(id, opts ? opts->timeout_ms : 0);
 
   if (custom_url) { free(custom_url); }
+  return id;
 }
 
 #endif 